@@ -0,0 +1,209 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <config/parser.h>
+#include <string/string.h>
+#include <file/file.h>
+
+#include "epos.h"
+#include "home.h"
+#include "position_profile.h"
+#include "clock.h"
+#include "macros.h"
+
+#define EPOS_BENCH_PARSER_OPTION_GROUP            "bench"
+#define EPOS_BENCH_PARAMETER_ITERATIONS           "iterations"
+#define EPOS_BENCH_PARAMETER_CONNECTIONS          "connections"
+#define EPOS_BENCH_PARAMETER_OUTPUT               "output"
+
+config_param_t epos_bench_default_options_params[] = {
+  {EPOS_BENCH_PARAMETER_ITERATIONS,
+    config_param_type_int,
+    "1000",
+    "[1, inf)",
+    "The number of SDO transfers and homing starts to be measured"},
+  {EPOS_BENCH_PARAMETER_CONNECTIONS,
+    config_param_type_int,
+    "20",
+    "[1, inf)",
+    "The number of node connections to be measured"},
+  {EPOS_BENCH_PARAMETER_OUTPUT,
+    config_param_type_string,
+    "-",
+    "",
+    "Write the benchmark results in JSON format to the specified output "
+    "file or '-' for stdout"},
+};
+
+const config_default_t epos_bench_default_options = {
+  epos_bench_default_options_params,
+  sizeof(epos_bench_default_options_params)/sizeof(config_param_t),
+};
+
+int epos_bench_compare(const void* a, const void* b) {
+  double difference = *(const double*)a-*(const double*)b;
+  return (difference > 0.0) - (difference < 0.0);
+}
+
+void epos_bench_print(file_t* file, const char* name, double* latencies,
+    size_t num_latencies, int last) {
+  double mean = 0.0;
+  size_t i;
+  
+  qsort(latencies, num_latencies, sizeof(double), epos_bench_compare);
+  for (i = 0; i < num_latencies; ++i)
+    mean += latencies[i]/num_latencies;
+  
+  file_printf(file,
+    "    {\"name\": \"%s\", \"unit\": \"s\", \"samples\": %lu, "
+    "\"min\": %.9g, \"mean\": %.9g, \"median\": %.9g, \"p90\": %.9g, "
+    "\"p99\": %.9g, \"max\": %.9g}%s\n",
+    name, (unsigned long)num_latencies, latencies[0], mean,
+    latencies[num_latencies/2], latencies[num_latencies*90/100],
+    latencies[num_latencies*99/100], latencies[num_latencies-1],
+    last ? "" : ",");
+}
+
+int main(int argc, char **argv) {
+  config_parser_t parser;
+  epos_node_t node;
+  epos_home_t home;
+  file_t output_file;
+  double start_time;
+  int position = 0;
+  short status;
+  size_t i;
+
+  config_parser_init(&parser,
+    "Benchmark the communication with an EPOS node",
+    "Establish the communication with a connected or simulated EPOS "
+    "device and measure the latencies of SDO reads and writes, of "
+    "connecting the node, and of starting the homing operation. The "
+    "results are written in JSON format to a file or stdout, such that "
+    "they may be compared between releases. The communication interface "
+    "depends on the momentarily selected alternative of the underlying "
+    "CANopen library.");
+  config_parser_add_option_group(&parser, EPOS_BENCH_PARSER_OPTION_GROUP,
+    &epos_bench_default_options, "Benchmark options",
+    "These options control the number of measurements and the output.");
+  epos_node_init_config_parse(&node, &parser, 0, argc, argv,
+    config_parser_exit_error);
+  error_exit(&node.error);
+  
+  config_parser_option_group_t* epos_bench_option_group =
+    config_parser_get_option_group(&parser, EPOS_BENCH_PARSER_OPTION_GROUP);
+  size_t num_iterations = config_get_int(&epos_bench_option_group->options,
+    EPOS_BENCH_PARAMETER_ITERATIONS);
+  size_t num_connections = config_get_int(
+    &epos_bench_option_group->options, EPOS_BENCH_PARAMETER_CONNECTIONS);
+  const char* output = config_get_string(&epos_bench_option_group->options,
+    EPOS_BENCH_PARAMETER_OUTPUT);
+  
+  double* read_latencies = malloc(num_iterations*sizeof(double));
+  double* write_latencies = malloc(num_iterations*sizeof(double));
+  double* home_latencies = malloc(num_iterations*sizeof(double));
+  double* connect_latencies = malloc(num_connections*sizeof(double));
+  
+  for (i = 0; i < num_connections; ++i) {
+    start_time = epos_clock_get();
+    epos_node_connect(&node);
+    connect_latencies[i] = epos_clock_get()-start_time;
+    error_exit(&node.error);
+    
+    if (i+1 < num_connections) {
+      epos_node_disconnect(&node);
+      error_exit(&node.error);
+    }
+  }
+  
+  for (i = 0; i < num_iterations; ++i) {
+    start_time = epos_clock_get();
+    epos_device_read(&node.dev, EPOS_DEVICE_INDEX_STATUS, 0,
+      (unsigned char*)&status, sizeof(short));
+    read_latencies[i] = epos_clock_get()-start_time;
+    error_exit(&node.dev.error);
+  }
+  
+  for (i = 0; i < num_iterations; ++i) {
+    start_time = epos_clock_get();
+    epos_device_write(&node.dev, EPOS_POSITION_PROFILE_INDEX_TARGET, 0,
+      (unsigned char*)&position, sizeof(int));
+    write_latencies[i] = epos_clock_get()-start_time;
+    error_exit(&node.dev.error);
+  }
+  
+  epos_home_init(&home,
+    config_get_enum(&node.config, EPOS_PARAMETER_HOME_METHOD),
+    config_get_float(&node.config, EPOS_PARAMETER_HOME_CURRENT),
+    deg_to_rad(config_get_float(&node.config, EPOS_PARAMETER_HOME_VELOCITY)),
+    deg_to_rad(config_get_float(&node.config,
+      EPOS_PARAMETER_HOME_ACCELERATION)),
+    deg_to_rad(config_get_float(&node.config, EPOS_PARAMETER_HOME_POSITION)));
+  for (i = 0; i < num_iterations; ++i) {
+    start_time = epos_clock_get();
+    epos_home_start(&node, &home);
+    home_latencies[i] = epos_clock_get()-start_time;
+    error_exit(&node.dev.error);
+    
+    epos_home_stop(&node);
+    error_exit(&node.dev.error);
+  }
+  
+  epos_node_disconnect(&node);
+  error_exit(&node.error);
+  
+  file_init_name(&output_file, output);
+  if (string_equal(output, "-"))
+    file_open_stream(&output_file, stdout, file_mode_write);
+  else
+    file_open(&output_file, file_mode_write);
+  error_exit(&output_file.error);
+  
+  file_printf(&output_file, "{\n  \"benchmark\": \"device\",\n"
+    "  \"node_id\": %d,\n  \"hardware_version\": %d,\n"
+    "  \"software_version\": %d,\n  \"results\": [\n", node.dev.node_id,
+    node.dev.hardware_version, node.dev.software_version);
+  epos_bench_print(&output_file, "sdo_read", read_latencies,
+    num_iterations, 0);
+  epos_bench_print(&output_file, "sdo_write", write_latencies,
+    num_iterations, 0);
+  epos_bench_print(&output_file, "node_connect", connect_latencies,
+    num_connections, 0);
+  epos_bench_print(&output_file, "home_start", home_latencies,
+    num_iterations, 1);
+  file_printf(&output_file, "  ]\n}\n");
+  error_exit(&output_file.error);
+  
+  file_destroy(&output_file);
+  
+  free(read_latencies);
+  free(write_latencies);
+  free(home_latencies);
+  free(connect_latencies);
+  
+  epos_node_destroy(&node);
+  config_parser_destroy(&parser);
+  
+  return 0;
+}
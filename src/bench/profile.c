@@ -0,0 +1,209 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <config/parser.h>
+#include <string/string.h>
+#include <file/file.h>
+
+#include "position_profile.h"
+#include "velocity_profile.h"
+#include "interpolated_position.h"
+#include "clock.h"
+
+#define EPOS_BENCH_PARSER_OPTION_GROUP            "bench"
+#define EPOS_BENCH_PARAMETER_EVALUATIONS          "evaluations"
+#define EPOS_BENCH_PARAMETER_KNOTS                "knots"
+#define EPOS_BENCH_PARAMETER_OUTPUT               "output"
+
+#define EPOS_BENCH_PROFILE_DURATION               3.0
+#define EPOS_BENCH_KNOT_PERIOD                    0.01
+
+config_param_t epos_bench_default_options_params[] = {
+  {EPOS_BENCH_PARAMETER_EVALUATIONS,
+    config_param_type_int,
+    "1000000",
+    "[1, inf)",
+    "The number of evaluations of each profile function"},
+  {EPOS_BENCH_PARAMETER_KNOTS,
+    config_param_type_int,
+    "1000",
+    "[1, inf)",
+    "The number of knots of the interpolated position profile"},
+  {EPOS_BENCH_PARAMETER_OUTPUT,
+    config_param_type_string,
+    "-",
+    "",
+    "Write the benchmark results in JSON format to the specified output "
+    "file or '-' for stdout"},
+};
+
+const config_default_t epos_bench_default_options = {
+  epos_bench_default_options_params,
+  sizeof(epos_bench_default_options_params)/sizeof(config_param_t),
+};
+
+volatile double epos_bench_result = 0.0;
+
+void epos_bench_print(file_t* file, const char* name, size_t
+    num_evaluations, double time, int last) {
+  file_printf(file,
+    "    {\"name\": \"%s\", \"unit\": \"1/s\", \"evaluations\": %lu, "
+    "\"time\": %.9g, \"rate\": %.9g}%s\n",
+    name, (unsigned long)num_evaluations, time, num_evaluations/time,
+    last ? "" : ",");
+}
+
+double epos_bench_position_profile(epos_profile_type_t type, size_t
+    num_evaluations) {
+  epos_position_profile_t profile;
+  double start_time, step_size = EPOS_BENCH_PROFILE_DURATION/
+    num_evaluations;
+  double result = 0.0;
+  size_t i;
+  
+  epos_position_profile_init(&profile, 2.0*M_PI, M_PI, 4.0*M_PI, 4.0*M_PI,
+    type, 0);
+  
+  start_time = epos_clock_get();
+  for (i = 0; i < num_evaluations; ++i)
+    result += epos_position_profile_eval(&profile, i*step_size).position;
+  epos_bench_result = result;
+  
+  return epos_clock_get()-start_time;
+}
+
+double epos_bench_velocity_profile(epos_profile_type_t type, size_t
+    num_evaluations) {
+  epos_velocity_profile_t profile;
+  double start_time, step_size = EPOS_BENCH_PROFILE_DURATION/
+    num_evaluations;
+  double result = 0.0;
+  size_t i;
+  
+  epos_velocity_profile_init(&profile, 2.0*M_PI, 4.0*M_PI, 4.0*M_PI, type);
+  
+  start_time = epos_clock_get();
+  for (i = 0; i < num_evaluations; ++i)
+    result += epos_velocity_profile_eval(&profile, i*step_size).velocity;
+  epos_bench_result = result;
+  
+  return epos_clock_get()-start_time;
+}
+
+double epos_bench_interpolated_position(const
+    epos_interpolated_position_t* profile, size_t num_evaluations, int
+    linear) {
+  double start_time, step_size = profile->knots[profile->num_knots-1].time/
+    num_evaluations;
+  double result = 0.0;
+  size_t i, index = 0;
+  
+  start_time = epos_clock_get();
+  if (linear)
+    for (i = 0; i < num_evaluations; ++i)
+      result += epos_interpolated_position_eval_linear(profile, i*step_size,
+        &index).position;
+  else
+    for (i = 0; i < num_evaluations; ++i)
+      result += epos_interpolated_position_eval(profile,
+        i*step_size).position;
+  epos_bench_result = result;
+  
+  return epos_clock_get()-start_time;
+}
+
+int main(int argc, char **argv) {
+  config_parser_t parser;
+  epos_interpolated_position_t profile;
+  file_t output_file;
+  size_t i;
+
+  config_parser_init(&parser,
+    "Benchmark the evaluation of EPOS motion profiles",
+    "Measure the throughput of evaluating EPOS position, velocity, and "
+    "interpolated position profiles in evaluations per second. The results "
+    "are written in JSON format to a file or stdout, such that they may be "
+    "compared between releases. No communication with an EPOS node is "
+    "required to perform the evaluations.");
+  config_parser_add_option_group(&parser, EPOS_BENCH_PARSER_OPTION_GROUP,
+    &epos_bench_default_options, "Benchmark options",
+    "These options control the number of evaluations and the output.");
+  config_parser_parse(&parser, argc, argv, config_parser_exit_error);
+  
+  config_parser_option_group_t* epos_bench_option_group =
+    config_parser_get_option_group(&parser, EPOS_BENCH_PARSER_OPTION_GROUP);
+  size_t num_evaluations = config_get_int(&epos_bench_option_group->options,
+    EPOS_BENCH_PARAMETER_EVALUATIONS);
+  size_t num_knots = config_get_int(&epos_bench_option_group->options,
+    EPOS_BENCH_PARAMETER_KNOTS);
+  const char* output = config_get_string(&epos_bench_option_group->options,
+    EPOS_BENCH_PARAMETER_OUTPUT);
+  
+  epos_interpolated_position_knot_t* knots = malloc(num_knots*
+    sizeof(epos_interpolated_position_knot_t));
+  for (i = 0; i < num_knots; ++i) {
+    knots[i].time = (i+1)*EPOS_BENCH_KNOT_PERIOD;
+    knots[i].position = sin(knots[i].time);
+    knots[i].velocity = cos(knots[i].time);
+  }
+  epos_interpolated_position_init(&profile, knots, num_knots);
+  free(knots);
+  
+  file_init_name(&output_file, output);
+  if (string_equal(output, "-"))
+    file_open_stream(&output_file, stdout, file_mode_write);
+  else
+    file_open(&output_file, file_mode_write);
+  error_exit(&output_file.error);
+  
+  file_printf(&output_file, "{\n  \"benchmark\": \"profile\",\n"
+    "  \"knots\": %lu,\n  \"results\": [\n", (unsigned long)num_knots);
+  epos_bench_print(&output_file, "position_profile_eval_linear",
+    num_evaluations, epos_bench_position_profile(epos_profile_linear,
+    num_evaluations), 0);
+  epos_bench_print(&output_file, "position_profile_eval_sinusoidal",
+    num_evaluations, epos_bench_position_profile(epos_profile_sinusoidal,
+    num_evaluations), 0);
+  epos_bench_print(&output_file, "velocity_profile_eval_linear",
+    num_evaluations, epos_bench_velocity_profile(epos_profile_linear,
+    num_evaluations), 0);
+  epos_bench_print(&output_file, "velocity_profile_eval_sinusoidal",
+    num_evaluations, epos_bench_velocity_profile(epos_profile_sinusoidal,
+    num_evaluations), 0);
+  epos_bench_print(&output_file, "interpolated_position_eval_bisect",
+    num_evaluations, epos_bench_interpolated_position(&profile,
+    num_evaluations, 0), 0);
+  epos_bench_print(&output_file, "interpolated_position_eval_linear",
+    num_evaluations, epos_bench_interpolated_position(&profile,
+    num_evaluations, 1), 1);
+  file_printf(&output_file, "  ]\n}\n");
+  error_exit(&output_file.error);
+  
+  file_destroy(&output_file);
+  epos_interpolated_position_destroy(&profile);
+  config_parser_destroy(&parser);
+  
+  return 0;
+}
@@ -0,0 +1,162 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <signal.h>
+
+#include <config/parser.h>
+#include "string/string.h"
+#include "file/file.h"
+
+#include "epos.h"
+#include "interpolated_position.h"
+#include "macros.h"
+
+#define EPOS_INTERPOLATED_POSITION_PARAMETER_FILE        "FILE"
+
+config_param_t epos_interpolated_position_default_arguments_params[] = {
+  {EPOS_INTERPOLATED_POSITION_PARAMETER_FILE,
+    config_param_type_string,
+    "",
+    "",
+    "Read interpolated position profile from the specified input file "
+    "or '-' for stdin"},
+};
+
+const config_default_t epos_interpolated_position_default_arguments = {
+  epos_interpolated_position_default_arguments_params,
+  sizeof(epos_interpolated_position_default_arguments_params)/
+    sizeof(config_param_t),
+};
+
+int quit = 0;
+
+void epos_signaled(int signal) {
+  quit = 1;
+}
+
+int main(int argc, char **argv) {
+  config_parser_t parser;
+  epos_node_t node;
+  file_t input_file;
+
+  config_parser_init_default(&parser,
+    &epos_interpolated_position_default_arguments, 0,
+    "Start EPOS controller in interpolated position mode",
+    "Establish the communication with a connected EPOS device and attempt to "
+    "start the controller in interpolated position mode. The profile knots "
+    "are streamed to the interpolation buffer of the device while the "
+    "motion is in progress. The controller will be stopped if SIGINT is "
+    "received or the motion profile is completed. The communication "
+    "interface depends on the momentarily selected alternative of the "
+    "underlying CANopen library.");
+  epos_node_init_config_parse(&node, &parser, 0, argc, argv,
+    config_parser_exit_error);
+
+  const char* file = config_get_string(&parser.arguments,
+    EPOS_INTERPOLATED_POSITION_PARAMETER_FILE);
+
+  file_init_name(&input_file, file);
+  if (string_equal(file, "-"))
+    file_open_stream(&input_file, stdin, file_mode_read);
+  else
+    file_open(&input_file, file_mode_read);
+  error_exit(&input_file.error);
+
+  char* line = 0;
+  epos_interpolated_position_knot_t* knots = 0;
+  size_t num_knots = 0;
+  
+  while (!file_eof(&input_file) &&
+      (file_read_line(&input_file, &line, 128) >= 0)) {
+    if (string_empty(line) || string_starts_with(line, "#"))
+      continue;
+    
+    double time;
+    float position, velocity;
+    if (string_scanf(line, "%lg %g %g\n", &time, &position, &velocity) == 3) {
+      if (!(num_knots % 64))
+        knots = realloc(knots, (num_knots+64)*
+          sizeof(epos_interpolated_position_knot_t));
+      knots[num_knots].time = time;
+      knots[num_knots].position = position;
+      knots[num_knots].velocity = velocity;
+        
+      ++num_knots;
+    }
+  }
+  string_destroy(&line);
+  error_exit(&input_file.error);
+  file_destroy(&input_file);
+  
+  epos_interpolated_position_t profile;
+  epos_interpolated_position_init(&profile,
+    (num_knots > 1) ? &knots[1] : 0,
+    (num_knots > 1) ? num_knots-1 : 0);
+  if (num_knots) {
+    profile.start_knot.time = knots[0].time;
+    profile.start_knot.position = knots[0].position;
+    profile.start_knot.velocity = knots[0].velocity;
+    epos_interpolated_position_prepare(&profile);
+  }
+  if (knots)
+    free(knots);
+  
+  signal(SIGINT, epos_signaled);
+
+  epos_node_connect(&node);
+  error_exit(&node.error);
+  
+  epos_interpolated_position_start(&node, &profile);
+  error_exit(&node.dev.error);
+  
+  while (!quit) {
+    float actual_value = epos_node_get_position(&node);
+    error_exit(&node.error);
+    float velocity = epos_node_get_velocity(&node);
+    error_exit(&node.error);
+    
+    fprintf(stdout, "\rAngular position: %8.2f deg\n",
+      rad_to_deg(actual_value));
+    fprintf(stdout, "\rAngular velocity: %8.2f deg/s",
+      rad_to_deg(velocity));
+    fprintf(stdout, "%c[1A\r", 0x1B);
+    
+    if (epos_interpolated_position_wait(&node, &profile, 0.1) !=
+        EPOS_DEVICE_ERROR_WAIT_TIMEOUT) {
+      error_exit(&node.dev.error);
+      break;
+    }
+  }
+  fprintf(stdout, "%c[1B\n", 0x1B);
+  
+  epos_interpolated_position_stop(&node);
+  error_exit(&node.dev.error);
+
+  epos_node_disconnect(&node);
+  error_exit(&node.error);
+
+  epos_interpolated_position_destroy(&profile);
+  epos_node_destroy(&node);
+  config_parser_destroy(&parser);
+  
+  return 0;
+}
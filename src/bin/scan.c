@@ -0,0 +1,65 @@
+/***************************************************************************
+ *   Copyright (C) 2004 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <stdio.h>
+
+#include <config/parser.h>
+
+#include "epos.h"
+#include "bus.h"
+#include "scan.h"
+
+int main(int argc, char **argv) {
+  config_parser_t parser;
+  epos_node_t node;
+  epos_scan_t scan;
+  size_t i;
+
+  config_parser_init(&parser,
+    "Discover the EPOS devices connected to a CAN bus",
+    "Query all valid node identifiers for EPOS devices and print the node "
+    "identifier, type, hardware and software version of each responding "
+    "device. The communication interface depends on the momentarily "
+    "selected alternative of the underlying CANopen library.");
+  epos_node_init_config_parse(&node, &parser, 0, argc, argv,
+    config_parser_exit_error);
+  config_parser_destroy(&parser);
+
+  if (epos_bus_open(node.dev.bus))
+    error_exit(&node.dev.bus->error);
+  
+  epos_scan_init(&scan, node.dev.can_dev, 0.0);
+  if (epos_scan_run(&scan))
+    error_exit(&scan.error);
+  
+  for (i = 0; i < scan.num_nodes; ++i)
+    fprintf(stdout, "Node %3d: %-18s hardware 0x%04hX software 0x%04hX\n",
+      scan.nodes[i].node_id, epos_device_names[scan.nodes[i].type],
+      scan.nodes[i].hardware_version, scan.nodes[i].software_version);
+  fprintf(stdout, "%d EPOS device(s) found\n", (int)scan.num_nodes);
+  
+  epos_scan_destroy(&scan);
+  
+  if (epos_bus_close(node.dev.bus))
+    error_exit(&node.dev.bus->error);
+
+  epos_node_destroy(&node);
+  return 0;
+}
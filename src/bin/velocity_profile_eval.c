@@ -30,6 +30,8 @@
 #define EPOS_VELOCITY_PROFILE_EVAL_PARAMETER_FILE         "FILE"
 #define EPOS_VELOCITY_PROFILE_EVAL_PARAMETER_STEP_SIZE    "STEP_SIZE"
 
+#define EPOS_VELOCITY_PROFILE_EVAL_BLOCK_SIZE             256
+
 #define EPOS_PROFILE_PARSER_OPTION_GROUP                  "epos-profile"
 #define EPOS_PROFILE_PARAMETER_TYPE                       "type"
 #define EPOS_PROFILE_PARAMETER_OUTPUT                     "output"
@@ -147,26 +149,36 @@ int main(int argc, char **argv) {
     file_open(&output_file, file_mode_write);
   error_exit(&output_file.error);
   
-  size_t i = 0, j = 0;
-  double t = 0.0;
-  float s = 0.0;
-  epos_profile_value_t values = {0.0, 0.0, 0.0};
+  size_t i = 0, j = 0, k;
+  double times[EPOS_VELOCITY_PROFILE_EVAL_BLOCK_SIZE];
+  float positions[EPOS_VELOCITY_PROFILE_EVAL_BLOCK_SIZE];
+  float velocities[EPOS_VELOCITY_PROFILE_EVAL_BLOCK_SIZE];
+  float accelerations[EPOS_VELOCITY_PROFILE_EVAL_BLOCK_SIZE];
+  float s = 0.0, position = 0.0, velocity = 0.0;
+  epos_profile_prepared_t prepared;
   
   for (i = 0; i < num_profiles; ++i) {
-    profiles[i].start_value = values.velocity;
-    profiles[i].start_time = t;
+    profiles[i].start_value = velocity;
+    profiles[i].start_time = step_size*j;
+    epos_velocity_profile_prepare(&profiles[i], &prepared);
     
-    while (values.velocity != profiles[i].target_value) {
-      values = epos_velocity_profile_eval(&profiles[i], t);
-      file_printf(&output_file, "%10lg %10d %10g %10g, %10g\n",
-        t, i, s+values.position, values.velocity, values.acceleration);
-      error_exit(&output_file.error);
-        
-      ++j;
-      t = step_size*j;
-    };
+    while (velocity != profiles[i].target_value) {
+      for (k = 0; k < EPOS_VELOCITY_PROFILE_EVAL_BLOCK_SIZE; ++k)
+        times[k] = step_size*(j+k);
+      epos_profile_prepared_eval_batch(&prepared, times, positions,
+        velocities, accelerations, EPOS_VELOCITY_PROFILE_EVAL_BLOCK_SIZE);
+      
+      for (k = 0; (k < EPOS_VELOCITY_PROFILE_EVAL_BLOCK_SIZE) &&
+          (velocity != profiles[i].target_value); ++k, ++j) {
+        position = positions[k];
+        velocity = velocities[k];
+        file_printf(&output_file, "%10lg %10d %10g %10g, %10g\n",
+          times[k], i, s+positions[k], velocities[k], accelerations[k]);
+        error_exit(&output_file.error);
+      }
+    }
     
-    s += values.position;
+    s += position;
   }
   
   file_destroy(&output_file);
@@ -0,0 +1,502 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bus.h"
+#include "clock.h"
+#include "device.h"
+#include "pdo.h"
+#include "recorder.h"
+
+const char* epos_bus_errors[] = {
+  "Success",
+  "Failed to receive from CAN device",
+  "Bus receive timeout",
+  "Failed to send to CAN device",
+  "Failed to open CAN device",
+  "Failed to close CAN device",
+  "Node identifier already registered",
+};
+
+static epos_bus_t* epos_buses = 0;
+static pthread_mutex_t epos_buses_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void epos_bus_init(epos_bus_t* bus, can_device_t* can_dev);
+void epos_bus_destroy(epos_bus_t* bus);
+epos_emergency_queue_t* epos_bus_route(epos_bus_t* bus, const
+  can_message_t* message, unsigned int sync_counter, epos_emergency_t*
+  emergency);
+epos_bus_queue_t* epos_bus_get_queue(epos_bus_t* bus, int node_id,
+  epos_bus_queue_type_t type);
+void epos_bus_queue_push(epos_bus_queue_t* queue, const can_message_t*
+  message);
+int epos_bus_queue_pop(epos_bus_queue_t* queue, can_message_t* message);
+int epos_bus_can_open(void* data);
+int epos_bus_can_close(void* data);
+int epos_bus_can_send(void* data, const can_message_t* message);
+int epos_bus_can_receive(void* data, can_message_t* message);
+
+epos_bus_t* epos_bus_attach(epos_device_t* dev) {
+  epos_bus_t* bus;
+  
+  pthread_mutex_lock(&epos_buses_mutex);
+  
+  for (bus = epos_buses; bus && (bus->can_dev != dev->can_dev);
+    bus = bus->next);
+  if (!bus) {
+    if (!(bus = malloc(sizeof(epos_bus_t)))) {
+      pthread_mutex_unlock(&epos_buses_mutex);
+      return 0;
+    }
+    epos_bus_init(bus, dev->can_dev);
+    
+    bus->next = epos_buses;
+    epos_buses = bus;
+  }
+  
+  pthread_mutex_lock(&bus->mutex);
+  if (!bus->nodes[dev->node_id].dev)
+    bus->nodes[dev->node_id].dev = dev;
+  ++bus->num_references;
+  pthread_mutex_unlock(&bus->mutex);
+  
+  pthread_mutex_unlock(&epos_buses_mutex);
+  
+  return bus;
+}
+
+void epos_bus_detach(epos_bus_t* bus, epos_device_t* dev) {
+  epos_bus_t** previous;
+  int node_id;
+  
+  pthread_mutex_lock(&epos_buses_mutex);
+  
+  pthread_mutex_lock(&bus->mutex);
+  for (node_id = 0; node_id <= CAN_NODE_ID_MAX; ++node_id)
+    if (bus->nodes[node_id].dev == dev)
+      bus->nodes[node_id].dev = 0;
+  --bus->num_references;
+  pthread_mutex_unlock(&bus->mutex);
+  
+  if (!bus->num_references) {
+    for (previous = &epos_buses; *previous && (*previous != bus);
+      previous = &(*previous)->next);
+    if (*previous)
+      *previous = bus->next;
+    
+    epos_bus_destroy(bus);
+    free(bus);
+  }
+  
+  pthread_mutex_unlock(&epos_buses_mutex);
+}
+
+int epos_bus_register(epos_bus_t* bus, epos_device_t* dev) {
+  int node_id, result;
+  
+  pthread_mutex_lock(&bus->mutex);
+  
+  error_clear(&bus->error);
+  if (bus->nodes[dev->node_id].dev && (bus->nodes[dev->node_id].dev != dev))
+    error_setf(&bus->error, EPOS_BUS_ERROR_REGISTER, "Node 0x%X",
+      dev->node_id);
+  else {
+    for (node_id = 0; node_id <= CAN_NODE_ID_MAX; ++node_id)
+      if (bus->nodes[node_id].dev == dev)
+        bus->nodes[node_id].dev = 0;
+    bus->nodes[dev->node_id].dev = dev;
+  }
+  result = bus->error.code;
+  
+  pthread_mutex_unlock(&bus->mutex);
+  
+  return result;
+}
+
+epos_bus_t* epos_bus_find(can_device_t* can_dev) {
+  epos_bus_t* bus;
+  
+  pthread_mutex_lock(&epos_buses_mutex);
+  for (bus = epos_buses; bus && (bus->can_dev != can_dev); bus = bus->next);
+  pthread_mutex_unlock(&epos_buses_mutex);
+  
+  return bus;
+}
+
+void epos_bus_set_transport(epos_bus_t* bus, const epos_bus_transport_t*
+    transport) {
+  pthread_mutex_lock(&bus->mutex);
+  
+  if (bus->transport.destroy)
+    bus->transport.destroy(bus->transport.data);
+  bus->transport = *transport;
+  
+  pthread_mutex_unlock(&bus->mutex);
+}
+
+void epos_bus_set_recorder(epos_bus_t* bus, epos_recorder_t* recorder) {
+  pthread_mutex_lock(&bus->mutex);
+  
+  if (bus->recorder) {
+    epos_recorder_destroy(bus->recorder);
+    free(bus->recorder);
+  }
+  bus->recorder = recorder;
+  
+  pthread_mutex_unlock(&bus->mutex);
+}
+
+int epos_bus_open(epos_bus_t* bus) {
+  int result;
+  
+  pthread_mutex_lock(&bus->mutex);
+  
+  error_clear(&bus->error);
+  if (bus->num_opened)
+    result = EPOS_BUS_ERROR_NONE;
+  else if ((result = bus->transport.open(bus->transport.data))) {
+    error_blame(&bus->error, bus->transport.error, EPOS_BUS_ERROR_OPEN);
+    result = EPOS_BUS_ERROR_OPEN;
+  }
+  else if (bus->recorder && epos_recorder_open(bus->recorder)) {
+    error_blame(&bus->error, &bus->recorder->error, EPOS_BUS_ERROR_OPEN);
+    bus->transport.close(bus->transport.data);
+    result = EPOS_BUS_ERROR_OPEN;
+  }
+  
+  if (!result)
+    ++bus->num_opened;
+  
+  pthread_mutex_unlock(&bus->mutex);
+  
+  return result;
+}
+
+int epos_bus_close(epos_bus_t* bus) {
+  int result = EPOS_BUS_ERROR_NONE;
+  
+  pthread_mutex_lock(&bus->send_mutex);
+  pthread_mutex_lock(&bus->mutex);
+  
+  error_clear(&bus->error);
+  if (bus->num_opened && !--bus->num_opened) {
+    while (bus->receiving)
+      pthread_cond_wait(&bus->cond, &bus->mutex);
+    
+    if ((result = bus->transport.close(bus->transport.data))) {
+      error_blame(&bus->error, bus->transport.error, EPOS_BUS_ERROR_CLOSE);
+      result = EPOS_BUS_ERROR_CLOSE;
+    }
+    if (bus->recorder && epos_recorder_close(bus->recorder) && !result) {
+      error_blame(&bus->error, &bus->recorder->error, EPOS_BUS_ERROR_CLOSE);
+      result = EPOS_BUS_ERROR_CLOSE;
+    }
+  }
+  
+  pthread_mutex_unlock(&bus->mutex);
+  pthread_mutex_unlock(&bus->send_mutex);
+  
+  return result;
+}
+
+int epos_bus_send(epos_bus_t* bus, const can_message_t* message) {
+  int sync = (message->id == EPOS_BUS_COB_ID_SYNC) && !message->length;
+  int result;
+  
+  pthread_mutex_lock(&bus->send_mutex);
+  
+  if (sync)
+    __atomic_add_fetch(&bus->sync_counter, 1, __ATOMIC_RELEASE);
+  
+  if ((result = bus->transport.send(bus->transport.data, message))) {
+    if (sync)
+      __atomic_sub_fetch(&bus->sync_counter, 1, __ATOMIC_RELEASE);
+  }
+  else if (bus->recorder)
+    epos_recorder_record(bus->recorder, epos_recorder_sent, message);
+  
+  pthread_mutex_unlock(&bus->send_mutex);
+  
+  if (result) {
+    pthread_mutex_lock(&bus->mutex);
+    error_blame(&bus->error, bus->transport.error, EPOS_BUS_ERROR_SEND);
+    pthread_mutex_unlock(&bus->mutex);
+    
+    result = EPOS_BUS_ERROR_SEND;
+  }
+  
+  return result;
+}
+
+int epos_bus_dispatch(epos_bus_t* bus) {
+  can_message_t message;
+  unsigned int sync_counter;
+  epos_emergency_queue_t* emergency_queue = 0;
+  epos_emergency_t emergency;
+  int result;
+  
+  pthread_mutex_lock(&bus->mutex);
+  
+  if (bus->receiving) {
+    size_t num_dispatched = bus->num_dispatched;
+    
+    while (bus->receiving && (bus->num_dispatched == num_dispatched))
+      pthread_cond_wait(&bus->cond, &bus->mutex);
+    result = bus->result;
+  }
+  else {
+    bus->receiving = 1;
+    pthread_mutex_unlock(&bus->mutex);
+    
+    result = bus->transport.receive(bus->transport.data, &message);
+    sync_counter = epos_bus_get_sync_counter(bus);
+    if (!result && bus->recorder)
+      epos_recorder_record(bus->recorder, epos_recorder_received, &message);
+    
+    pthread_mutex_lock(&bus->mutex);
+    if (result) {
+      error_blame(&bus->error, bus->transport.error, EPOS_BUS_ERROR_RECEIVE);
+      result = EPOS_BUS_ERROR_RECEIVE;
+    }
+    else
+      emergency_queue = epos_bus_route(bus, &message, sync_counter,
+        &emergency);
+    
+    bus->result = result;
+    ++bus->num_dispatched;
+    bus->receiving = 0;
+    pthread_cond_broadcast(&bus->cond);
+  }
+  
+  pthread_mutex_unlock(&bus->mutex);
+  
+  if (emergency_queue)
+    epos_emergency_queue_notify(emergency_queue, &emergency);
+  
+  return result;
+}
+
+int epos_bus_receive(epos_bus_t* bus, int node_id, epos_bus_queue_type_t
+    type, can_message_t* message, double timeout) {
+  double start_time, time;
+  int result;
+  
+  start_time = epos_clock_get();
+  
+  while (!epos_bus_poll(bus, node_id, type, message)) {
+    if ((result = epos_bus_dispatch(bus)))
+      return result;
+    
+    time = epos_clock_get();
+    if ((timeout >= 0.0) && (time-start_time > timeout))
+      return EPOS_BUS_ERROR_TIMEOUT;
+  }
+  
+  return EPOS_BUS_ERROR_NONE;
+}
+
+int epos_bus_poll(epos_bus_t* bus, int node_id, epos_bus_queue_type_t type,
+    can_message_t* message) {
+  int result;
+  
+  pthread_mutex_lock(&bus->mutex);
+  result = epos_bus_queue_pop(epos_bus_get_queue(bus, node_id, type),
+    message);
+  pthread_mutex_unlock(&bus->mutex);
+  
+  return result;
+}
+
+void epos_bus_clear(epos_bus_t* bus, int node_id, epos_bus_queue_type_t
+    type) {
+  epos_bus_queue_t* queue;
+  
+  pthread_mutex_lock(&bus->mutex);
+  queue = epos_bus_get_queue(bus, node_id, type);
+  queue->first = 0;
+  queue->num_messages = 0;
+  pthread_mutex_unlock(&bus->mutex);
+}
+
+unsigned char epos_bus_get_nmt_state(epos_bus_t* bus, int node_id) {
+  unsigned char nmt_state;
+  
+  pthread_mutex_lock(&bus->mutex);
+  nmt_state = bus->nodes[node_id].nmt_state;
+  pthread_mutex_unlock(&bus->mutex);
+  
+  return nmt_state;
+}
+
+double epos_bus_get_nmt_timestamp(epos_bus_t* bus, int node_id) {
+  double nmt_timestamp;
+  
+  pthread_mutex_lock(&bus->mutex);
+  nmt_timestamp = bus->nodes[node_id].nmt_timestamp;
+  pthread_mutex_unlock(&bus->mutex);
+  
+  return nmt_timestamp;
+}
+
+unsigned int epos_bus_get_sync_counter(epos_bus_t* bus) {
+  return __atomic_load_n(&bus->sync_counter, __ATOMIC_ACQUIRE);
+}
+
+void epos_bus_init(epos_bus_t* bus, can_device_t* can_dev) {
+  memset(bus->nodes, 0, sizeof(bus->nodes));
+  
+  bus->can_dev = can_dev;
+  bus->num_references = 0;
+  bus->num_opened = 0;
+  
+  bus->transport.data = can_dev;
+  bus->transport.error = &can_dev->error;
+  bus->transport.open = epos_bus_can_open;
+  bus->transport.close = epos_bus_can_close;
+  bus->transport.send = epos_bus_can_send;
+  bus->transport.receive = epos_bus_can_receive;
+  bus->transport.destroy = 0;
+  
+  bus->recorder = 0;
+  
+  pthread_mutex_init(&bus->mutex, 0);
+  pthread_cond_init(&bus->cond, 0);
+  pthread_mutex_init(&bus->send_mutex, 0);
+  bus->receiving = 0;
+  bus->num_dispatched = 0;
+  bus->result = EPOS_BUS_ERROR_NONE;
+  bus->sync_counter = 0;
+  
+  bus->next = 0;
+  
+  error_init(&bus->error, epos_bus_errors);
+}
+
+void epos_bus_destroy(epos_bus_t* bus) {
+  if (bus->transport.destroy)
+    bus->transport.destroy(bus->transport.data);
+  if (bus->recorder) {
+    epos_recorder_destroy(bus->recorder);
+    free(bus->recorder);
+  }
+  
+  pthread_mutex_destroy(&bus->send_mutex);
+  pthread_cond_destroy(&bus->cond);
+  pthread_mutex_destroy(&bus->mutex);
+  
+  error_destroy(&bus->error);
+}
+
+epos_emergency_queue_t* epos_bus_route(epos_bus_t* bus, const
+    can_message_t* message, unsigned int sync_counter, epos_emergency_t*
+    emergency) {
+  int node_id = message->id & EPOS_BUS_COB_ID_NODE_MASK;
+  int function = message->id & EPOS_BUS_COB_ID_FUNCTION_MASK;
+  epos_bus_node_t* node = &bus->nodes[node_id];
+  
+  if (node->dev) {
+    ++node->dev->statistics.num_received;
+    node->dev->statistics.num_bits_received += EPOS_DEVICE_FRAME_OVERHEAD+
+      8*message->length;
+  }
+  else
+    node = &bus->nodes[CAN_NODE_ID_BROADCAST];
+  
+  if (!node_id)
+    return 0;
+  else if (function == EPOS_BUS_COB_ID_EMERGENCY) {
+    if (node->dev) {
+      ++node->dev->statistics.num_emergencies;
+      epos_emergency_queue_receive_message(&node->dev->emergency, message,
+        emergency);
+      
+      return &node->dev->emergency;
+    }
+  }
+  else if ((message->id >= EPOS_BUS_COB_ID_PDO_MIN) &&
+      (message->id <= EPOS_BUS_COB_ID_PDO_MAX)) {
+    if (node->dev && node->dev->pdo_image)
+      epos_pdo_image_receive_message(node->dev->pdo_image, message,
+        sync_counter);
+  }
+  else if (function == EPOS_BUS_COB_ID_SDO_RECEIVE)
+    epos_bus_queue_push(&node->sdo, message);
+  else if (function == EPOS_BUS_COB_ID_NMT_ERROR_CONTROL) {
+    bus->nodes[node_id].nmt_state = message->content[0];
+    bus->nodes[node_id].nmt_timestamp = epos_clock_get();
+    epos_bus_queue_push(&node->nmt, message);
+  }
+  
+  return 0;
+}
+
+epos_bus_queue_t* epos_bus_get_queue(epos_bus_t* bus, int node_id,
+    epos_bus_queue_type_t type) {
+  switch (type) {
+    case epos_bus_nmt:
+      return &bus->nodes[node_id].nmt;
+    default:
+      return &bus->nodes[node_id].sdo;
+  }
+}
+
+void epos_bus_queue_push(epos_bus_queue_t* queue, const can_message_t*
+    message) {
+  if (queue->num_messages == EPOS_BUS_QUEUE_SIZE) {
+    queue->first = (queue->first+1) % EPOS_BUS_QUEUE_SIZE;
+    --queue->num_messages;
+    ++queue->num_dropped;
+  }
+  
+  queue->messages[(queue->first+queue->num_messages) %
+    EPOS_BUS_QUEUE_SIZE] = *message;
+  ++queue->num_messages;
+}
+
+int epos_bus_queue_pop(epos_bus_queue_t* queue, can_message_t* message) {
+  if (queue->num_messages) {
+    *message = queue->messages[queue->first];
+    queue->first = (queue->first+1) % EPOS_BUS_QUEUE_SIZE;
+    --queue->num_messages;
+    
+    return 1;
+  }
+  else
+    return 0;
+}
+
+int epos_bus_can_open(void* data) {
+  return can_device_open(data);
+}
+
+int epos_bus_can_close(void* data) {
+  return can_device_close(data);
+}
+
+int epos_bus_can_send(void* data, const can_message_t* message) {
+  return can_device_send_message(data, message);
+}
+
+int epos_bus_can_receive(void* data, can_message_t* message) {
+  return can_device_receive_message(data, message);
+}
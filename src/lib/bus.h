@@ -0,0 +1,360 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#ifndef EPOS_BUS_H
+#define EPOS_BUS_H
+
+#include <pthread.h>
+
+#include <can.h>
+
+#include <error/error.h>
+
+/** \file bus.h
+  * \brief EPOS bus dispatcher
+  * 
+  * The EPOS bus dispatcher demultiplexes the CAN messages received on a
+  * CAN device shared by several EPOS nodes. Messages are routed by COB
+  * identifier into per-node queues for SDO responses and NMT error
+  * control (boot-up and heartbeat) messages, whereas PDOs and emergencies
+  * are decoded directly into the process image and the emergency queue
+  * of the respective device.
+  * 
+  * Any thread waiting for a message becomes the receiver of the bus if
+  * no other thread currently receives. All other threads wait for the
+  * receiver to dispatch the next message, such that the bus may safely
+  * be shared among threads.
+  * 
+  * All messages are exchanged through the transport of the bus, which
+  * defaults to the CAN device, but may be replaced by an alternative
+  * transport such as the EPOS node simulator. The bus counts the SYNC
+  * messages sent through it, and received PDOs are stamped with the SYNC
+  * counter valid at their reception. If a recorder is attached
+  * to the bus, all messages sent and received are further logged by the
+  * recorder.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS bus constants
+  */
+//@{
+#define EPOS_BUS_QUEUE_SIZE                       16
+//@}
+
+/** \name COB Identifiers
+  * \brief Predefined EPOS bus COB identifiers
+  */
+//@{
+#define EPOS_BUS_COB_ID_SYNC                      0x080
+#define EPOS_BUS_COB_ID_EMERGENCY                 0x080
+#define EPOS_BUS_COB_ID_PDO_MIN                   0x180
+#define EPOS_BUS_COB_ID_PDO_MAX                   0x57F
+#define EPOS_BUS_COB_ID_SDO_RECEIVE               0x580
+#define EPOS_BUS_COB_ID_NMT_ERROR_CONTROL         0x700
+#define EPOS_BUS_COB_ID_NODE_MASK                 0x07F
+#define EPOS_BUS_COB_ID_FUNCTION_MASK             0x780
+//@}
+
+/** \name Error Codes
+  * \brief Predefined EPOS bus error codes
+  */
+//@{
+#define EPOS_BUS_ERROR_NONE                       0
+//!< Success
+#define EPOS_BUS_ERROR_RECEIVE                    1
+//!< Failed to receive from CAN device
+#define EPOS_BUS_ERROR_TIMEOUT                    2
+//!< Bus receive timeout
+#define EPOS_BUS_ERROR_SEND                       3
+//!< Failed to send to CAN device
+#define EPOS_BUS_ERROR_OPEN                       4
+//!< Failed to open CAN device
+#define EPOS_BUS_ERROR_CLOSE                      5
+//!< Failed to close CAN device
+#define EPOS_BUS_ERROR_REGISTER                   6
+//!< Node identifier already registered
+//@}
+
+/** \brief Predefined EPOS bus error descriptions
+  */
+extern const char* epos_bus_errors[];
+
+struct epos_device_t;
+struct epos_recorder_t;
+
+/** \brief EPOS bus queue types
+  */
+typedef enum {
+  epos_bus_sdo,                    //!< SDO response queue.
+  epos_bus_nmt                     //!< NMT error control message queue.
+} epos_bus_queue_type_t;
+
+/** \brief Structure defining an EPOS bus message queue
+  * 
+  * The message queue is a ring buffer of fixed size. If the queue is
+  * full, the least recently received message will be dropped.
+  */
+typedef struct epos_bus_queue_t {
+  can_message_t messages[EPOS_BUS_QUEUE_SIZE]; //!< The queued messages.
+  size_t first;                    //!< The index of the first message.
+  size_t num_messages;             //!< The number of queued messages.
+  size_t num_dropped;              //!< The number of dropped messages.
+} epos_bus_queue_t;
+
+/** \brief Structure defining an EPOS bus node
+  */
+typedef struct epos_bus_node_t {
+  struct epos_device_t* dev;       //!< The EPOS device of the node, or null.
+
+  epos_bus_queue_t sdo;            //!< The SDO response queue of the node.
+  epos_bus_queue_t nmt;            //!< The NMT error control queue.
+
+  unsigned char nmt_state;         //!< The most recently reported NMT state.
+  double nmt_timestamp;            //!< The time of the NMT state report.
+} epos_bus_node_t;
+
+/** \brief Structure defining an EPOS bus transport
+  * 
+  * The transport functions return zero on success, and a non-zero error
+  * code otherwise, in which case the error of the transport is expected
+  * to provide the cause of failure.
+  */
+typedef struct epos_bus_transport_t {
+  void* data;                      //!< The transport-specific data.
+  error_t* error;                  //!< The most recent transport error.
+
+  int (*open)(void* data);         //!< Open the transport.
+  int (*close)(void* data);        //!< Close the transport.
+  int (*send)(void* data,
+    const can_message_t* message); //!< Send a message.
+  int (*receive)(void* data,
+    can_message_t* message);       //!< Receive a message.
+  void (*destroy)(void* data);     //!< Destroy the transport data, or null.
+} epos_bus_transport_t;
+
+/** \brief Structure defining an EPOS bus
+  */
+typedef struct epos_bus_t {
+  can_device_t* can_dev;           //!< The CAN device of the bus.
+  epos_bus_transport_t transport;  //!< The message transport of the bus.
+  struct epos_recorder_t*
+    recorder;                      //!< The traffic recorder, or null.
+  size_t num_references;           //!< The number of attached EPOS devices.
+  size_t num_opened;               //!< The number of open references.
+
+  epos_bus_node_t
+    nodes[CAN_NODE_ID_MAX+1];      //!< The nodes of the bus by identifier.
+
+  pthread_mutex_t mutex;           //!< The bus mutex.
+  pthread_cond_t cond;             //!< The bus dispatch condition.
+  pthread_mutex_t send_mutex;      //!< The bus send mutex.
+  int receiving;                   //!< A thread is receiving from the bus.
+  size_t num_dispatched;           //!< The number of dispatch cycles.
+  int result;                      //!< The result of the last dispatch.
+  unsigned int sync_counter;       //!< The number of SYNC messages sent.
+
+  struct epos_bus_t* next;         //!< The next bus in the registry.
+
+  error_t error;                   //!< The most recent bus error.
+} epos_bus_t;
+
+/** \brief Attach an EPOS device to its bus
+  * \param[in] dev The EPOS device to be attached.
+  * \return The bus of the CAN device of the EPOS device. The bus will
+  *   be created if no other EPOS device shares this CAN device.
+  * 
+  * The device will receive all messages sent by the node with its node
+  * identifier. The device with node identifier zero further receives all
+  * messages sent by nodes which have no device attached. If another
+  * device is already registered for the node identifier, the device is
+  * attached without being registered, and epos_bus_register() will fail
+  * until the other device releases the node identifier. If the bus cannot
+  * be allocated, null is returned.
+  */
+epos_bus_t* epos_bus_attach(
+  struct epos_device_t* dev);
+
+/** \brief Detach an EPOS device from its bus
+  * \param[in] bus The EPOS bus to detach the device from.
+  * \param[in] dev The EPOS device to be detached. The bus will be
+  *   destroyed if this is the last device attached to the bus.
+  */
+void epos_bus_detach(
+  epos_bus_t* bus,
+  struct epos_device_t* dev);
+
+/** \brief Register an attached EPOS device for its node identifier
+  * \param[in] bus The EPOS bus the device is attached to.
+  * \param[in] dev The attached EPOS device to be registered for its
+  *   current node identifier. Any previous registration of the device
+  *   for another node identifier will be released.
+  * \return The resulting error code. Registration is rejected if another
+  *   device is registered for the same node identifier.
+  */
+int epos_bus_register(
+  epos_bus_t* bus,
+  struct epos_device_t* dev);
+
+/** \brief Find the EPOS bus of a CAN device
+  * \param[in] can_dev The CAN device to find the bus for.
+  * \return The bus of the specified CAN device, or null if no EPOS device
+  *   is attached to this CAN device.
+  */
+epos_bus_t* epos_bus_find(
+  can_device_t* can_dev);
+
+/** \brief Set the transport of an EPOS bus
+  * \param[in] bus The EPOS bus to set the transport for.
+  * \param[in] transport The transport to be used by the bus. The bus
+  *   takes ownership of the transport data.
+  */
+void epos_bus_set_transport(
+  epos_bus_t* bus,
+  const epos_bus_transport_t* transport);
+
+/** \brief Set the recorder of an EPOS bus
+  * \param[in] bus The EPOS bus to set the recorder for.
+  * \param[in] recorder The recorder to be used by the bus, or null. The
+  *   bus takes ownership of the recorder, which will be opened along
+  *   with the bus and destroyed along with the bus.
+  */
+void epos_bus_set_recorder(
+  epos_bus_t* bus,
+  struct epos_recorder_t* recorder);
+
+/** \brief Open an EPOS bus
+  * \param[in] bus The EPOS bus to be opened.
+  * \return The resulting error code.
+  * 
+  * Opening is reference-counted. Only the first open reference opens the
+  * transport and the recording of the bus, whereas further references
+  * leave threads receiving from the bus undisturbed.
+  */
+int epos_bus_open(
+  epos_bus_t* bus);
+
+/** \brief Close an EPOS bus
+  * \param[in] bus The EPOS bus to be closed.
+  * \return The resulting error code.
+  * 
+  * Closing releases an open reference of the bus. Only releasing the last
+  * reference closes the transport, after waiting for a thread receiving
+  * from the bus to finish dispatching its message. The recording of the bus, if any, is closed as well, such
+  * that the recording file is complete once the bus has been closed.
+  */
+int epos_bus_close(
+  epos_bus_t* bus);
+
+/** \brief Send a message on an EPOS bus
+  * \param[in] bus The EPOS bus to send the message on.
+  * \param[in] message The message to be sent.
+  * \return The resulting error code.
+  * 
+  * Messages are sent under the send mutex of the bus, such that threads
+  * sharing the bus never interleave their calls to the transport. If the
+  * message is a SYNC message, the SYNC counter of the bus is incremented
+  * before the message is sent, such that PDOs responding to this SYNC
+  * will never be stamped with the previous counter.
+  */
+int epos_bus_send(
+  epos_bus_t* bus,
+  const can_message_t* message);
+
+/** \brief Dispatch the next message received on an EPOS bus
+  * \param[in] bus The EPOS bus to dispatch the next message for.
+  * \return The resulting error code.
+  * 
+  * If another thread is receiving from the bus, this function waits for
+  * that thread to dispatch its message.
+  */
+int epos_bus_dispatch(
+  epos_bus_t* bus);
+
+/** \brief Receive a message from an EPOS bus node queue
+  * \param[in] bus The EPOS bus to receive the message from.
+  * \param[in] node_id The identifier of the node to receive the message
+  *   for.
+  * \param[in] type The type of the queue to receive the message from.
+  * \param[out] message The received message.
+  * \param[in] timeout The timeout of the receive operation in [s].
+  * \return The resulting error code.
+  */
+int epos_bus_receive(
+  epos_bus_t* bus,
+  int node_id,
+  epos_bus_queue_type_t type,
+  can_message_t* message,
+  double timeout);
+
+/** \brief Poll an EPOS bus node queue
+  * \param[in] bus The EPOS bus to poll the queue for.
+  * \param[in] node_id The identifier of the node to poll the queue for.
+  * \param[in] type The type of the queue to be polled.
+  * \param[out] message The polled message.
+  * \return One if a message has been taken from the queue, zero otherwise.
+  */
+int epos_bus_poll(
+  epos_bus_t* bus,
+  int node_id,
+  epos_bus_queue_type_t type,
+  can_message_t* message);
+
+/** \brief Clear an EPOS bus node queue
+  * \param[in] bus The EPOS bus to clear the queue for.
+  * \param[in] node_id The identifier of the node to clear the queue for.
+  * \param[in] type The type of the queue to be cleared.
+  */
+void epos_bus_clear(
+  epos_bus_t* bus,
+  int node_id,
+  epos_bus_queue_type_t type);
+
+/** \brief Retrieve the NMT state of an EPOS bus node
+  * \param[in] bus The EPOS bus to retrieve the NMT state from.
+  * \param[in] node_id The identifier of the node to retrieve the NMT
+  *   state for.
+  * \return The NMT state most recently reported by the node in a boot-up
+  *   or heartbeat message.
+  */
+unsigned char epos_bus_get_nmt_state(
+  epos_bus_t* bus,
+  int node_id);
+
+/** \brief Retrieve the SYNC counter of an EPOS bus
+  * \param[in] bus The EPOS bus to retrieve the SYNC counter from.
+  * \return The number of SYNC messages sent on the bus.
+  */
+unsigned int epos_bus_get_sync_counter(
+  epos_bus_t* bus);
+
+/** \brief Retrieve the NMT state report time of an EPOS bus node
+  * \param[in] bus The EPOS bus to retrieve the report time from.
+  * \param[in] node_id The identifier of the node to retrieve the report
+  *   time for.
+  * \return The time in [s] at which the node most recently reported its
+  *   NMT state in a boot-up or heartbeat message, or zero if the node has
+  *   not yet reported its NMT state.
+  */
+double epos_bus_get_nmt_timestamp(
+  epos_bus_t* bus,
+  int node_id);
+
+#endif
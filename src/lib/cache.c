@@ -0,0 +1,222 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "cache.h"
+#include "device.h"
+#include "sensor.h"
+#include "input.h"
+#include "home.h"
+#include "control.h"
+#include "current.h"
+#include "velocity.h"
+#include "position.h"
+#include "profile.h"
+#include "position_profile.h"
+#include "interpolated_position.h"
+#include "motor.h"
+
+const epos_cache_object_t epos_cache_objects[] = {
+  {EPOS_DEVICE_INDEX_HEARTBEAT, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_DEVICE_INDEX_ID, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_DEVICE_INDEX_CAN_BIT_RATE, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_DEVICE_INDEX_RS232_BAUD_RATE, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_DEVICE_INDEX_VERSION, EPOS_DEVICE_SUBINDEX_SOFTWARE_VERSION,
+    EPOS_DEVICE_SUBINDEX_HARDWARE_VERSION, epos_cache_static},
+  {EPOS_DEVICE_INDEX_MISC_CONFIGURATION, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_INPUT_INDEX_CONFIG, 0x01, 0x0A, epos_cache_parameter},
+  {EPOS_INPUT_INDEX_FUNCS, EPOS_INPUT_SUBINDEX_MASK,
+    EPOS_INPUT_SUBINDEX_EXECUTE, epos_cache_parameter},
+  {EPOS_HOME_INDEX_CURRENT_THRESHOLD, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_HOME_INDEX_POSITION, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_SENSOR_INDEX_CONFIGURATION, EPOS_SENSOR_SUBINDEX_PULSES,
+    EPOS_SENSOR_SUBINDEX_TYPE, epos_cache_parameter},
+  {EPOS_SENSOR_INDEX_CONFIGURATION, EPOS_SENSOR_SUBINDEX_POLARITY,
+    EPOS_SENSOR_SUBINDEX_POLARITY, epos_cache_parameter},
+  {EPOS_CONTROL_INDEX_MODE, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_POSITION_INDEX_MAX_FOLLOWING_ERROR, 0x00, 0x00,
+    epos_cache_parameter},
+  {EPOS_HOME_INDEX_OFFSET, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_POSITION_INDEX_SOFTWARE_LIMIT, EPOS_POSITION_SUBINDEX_NEG_LIMIT,
+    EPOS_POSITION_SUBINDEX_POS_LIMIT, epos_cache_parameter},
+  {EPOS_PROFILE_INDEX_MAX_VELOCITY, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_POSITION_PROFILE_INDEX_VELOCITY, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_PROFILE_INDEX_ACCELERATION, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_PROFILE_INDEX_DECELERATION, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_PROFILE_INDEX_QUICKSTOP_DECELERATION, 0x00, 0x00,
+    epos_cache_parameter},
+  {EPOS_PROFILE_INDEX_TYPE, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_HOME_INDEX_METHOD, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_HOME_INDEX_VELOCITIES, EPOS_HOME_SUBINDEX_SWITCH_SEARCH_VELOCITY,
+    EPOS_HOME_SUBINDEX_ZERO_SEARCH_VELOCITY, epos_cache_parameter},
+  {EPOS_HOME_INDEX_ACCELERATION, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_INTERPOLATED_POSITION_INDEX_SUBMODE, 0x00, 0x00,
+    epos_cache_parameter},
+  {EPOS_PROFILE_INDEX_MAX_ACCELERATION, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_CURRENT_INDEX_CONTROL_PARAMETERS, EPOS_CURRENT_SUBINDEX_P_GAIN,
+    EPOS_CURRENT_SUBINDEX_I_GAIN, epos_cache_parameter},
+  {EPOS_VELOCITY_INDEX_CONTROL_PARAMETERS, EPOS_VELOCITY_SUBINDEX_P_GAIN,
+    EPOS_VELOCITY_SUBINDEX_I_GAIN, epos_cache_parameter},
+  {EPOS_POSITION_INDEX_CONTROL_PARAMETERS, EPOS_POSITION_SUBINDEX_P_GAIN,
+    EPOS_POSITION_SUBINDEX_ACCELERATION_FACTOR, epos_cache_parameter},
+  {EPOS_MOTOR_INDEX_TYPE, 0x00, 0x00, epos_cache_parameter},
+  {EPOS_MOTOR_INDEX_DATA, EPOS_MOTOR_SUBINDEX_MAX_CONTINUOUS_CURRENT,
+    EPOS_MOTOR_SUBINDEX_THERMAL_TIME_CONSTANT, epos_cache_parameter},
+};
+
+epos_cache_entry_t* epos_cache_find_entry(epos_cache_t* cache, short index,
+  unsigned char subindex);
+
+void epos_cache_init(epos_cache_t* cache, int enabled) {
+  cache->enabled = enabled;
+  cache->num_entries = 0;
+  
+  cache->num_hits = 0;
+  cache->num_misses = 0;
+  cache->num_elided = 0;
+}
+
+void epos_cache_destroy(epos_cache_t* cache) {
+  cache->enabled = 0;
+  cache->num_entries = 0;
+}
+
+const epos_cache_object_t* epos_cache_find_object(short index, unsigned char
+    subindex) {
+  int num_objects = sizeof(epos_cache_objects)/sizeof(epos_cache_object_t);
+  int first = 0, last = num_objects-1;
+  
+  while (first <= last) {
+    int i = (first+last)/2;
+    
+    if (epos_cache_objects[i].index < index)
+      first = i+1;
+    else if (epos_cache_objects[i].index > index)
+      last = i-1;
+    else {
+      while ((i > 0) && (epos_cache_objects[i-1].index == index))
+        --i;
+      for ( ; (i < num_objects) && (epos_cache_objects[i].index == index);
+          ++i)
+        if ((subindex >= epos_cache_objects[i].min_subindex) &&
+            (subindex <= epos_cache_objects[i].max_subindex))
+          return &epos_cache_objects[i];
+      
+      return 0;
+    }
+  }
+  
+  return 0;
+}
+
+int epos_cache_read(epos_cache_t* cache, short index, unsigned char subindex,
+    unsigned char* data, size_t num) {
+  epos_cache_entry_t* entry;
+  
+  if (!cache->enabled || !epos_cache_find_object(index, subindex))
+    return 0;
+  
+  entry = epos_cache_find_entry(cache, index, subindex);
+  if (entry && (entry->num == num)) {
+    memcpy(data, entry->data, num);
+    ++cache->num_hits;
+    
+    return 1;
+  }
+  
+  ++cache->num_misses;
+  return 0;
+}
+
+int epos_cache_elide(epos_cache_t* cache, short index, unsigned char
+    subindex, const unsigned char* data, size_t num) {
+  epos_cache_entry_t* entry;
+  
+  if (!cache->enabled)
+    return 0;
+  
+  entry = epos_cache_find_entry(cache, index, subindex);
+  if (entry && (entry->num == num) && !memcmp(entry->data, data, num)) {
+    ++cache->num_elided;
+    return 1;
+  }
+  
+  return 0;
+}
+
+void epos_cache_update(epos_cache_t* cache, short index, unsigned char
+    subindex, const unsigned char* data, size_t num) {
+  const epos_cache_object_t* object;
+  epos_cache_entry_t* entry;
+  
+  if (!cache->enabled)
+    return;
+  
+  if (!(object = epos_cache_find_object(index, subindex)) ||
+      (num > EPOS_CACHE_MAX_OBJECT_SIZE)) {
+    epos_cache_invalidate(cache, index, subindex);
+    return;
+  }
+  
+  if (!(entry = epos_cache_find_entry(cache, index, subindex))) {
+    if (cache->num_entries >= EPOS_CACHE_MAX_ENTRIES)
+      return;
+    
+    entry = &cache->entries[cache->num_entries++];
+    entry->index = index;
+    entry->subindex = subindex;
+    entry->policy = object->policy;
+  }
+  
+  memcpy(entry->data, data, num);
+  entry->num = num;
+}
+
+void epos_cache_invalidate(epos_cache_t* cache, short index, unsigned char
+    subindex) {
+  epos_cache_entry_t* entry = epos_cache_find_entry(cache, index, subindex);
+  
+  if (entry)
+    *entry = cache->entries[--cache->num_entries];
+}
+
+void epos_cache_invalidate_parameters(epos_cache_t* cache) {
+  size_t i = 0;
+  
+  while (i < cache->num_entries) {
+    if (cache->entries[i].policy == epos_cache_parameter)
+      cache->entries[i] = cache->entries[--cache->num_entries];
+    else
+      ++i;
+  }
+}
+
+epos_cache_entry_t* epos_cache_find_entry(epos_cache_t* cache, short index,
+    unsigned char subindex) {
+  size_t i;
+  
+  for (i = 0; i < cache->num_entries; ++i)
+    if ((cache->entries[i].index == index) &&
+        (cache->entries[i].subindex == subindex))
+      return &cache->entries[i];
+  
+  return 0;
+}
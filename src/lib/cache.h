@@ -0,0 +1,196 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef EPOS_CACHE_H
+#define EPOS_CACHE_H
+
+#include <stdlib.h>
+
+/** \file cache.h
+  * \brief EPOS object dictionary cache
+  * 
+  * The object dictionary cache shadows the last known values of selected
+  * objects of an EPOS node on the host. Only objects listed in the cache
+  * whitelist are cached. These are either static objects, such as the
+  * hardware and software versions, or configuration parameters which are
+  * exclusively modified by the host.
+  * 
+  * Reads of cached objects are served from the cache once their values
+  * are known, and writes of cached objects are elided if they would not
+  * change the value known to the cache. Objects which change their value
+  * on the node, or writes which trigger an action on the node, such as
+  * the control word, must therefore never be cached.
+  * 
+  * Cached parameters are invalidated when the node is reset or its default
+  * parameters are restored. Static objects remain valid for the lifetime
+  * of the cache.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS cache constants
+  */
+//@{
+#define EPOS_CACHE_MAX_ENTRIES              128
+#define EPOS_CACHE_MAX_OBJECT_SIZE          4
+//@}
+
+/** \brief EPOS cache policies
+  */
+typedef enum {
+  epos_cache_static,                //!< The object is read-only and constant.
+  epos_cache_parameter              //!< The object is a host parameter.
+} epos_cache_policy_t;
+
+/** \brief Structure defining an EPOS cache whitelist object
+  */
+typedef struct epos_cache_object_t {
+  short index;                      //!< The index of the object.
+  unsigned char min_subindex;       //!< The first cached subindex.
+  unsigned char max_subindex;       //!< The last cached subindex.
+  epos_cache_policy_t policy;       //!< The cache policy of the object.
+} epos_cache_object_t;
+
+/** \brief Predefined EPOS cache whitelist
+  * 
+  * The whitelist is sorted by object index.
+  */
+extern const epos_cache_object_t epos_cache_objects[];
+
+/** \brief Structure defining an EPOS cache entry
+  */
+typedef struct epos_cache_entry_t {
+  short index;                      //!< The index of the cached object.
+  unsigned char subindex;           //!< The subindex of the cached object.
+  epos_cache_policy_t policy;       //!< The cache policy of the object.
+
+  unsigned char
+    data[EPOS_CACHE_MAX_OBJECT_SIZE]; //!< The last known object data.
+  size_t num;                       //!< The size of the object data in [B].
+} epos_cache_entry_t;
+
+/** \brief Structure defining an EPOS object dictionary cache
+  */
+typedef struct epos_cache_t {
+  int enabled;                      //!< The cache is enabled.
+
+  epos_cache_entry_t
+    entries[EPOS_CACHE_MAX_ENTRIES]; //!< The entries of the cache.
+  size_t num_entries;               //!< The number of valid cache entries.
+
+  size_t num_hits;                  //!< The number of reads served.
+  size_t num_misses;                //!< The number of reads not served.
+  size_t num_elided;                //!< The number of writes elided.
+} epos_cache_t;
+
+/** \brief Initialize EPOS object dictionary cache
+  * \param[in] cache The EPOS cache to be initialized.
+  * \param[in] enabled If zero, the cache will neither serve reads nor
+  *   elide writes.
+  */
+void epos_cache_init(
+  epos_cache_t* cache,
+  int enabled);
+
+/** \brief Destroy EPOS object dictionary cache
+  * \param[in] cache The EPOS cache to be destroyed.
+  */
+void epos_cache_destroy(
+  epos_cache_t* cache);
+
+/** \brief Find a whitelisted object
+  * \param[in] index The index of the object to be found.
+  * \param[in] subindex The subindex of the object to be found.
+  * \return The whitelist object matching the specified index and subindex
+  *   or null if the object may not be cached.
+  */
+const epos_cache_object_t* epos_cache_find_object(
+  short index,
+  unsigned char subindex);
+
+/** \brief Read an object from the EPOS cache
+  * \param[in] cache The EPOS cache to read the object from.
+  * \param[in] index The index of the object to be read.
+  * \param[in] subindex The subindex of the object to be read.
+  * \param[out] data The array the cached object data shall be stored to.
+  * \param[in] num The size of the object data to be read.
+  * \return Non-zero if the read was served from the cache.
+  */
+int epos_cache_read(
+  epos_cache_t* cache,
+  short index,
+  unsigned char subindex,
+  unsigned char* data,
+  size_t num);
+
+/** \brief Check if a write to the EPOS cache may be elided
+  * \param[in] cache The EPOS cache to check the write against.
+  * \param[in] index The index of the object to be written.
+  * \param[in] subindex The subindex of the object to be written.
+  * \param[in] data The array representing the object data to be written.
+  * \param[in] num The size of the object data to be written.
+  * \return Non-zero if the cache knows the object to already hold the
+  *   specified data.
+  */
+int epos_cache_elide(
+  epos_cache_t* cache,
+  short index,
+  unsigned char subindex,
+  const unsigned char* data,
+  size_t num);
+
+/** \brief Update an object in the EPOS cache
+  * \param[in] cache The EPOS cache to be updated.
+  * \param[in] index The index of the transferred object.
+  * \param[in] subindex The subindex of the transferred object.
+  * \param[in] data The array representing the transferred object data.
+  * \param[in] num The size of the transferred object data.
+  * 
+  * This function should be called whenever an object has been read from
+  * or written to the node. Objects which are not whitelisted are ignored.
+  */
+void epos_cache_update(
+  epos_cache_t* cache,
+  short index,
+  unsigned char subindex,
+  const unsigned char* data,
+  size_t num);
+
+/** \brief Invalidate an object in the EPOS cache
+  * \param[in] cache The EPOS cache to be invalidated.
+  * \param[in] index The index of the object to be invalidated.
+  * \param[in] subindex The subindex of the object to be invalidated.
+  * 
+  * The object should be invalidated whenever its value on the node is
+  * unknown, e.g., if a transfer of the object failed.
+  */
+void epos_cache_invalidate(
+  epos_cache_t* cache,
+  short index,
+  unsigned char subindex);
+
+/** \brief Invalidate all parameters in the EPOS cache
+  * \param[in] cache The EPOS cache to be invalidated.
+  * 
+  * Static objects remain valid.
+  */
+void epos_cache_invalidate_parameters(
+  epos_cache_t* cache);
+
+#endif
@@ -0,0 +1,42 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <time.h>
+
+#include "clock.h"
+
+double epos_clock_get(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  
+  return time.tv_sec+time.tv_nsec/1e9;
+}
+
+void epos_clock_sleep(double period) {
+  struct timespec time;
+  
+  if (period > 0.0) {
+    time.tv_sec = period;
+    time.tv_nsec = (period-time.tv_sec)*1e9;
+    
+    clock_nanosleep(CLOCK_MONOTONIC, 0, &time, 0);
+  }
+}
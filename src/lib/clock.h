@@ -0,0 +1,45 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#ifndef EPOS_CLOCK_H
+#define EPOS_CLOCK_H
+
+/** \file clock.h
+  * \brief EPOS clock functions
+  * 
+  * Timeouts and polling periods are measured by a monotonic clock, which
+  * is unaffected by adjustments of the system time.
+  */
+
+/** \brief Retrieve the monotonic clock time
+  * \return The time of the monotonic clock in [s]. The reference of the
+  *   clock is unspecified, and only differences between clock times are
+  *   meaningful.
+  */
+double epos_clock_get(void);
+
+/** \brief Sleep for a period of the monotonic clock
+  * \param[in] period The period to sleep for in [s].
+  */
+void epos_clock_sleep(
+  double period);
+
+#endif
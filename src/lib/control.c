@@ -34,6 +34,7 @@ char epos_control_modes[] = {
   -4,
   -5,
   -6,
+   7,
 };
 
 void epos_control_init(epos_control_t* control, epos_device_t* dev,
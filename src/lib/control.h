@@ -53,7 +53,8 @@ typedef enum {
   epos_control_current,       //!< Current operating mode.
   epos_control_diagnostic,    //!< Diagnostic operating mode.
   epos_control_master_enc,    //!< Master encoder operating mode.
-  epos_control_step_dir       //!< Step/direction operating mode.
+  epos_control_step_dir,      //!< Step/direction operating mode.
+  epos_control_interpolated_pos //!< Interpolated position operating mode.
 } epos_control_mode_t;
 
 /** \brief Structure defining an EPOS controller
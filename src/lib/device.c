@@ -18,13 +18,18 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
-#include <time.h>
-#include <sys/time.h>
 
 #include "device.h"
 #include "error.h"
+#include "bus.h"
+#include "sdo.h"
+#include "pdo.h"
+#include "clock.h"
+
+#include "macros.h"
 
 const char* epos_device_errors[] = {
   "Success",
@@ -35,11 +40,10 @@ const char* epos_device_errors[] = {
   "Failed to receive from EPOS device",
   "EPOS communication error (abort)",
   "EPOS internal device error",
-  "Failed to read EPOS device data object",
-  "Failed to write EPOS device data object",
   "Invalid EPOS CAN bit rate",
   "Invalid EPOS RS232 baud rate",
   "EPOS device timeout",
+  "Invalid EPOS SDO response",
 };
 
 short epos_device_hardware_versions[] = {
@@ -108,6 +112,31 @@ int epos_device_rs232_baud_rates[] = {
   115200,
 };
 
+int epos_device_check_response(epos_device_t* dev, const can_message_t*
+  message, unsigned char cs, short index, unsigned char subindex);
+int epos_device_check_segment(epos_device_t* dev, const can_message_t*
+  message, unsigned char cs, unsigned char toggle, short index, unsigned
+  char subindex);
+int epos_device_check_block(epos_device_t* dev, const can_message_t*
+  message, unsigned char cs, unsigned char subcommand, short index,
+  unsigned char subindex);
+int epos_device_block_rejected(epos_device_t* dev, const can_message_t*
+  message);
+int epos_device_block_overflow(epos_device_t* dev, short index, unsigned
+  char subindex, size_t num);
+void epos_device_abort(epos_device_t* dev, short index, unsigned char
+  subindex, int code);
+int epos_device_upload(epos_device_t* dev, short index, unsigned char
+  subindex, unsigned char* data, size_t num);
+int epos_device_download(epos_device_t* dev, short index, unsigned char
+  subindex, unsigned char* data, size_t num);
+int epos_device_upload_block(epos_device_t* dev, short index, unsigned char
+  subindex, unsigned char* data, size_t num);
+int epos_device_download_block(epos_device_t* dev, short index, unsigned
+  char subindex, unsigned char* data, size_t num);
+int epos_device_retry(epos_device_t* dev, short index, unsigned char
+  subindex, int download, int* retry);
+
 void epos_device_init(epos_device_t* dev, can_device_t* can_dev, int node_id,
     int reset) {
   dev->can_dev = can_dev;
@@ -121,20 +150,70 @@ void epos_device_init(epos_device_t* dev, can_device_t* can_dev, int node_id,
   dev->num_read = 0;
   dev->num_written = 0;
   
+  dev->pdo_image = 0;
+  dev->bus = epos_bus_attach(dev);
+  dev->bus_open = 0;
+  dev->poll_period = EPOS_DEVICE_POLL_PERIOD;
+  dev->block_transfer = 1;
+  dev->timeout = EPOS_DEVICE_RECEIVE_TIMEOUT;
+  dev->retries = EPOS_DEVICE_RETRIES;
+  dev->retry_backoff = EPOS_DEVICE_RETRY_BACKOFF;
+  dev->retry_downloads = 0;
+  epos_cache_init(&dev->cache, 0);
+  epos_emergency_queue_init(&dev->emergency);
+  
+  dev->sdo_timestamp = 0.0;
+  dev->sdo_index = 0;
+  epos_histogram_init(&dev->latency);
+  epos_histogram_set_init(&dev->latencies);
+  epos_device_reset_statistics(dev);
+  
   error_init(&dev->error, epos_device_errors);
+  if (!dev->bus)
+    error_setf(&dev->error, EPOS_DEVICE_ERROR_OPEN,
+      "[Node 0x%hX]: Failed to attach bus", dev->node_id);
 }
 
 void epos_device_destroy(epos_device_t* dev) {
+  if (dev->bus_open) {
+    epos_bus_close(dev->bus);
+    dev->bus_open = 0;
+  }
+  if (dev->bus)
+    epos_bus_detach(dev->bus, dev);
+  dev->bus = 0;
+  
   dev->can_dev = 0;
   dev->node_id = CAN_NODE_ID_BROADCAST;
+  epos_cache_destroy(&dev->cache);
+  epos_histogram_set_destroy(&dev->latencies);
   
   error_destroy(&dev->error);
 }
 
 int epos_device_open(epos_device_t* dev) {
+  can_message_t message;
+  
   error_clear(&dev->error);
   
-  if (!can_device_open(dev->can_dev)) {
+  if (!dev->bus) {
+    error_setf(&dev->error, EPOS_DEVICE_ERROR_OPEN,
+      "[Node 0x%hX]: Failed to attach bus", dev->node_id);
+    return dev->error.code;
+  }
+  if (epos_bus_register(dev->bus, dev)) {
+    error_blame(&dev->error, &dev->bus->error, EPOS_DEVICE_ERROR_OPEN);
+    return dev->error.code;
+  }
+  
+  if (!dev->bus_open)
+    dev->bus_open = !epos_bus_open(dev->bus);
+  
+  if (dev->bus_open) {
+    while (epos_bus_poll(dev->bus, dev->node_id, epos_bus_nmt, &message))
+      if (!message.content[0])
+        epos_cache_invalidate_parameters(&dev->cache);
+    
     if(dev->reset) {
       //if an id is known, hard reset that device
 //      if(dev->node_id > 0) {
@@ -150,6 +229,10 @@ int epos_device_open(epos_device_t* dev) {
 
     dev->node_id = epos_device_get_id(dev);
     error_return(&dev->error);
+    if (epos_bus_register(dev->bus, dev)) {
+      error_blame(&dev->error, &dev->bus->error, EPOS_DEVICE_ERROR_OPEN);
+      return dev->error.code;
+    }
 
     dev->can_bit_rate = epos_device_get_can_bit_rate(dev);
     error_return(&dev->error);
@@ -173,14 +256,18 @@ int epos_device_open(epos_device_t* dev) {
     epos_device_shutdown(dev);
   }
   else
-    error_blame(&dev->error, &dev->can_dev->error, EPOS_DEVICE_ERROR_OPEN);
+    error_blame(&dev->error, &dev->bus->error, EPOS_DEVICE_ERROR_OPEN);
   
   return dev->error.code;
 }
 
 int epos_device_close(epos_device_t* dev) {
-  if (!epos_device_shutdown(dev) && can_device_close(dev->can_dev))
-    error_blame(&dev->error, &dev->can_dev->error, EPOS_DEVICE_ERROR_CLOSE);
+  if (dev->bus_open && !epos_device_shutdown(dev)) {
+    dev->bus_open = 0;
+    
+    if (epos_bus_close(dev->bus))
+      error_blame(&dev->error, &dev->bus->error, EPOS_DEVICE_ERROR_CLOSE);
+  }
   
   return dev->error.code;
 }
@@ -189,130 +276,520 @@ int epos_device_send_message(epos_device_t* dev, const can_message_t*
     message) {
   error_clear(&dev->error);
   
-  if (can_device_send_message(dev->can_dev, message))
-    error_blame(&dev->error, &dev->can_dev->error, EPOS_DEVICE_ERROR_SEND);
+  if (!dev->bus) {
+    error_set(&dev->error, EPOS_DEVICE_ERROR_SEND);
+    return dev->error.code;
+  }
+  if (message->id == CAN_COB_ID_SDO_SEND+dev->node_id) {
+    epos_bus_clear(dev->bus, dev->node_id, epos_bus_sdo);
+    dev->sdo_timestamp = epos_clock_get();
+  }
+  
+  if (epos_bus_send(dev->bus, message))
+    error_blame(&dev->error, &dev->bus->error, EPOS_DEVICE_ERROR_SEND);
+  else
+    epos_device_count_sent(dev, message);
 
   return dev->error.code;
 }
 
 int epos_device_receive_message(epos_device_t* dev, can_message_t* message) {
+  int result;
+  
   error_clear(&dev->error);
   
-  if (!can_device_receive_message(dev->can_dev, message)) {
-    if ((message->id >= CAN_COB_ID_SDO_EMERGENCY) &&
-        (message->id <= CAN_COB_ID_SDO_EMERGENCY+CAN_NODE_ID_MAX)) {
-      short code;
-
-      memcpy(&code, &message->content[0], sizeof(code));
-      if (code)
-        error_setf(&dev->error, EPOS_DEVICE_ERROR_INTERNAL, "[Node 0x%hX]: %s (0x%hX)",
-          message->id-CAN_COB_ID_SDO_EMERGENCY, epos_error_device(code), code);
-    }
-    else if (message->content[0] == CAN_CMD_SDO_ABORT) {
-      int code;
+  if (!dev->bus) {
+    error_set(&dev->error, EPOS_DEVICE_ERROR_RECEIVE);
+    return dev->error.code;
+  }
+  result = epos_bus_receive(dev->bus, dev->node_id, epos_bus_sdo, message,
+    dev->timeout);
+  if (result == EPOS_BUS_ERROR_TIMEOUT) {
+    ++dev->statistics.num_timeouts;
+    error_setf(&dev->error, EPOS_DEVICE_ERROR_WAIT_TIMEOUT,
+      "[Node 0x%hX]", dev->node_id);
+    return dev->error.code;
+  }
+  else if (result) {
+    error_blame(&dev->error, &dev->bus->error, EPOS_DEVICE_ERROR_RECEIVE);
+    return dev->error.code;
+  }
+  
+  epos_device_count_round_trip(dev, dev->sdo_index,
+    epos_clock_get()-dev->sdo_timestamp);
+  
+  if (message->content[0] == CAN_CMD_SDO_ABORT) {
+    int code;
 
-      memcpy(&code, &message->content[4], sizeof(code));
-      error_setf(&dev->error, EPOS_DEVICE_ERROR_ABORT, "[Node 0x%hX]: %s (0x%X)",
-        message->id-CAN_COB_ID_SDO_RECEIVE, epos_error_comm(code), code);
-    }
+    memcpy(&code, &message->content[4], sizeof(code));
+    epos_device_count_abort(&dev->statistics, code);
+    error_setf(&dev->error, EPOS_DEVICE_ERROR_ABORT, "[Node 0x%hX]: %s (0x%X)",
+      message->id-CAN_COB_ID_SDO_RECEIVE, epos_error_comm(code), code);
   }
-  else
-    error_blame(&dev->error, &dev->can_dev->error, EPOS_DEVICE_ERROR_RECEIVE);
   
   return dev->error.code;
 }
 
 int epos_device_read(epos_device_t* dev, short index, unsigned char subindex,
     unsigned char* data, size_t num) {
+  int result, retry = 0;
+  
+  while (((result = epos_device_upload(dev, index, subindex, data, num)) <
+    0) && epos_device_retry(dev, index, subindex, 0, &retry));
+  
+  return result;
+}
+
+int epos_device_write(epos_device_t* dev, short index, unsigned char subindex,
+    unsigned char* data, size_t num) {
+  int result, retry = 0;
+  
+  while (((result = epos_device_download(dev, index, subindex, data, num)) <
+    0) && epos_device_retry(dev, index, subindex, 1, &retry));
+  
+  return result;
+}
+
+int epos_device_read_block(epos_device_t* dev, short index, unsigned char
+    subindex, unsigned char* data, size_t num) {
+  int result, retry = 0;
+  
+  while (((result = epos_device_upload_block(dev, index, subindex, data,
+    num)) < 0) && epos_device_retry(dev, index, subindex, 0, &retry));
+  
+  return result;
+}
+
+int epos_device_write_block(epos_device_t* dev, short index, unsigned char
+    subindex, unsigned char* data, size_t num) {
+  int result, retry = 0;
+  
+  while (((result = epos_device_download_block(dev, index, subindex, data,
+    num)) < 0) && epos_device_retry(dev, index, subindex, 1, &retry));
+  
+  return result;
+}
+
+int epos_device_upload(epos_device_t* dev, short index, unsigned char
+    subindex, unsigned char* data, size_t num) {
   can_message_t message;
-  memset(&message, 0, sizeof(can_message_t));
+  unsigned char toggle = 0;
+  size_t num_read = 0, size;
 
   error_clear(&dev->error);
+  dev->sdo_index = index;
+  
+  if (epos_cache_read(&dev->cache, index, subindex, data, num))
+    return num;
   
+  memset(&message, 0, sizeof(can_message_t));
   message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
-  message.content[0] = CAN_CMD_SDO_READ_SEND;
+  message.content[0] = EPOS_SDO_CS_UPLOAD_REQUEST;
   message.content[1] = index;
   message.content[2] = index >> 8;
   message.content[3] = subindex;
   message.length = 8;
 
   if (epos_device_send_message(dev, &message) ||
-      epos_device_receive_message(dev, &message))
+      epos_device_receive_message(dev, &message) ||
+      epos_device_check_response(dev, &message, EPOS_SDO_CS_UPLOAD_RESPONSE,
+        index, subindex))
     return -dev->error.code;
-  
-  memcpy(data, &message.content[4], num);
   ++dev->num_read;
+  
+  if (message.content[0] & EPOS_SDO_FLAG_EXPEDITED) {
+    size = EPOS_SDO_MAX_EXPEDITED_SIZE;
+    if (message.content[0] & EPOS_SDO_FLAG_SIZE)
+      size -= (message.content[0] >> 2) & 0x03;
+    
+    num_read = min(size, num);
+    memcpy(data, &message.content[4], num_read);
+  }
+  else {
+    if (message.content[0] & EPOS_SDO_FLAG_SIZE) {
+      size = message.content[4]+(message.content[5] << 8)+
+        (message.content[6] << 16)+((size_t)message.content[7] << 24);
+      if (size > num) {
+        epos_device_abort(dev, index, subindex, EPOS_SDO_ABORT_LENGTH_HIGH);
+        error_setf(&dev->error, EPOS_DEVICE_ERROR_INVALID_SIZE, "%lu",
+          (unsigned long)size);
+        return -dev->error.code;
+      }
+    }
+    
+    do {
+      memset(&message, 0, sizeof(can_message_t));
+      message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
+      message.content[0] = EPOS_SDO_CS_UPLOAD_SEGMENT_REQUEST | toggle;
+      message.length = 8;
+      
+      if (epos_device_send_message(dev, &message) ||
+          epos_device_receive_message(dev, &message) ||
+          epos_device_check_segment(dev, &message,
+            EPOS_SDO_CS_UPLOAD_SEGMENT_RESPONSE, toggle, index, subindex))
+        return -dev->error.code;
+      
+      size = EPOS_SDO_MAX_SEGMENT_SIZE-((message.content[0] >> 1) & 0x07);
+      if (num_read+size > num) {
+        epos_device_abort(dev, index, subindex, EPOS_SDO_ABORT_LENGTH_HIGH);
+        error_setf(&dev->error, EPOS_DEVICE_ERROR_INVALID_SIZE, "%lu",
+          (unsigned long)(num_read+size));
+        return -dev->error.code;
+      }
+      
+      memcpy(&data[num_read], &message.content[1], size);
+      num_read += size;
+      toggle ^= EPOS_SDO_FLAG_TOGGLE;
+      ++dev->num_read;
+    }
+    while (!(message.content[0] & EPOS_SDO_FLAG_LAST));
+  }
+  epos_cache_update(&dev->cache, index, subindex, data, num_read);
+  dev->statistics.num_bytes_read += num_read;
 
-  return num;
+  return num_read;
 }
 
-int epos_device_write(epos_device_t* dev, short index, unsigned char subindex,
-    unsigned char* data, size_t num) {
+int epos_device_download(epos_device_t* dev, short index, unsigned char
+    subindex, unsigned char* data, size_t num) {
   can_message_t message;
-  size_t num_written = 0;
+  unsigned char toggle = 0;
+  size_t num_written = 0, size;
 
   error_clear(&dev->error);
+  dev->sdo_index = index;
   
-  if (num > 4) {
-    message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
-    message.content[0] = CAN_CMD_SDO_WRITE_SEND_N_BYTE_INIT;
-    message.content[1] = index;
-    message.content[2] = index >> 8;
-    message.content[3] = subindex;
+  if (!num) {
+    error_setf(&dev->error, EPOS_DEVICE_ERROR_INVALID_SIZE, "%lu",
+      (unsigned long)num);
+    return -dev->error.code;
+  }
+  
+  if (epos_cache_elide(&dev->cache, index, subindex, data, num))
+    return num;
+  epos_cache_invalidate(&dev->cache, index, subindex);
+  
+  memset(&message, 0, sizeof(can_message_t));
+  message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
+  message.content[0] = EPOS_SDO_CS_DOWNLOAD_REQUEST | EPOS_SDO_FLAG_SIZE;
+  message.content[1] = index;
+  message.content[2] = index >> 8;
+  message.content[3] = subindex;
+  message.length = 8;
+  
+  if (num <= EPOS_SDO_MAX_EXPEDITED_SIZE) {
+    message.content[0] |= EPOS_SDO_FLAG_EXPEDITED |
+      ((EPOS_SDO_MAX_EXPEDITED_SIZE-num) << 2);
+    memcpy(&message.content[4], data, num);
+    num_written = num;
+  }
+  else {
     message.content[4] = num;
     message.content[5] = num >> 8;
     message.content[6] = num >> 16;
     message.content[7] = num >> 24;
+  }
+  
+  if (epos_device_send_message(dev, &message) ||
+      epos_device_receive_message(dev, &message) ||
+      epos_device_check_response(dev, &message, EPOS_SDO_CS_DOWNLOAD_RESPONSE,
+        index, subindex))
+    return -dev->error.code;
+  ++dev->num_written;
+  
+  while (num_written < num) {
+    size = min(num-num_written, EPOS_SDO_MAX_SEGMENT_SIZE);
+    
+    memset(&message, 0, sizeof(can_message_t));
+    message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
+    message.content[0] = EPOS_SDO_CS_DOWNLOAD_SEGMENT_REQUEST | toggle |
+      ((EPOS_SDO_MAX_SEGMENT_SIZE-size) << 1);
+    if (num_written+size == num)
+      message.content[0] |= EPOS_SDO_FLAG_LAST;
+    memcpy(&message.content[1], &data[num_written], size);
+    message.length = 8;
     
     if (epos_device_send_message(dev, &message) ||
-        epos_device_receive_message(dev, &message))
+        epos_device_receive_message(dev, &message) ||
+        epos_device_check_segment(dev, &message,
+          EPOS_SDO_CS_DOWNLOAD_SEGMENT_RESPONSE, toggle, index, subindex))
       return -dev->error.code;
-      
+    
+    num_written += size;
+    toggle ^= EPOS_SDO_FLAG_TOGGLE;
     ++dev->num_written;
   }
+  epos_cache_update(&dev->cache, index, subindex, data, num);
+  dev->statistics.num_bytes_written += num;
+
+  return num_written;
+}
+
+int epos_device_upload_block(epos_device_t* dev, short index, unsigned char
+    subindex, unsigned char* data, size_t num) {
+  can_message_t message;
+  unsigned char segment[EPOS_SDO_MAX_SEGMENT_SIZE];
+  unsigned char sequence, last = 0, crc = 0;
+  size_t num_read = 0, num_segment = 0, size;
+
+  if (!dev->block_transfer || (num <= EPOS_SDO_MAX_EXPEDITED_SIZE))
+    return epos_device_upload(dev, index, subindex, data, num);
   
-  while (num_written < num) {
-    message.id = CAN_COB_ID_SDO_SEND+dev->node_id;    
-    switch (num) {
-      case 1 :
-        message.content[0] = CAN_CMD_SDO_WRITE_SEND_1_BYTE;
-        break;
-      case 2 :
-        message.content[0] = CAN_CMD_SDO_WRITE_SEND_2_BYTE;
-        break;
-      case 4 :
-        message.content[0] = CAN_CMD_SDO_WRITE_SEND_4_BYTE;
-        break;
-      default:
-        if (num > 4)
-          message.content[0] = CAN_CMD_SDO_WRITE_SEND_N_BYTE_SEGMENT;
-        else {
-          error_setf(&dev->error, EPOS_DEVICE_ERROR_INVALID_SIZE, "%d", num);
-          return -dev->error.code;
+  error_clear(&dev->error);
+  dev->sdo_index = index;
+  
+  memset(&message, 0, sizeof(can_message_t));
+  message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
+  message.content[0] = EPOS_SDO_CS_BLOCK_UPLOAD_REQUEST |
+    EPOS_SDO_BLOCK_FLAG_CRC | EPOS_SDO_BLOCK_INITIATE;
+  message.content[1] = index;
+  message.content[2] = index >> 8;
+  message.content[3] = subindex;
+  message.content[4] = EPOS_DEVICE_BLOCK_SIZE;
+  message.length = 8;
+  
+  if (epos_device_send_message(dev, &message))
+    return -dev->error.code;
+  if (epos_device_receive_message(dev, &message)) {
+    if (epos_device_block_rejected(dev, &message)) {
+      dev->block_transfer = 0;
+      return epos_device_upload(dev, index, subindex, data, num);
+    }
+    return -dev->error.code;
+  }
+  if (epos_device_check_response(dev, &message,
+      EPOS_SDO_CS_BLOCK_UPLOAD_RESPONSE, index, subindex) ||
+      epos_device_check_block(dev, &message,
+        EPOS_SDO_CS_BLOCK_UPLOAD_RESPONSE, EPOS_SDO_BLOCK_INITIATE, index,
+        subindex))
+    return -dev->error.code;
+  ++dev->num_read;
+  
+  crc = message.content[0] & EPOS_SDO_BLOCK_FLAG_CRC;
+  if (message.content[0] & EPOS_SDO_BLOCK_FLAG_SIZE) {
+    size = message.content[4]+(message.content[5] << 8)+
+      (message.content[6] << 16)+((size_t)message.content[7] << 24);
+    if (size > num)
+      return -epos_device_block_overflow(dev, index, subindex, size);
+  }
+  
+  memset(&message, 0, sizeof(can_message_t));
+  message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
+  message.content[0] = EPOS_SDO_CS_BLOCK_UPLOAD_REQUEST |
+    EPOS_SDO_BLOCK_START;
+  message.length = 8;
+  
+  if (epos_device_send_message(dev, &message))
+    return -dev->error.code;
+  
+  while (!last) {
+    sequence = 0;
+    
+    do {
+      if (epos_device_receive_message(dev, &message))
+        return -dev->error.code;
+      
+      if ((message.content[0] & EPOS_SDO_BLOCK_SEQUENCE_MASK) ==
+          sequence+1) {
+        if (num_segment) {
+          if (num_read+num_segment > num)
+            return -epos_device_block_overflow(dev, index, subindex,
+              num_read+num_segment);
+          memcpy(&data[num_read], segment, num_segment);
+          num_read += num_segment;
         }
+        memcpy(segment, &message.content[1], EPOS_SDO_MAX_SEGMENT_SIZE);
+        num_segment = EPOS_SDO_MAX_SEGMENT_SIZE;
+        
+        last = message.content[0] & EPOS_SDO_BLOCK_FLAG_LAST;
+        ++sequence;
+      }
+      ++dev->num_read;
     }
-    message.content[1] = index;
-    message.content[2] = index >> 8;
-    message.content[3] = subindex;
-    message.content[4] = data[num_written];
-    message.content[5] = (num-num_written > 1) ? data[num_written+1] : 0x00;
-    message.content[6] = (num-num_written > 2) ? data[num_written+2] : 0x00;
-    message.content[7] = (num-num_written > 2) ? data[num_written+3] : 0x00;
+    while (!(message.content[0] & EPOS_SDO_BLOCK_FLAG_LAST) &&
+      ((message.content[0] & EPOS_SDO_BLOCK_SEQUENCE_MASK) <
+        EPOS_DEVICE_BLOCK_SIZE));
+    
+    memset(&message, 0, sizeof(can_message_t));
+    message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
+    message.content[0] = EPOS_SDO_CS_BLOCK_UPLOAD_REQUEST |
+      EPOS_SDO_BLOCK_ACK;
+    message.content[1] = sequence;
+    message.content[2] = EPOS_DEVICE_BLOCK_SIZE;
     message.length = 8;
+    
+    if (epos_device_send_message(dev, &message))
+      return -dev->error.code;
+  }
+  
+  if (epos_device_receive_message(dev, &message) ||
+      epos_device_check_block(dev, &message,
+        EPOS_SDO_CS_BLOCK_UPLOAD_RESPONSE, EPOS_SDO_BLOCK_END, index,
+        subindex))
+    return -dev->error.code;
+  ++dev->num_read;
+  
+  num_segment -= (message.content[0] >> 2) & 0x07;
+  if (num_read+num_segment > num)
+    return -epos_device_block_overflow(dev, index, subindex,
+      num_read+num_segment);
+  memcpy(&data[num_read], segment, num_segment);
+  num_read += num_segment;
+  
+  if (crc && (epos_sdo_crc(data, num_read, 0) != message.content[1]+
+      (message.content[2] << 8))) {
+    epos_device_abort(dev, index, subindex, EPOS_SDO_ABORT_CRC);
+    error_setf(&dev->error, EPOS_DEVICE_ERROR_INVALID_RESPONSE,
+      "[Node 0x%hX]: %s", dev->node_id, epos_error_comm(EPOS_SDO_ABORT_CRC));
+    return -dev->error.code;
+  }
+  
+  memset(&message, 0, sizeof(can_message_t));
+  message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
+  message.content[0] = EPOS_SDO_CS_BLOCK_UPLOAD_REQUEST | EPOS_SDO_BLOCK_END;
+  message.length = 8;
+  
+  if (epos_device_send_message(dev, &message))
+    return -dev->error.code;
+  epos_cache_update(&dev->cache, index, subindex, data, num_read);
+  dev->statistics.num_bytes_read += num_read;
+  
+  return num_read;
+}
 
-    if (epos_device_send_message(dev, &message) ||
-        epos_device_receive_message(dev, &message))
+int epos_device_download_block(epos_device_t* dev, short index, unsigned
+    char subindex, unsigned char* data, size_t num) {
+  can_message_t message;
+  unsigned char sequence, block_size, crc = 0;
+  size_t num_written = 0, offset, size;
+  unsigned short checksum;
+
+  if (!dev->block_transfer || (num <= EPOS_SDO_MAX_EXPEDITED_SIZE))
+    return epos_device_download(dev, index, subindex, data, num);
+  
+  error_clear(&dev->error);
+  dev->sdo_index = index;
+  epos_cache_invalidate(&dev->cache, index, subindex);
+  
+  memset(&message, 0, sizeof(can_message_t));
+  message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
+  message.content[0] = EPOS_SDO_CS_BLOCK_DOWNLOAD_REQUEST |
+    EPOS_SDO_BLOCK_FLAG_CRC | EPOS_SDO_BLOCK_FLAG_SIZE |
+    EPOS_SDO_BLOCK_INITIATE;
+  message.content[1] = index;
+  message.content[2] = index >> 8;
+  message.content[3] = subindex;
+  message.content[4] = num;
+  message.content[5] = num >> 8;
+  message.content[6] = num >> 16;
+  message.content[7] = num >> 24;
+  message.length = 8;
+  
+  if (epos_device_send_message(dev, &message))
+    return -dev->error.code;
+  if (epos_device_receive_message(dev, &message)) {
+    if (epos_device_block_rejected(dev, &message)) {
+      dev->block_transfer = 0;
+      return epos_device_download(dev, index, subindex, data, num);
+    }
+    return -dev->error.code;
+  }
+  if (epos_device_check_response(dev, &message,
+      EPOS_SDO_CS_BLOCK_DOWNLOAD_RESPONSE, index, subindex) ||
+      epos_device_check_block(dev, &message,
+        EPOS_SDO_CS_BLOCK_DOWNLOAD_RESPONSE, EPOS_SDO_BLOCK_INITIATE, index,
+        subindex))
+    return -dev->error.code;
+  ++dev->num_written;
+  
+  crc = message.content[0] & EPOS_SDO_BLOCK_FLAG_CRC;
+  block_size = message.content[4];
+  
+  while (num_written < num) {
+    if (!block_size || (block_size > EPOS_SDO_MAX_BLOCK_SIZE)) {
+      epos_device_abort(dev, index, subindex, EPOS_SDO_ABORT_BLOCK_SIZE);
+      error_setf(&dev->error, EPOS_DEVICE_ERROR_INVALID_RESPONSE,
+        "[Node 0x%hX]: %s", dev->node_id,
+        epos_error_comm(EPOS_SDO_ABORT_BLOCK_SIZE));
       return -dev->error.code;
+    }
     
-    num_written += (num_written+4 > num) ? num : num_written+4;
-    ++dev->num_written;
+    for (sequence = 0, offset = num_written; (sequence < block_size) &&
+        (offset < num); offset += size) {
+      size = min(num-offset, EPOS_SDO_MAX_SEGMENT_SIZE);
+      
+      memset(&message, 0, sizeof(can_message_t));
+      message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
+      message.content[0] = ++sequence;
+      if (offset+size == num)
+        message.content[0] |= EPOS_SDO_BLOCK_FLAG_LAST;
+      memcpy(&message.content[1], &data[offset], size);
+      message.length = 8;
+      
+      if (epos_bus_send(dev->bus, &message)) {
+        error_blame(&dev->error, &dev->bus->error, EPOS_DEVICE_ERROR_SEND);
+        return -dev->error.code;
+      }
+      epos_device_count_sent(dev, &message);
+      ++dev->num_written;
+    }
+    dev->sdo_timestamp = epos_clock_get();
+    
+    if (epos_device_receive_message(dev, &message) ||
+        epos_device_check_block(dev, &message,
+          EPOS_SDO_CS_BLOCK_DOWNLOAD_RESPONSE, EPOS_SDO_BLOCK_ACK, index,
+          subindex))
+      return -dev->error.code;
+    
+    if (message.content[1] > sequence) {
+      epos_device_abort(dev, index, subindex, EPOS_SDO_ABORT_SEQUENCE);
+      error_setf(&dev->error, EPOS_DEVICE_ERROR_INVALID_RESPONSE,
+        "[Node 0x%hX]: %s", dev->node_id,
+        epos_error_comm(EPOS_SDO_ABORT_SEQUENCE));
+      return -dev->error.code;
+    }
+    num_written = min(num_written+message.content[1]*
+      EPOS_SDO_MAX_SEGMENT_SIZE, num);
+    block_size = message.content[2];
   }
-
+  
+  memset(&message, 0, sizeof(can_message_t));
+  message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
+  message.content[0] = EPOS_SDO_CS_BLOCK_DOWNLOAD_REQUEST |
+    ((EPOS_SDO_MAX_SEGMENT_SIZE-1-(num-1)%EPOS_SDO_MAX_SEGMENT_SIZE) << 2) |
+    EPOS_SDO_BLOCK_END;
+  if (crc) {
+    checksum = epos_sdo_crc(data, num, 0);
+    message.content[1] = checksum;
+    message.content[2] = checksum >> 8;
+  }
+  message.length = 8;
+  
+  if (epos_device_send_message(dev, &message) ||
+      epos_device_receive_message(dev, &message) ||
+      epos_device_check_block(dev, &message,
+        EPOS_SDO_CS_BLOCK_DOWNLOAD_RESPONSE, EPOS_SDO_BLOCK_END, index,
+        subindex))
+    return -dev->error.code;
+  ++dev->num_written;
+  epos_cache_update(&dev->cache, index, subindex, data, num);
+  dev->statistics.num_bytes_written += num;
+  
   return num_written;
 }
 
+double epos_device_get_retry_delay(epos_device_t* dev, int download, int
+    retry) {
+  if ((retry >= dev->retries) || (download && !dev->retry_downloads))
+    return -1.0;
+  
+  return ldexp(dev->retry_backoff, retry);
+}
+
 int epos_device_send_nmt(epos_device_t *dev, unsigned short cmd) {
   can_message_t message;
+  int reset = (cmd == EPOS_DEVICE_NMT_CS_RESET_NODE) ||
+    (cmd == EPOS_DEVICE_NMT_CS_RESET_COMMUNICATION);
 
   error_clear(&dev->error);
 
@@ -321,9 +798,28 @@ int epos_device_send_nmt(epos_device_t *dev, unsigned short cmd) {
   message.content[1] = dev->node_id;
   message.length = 2;
 
-  if (epos_device_send_message(dev, &message) ||
-      epos_device_receive_message(dev, &message))
+  if (reset)
+    epos_bus_clear(dev->bus, dev->node_id, epos_bus_nmt);
+  if (cmd == EPOS_DEVICE_NMT_CS_RESET_NODE)
+    epos_cache_invalidate_parameters(&dev->cache);
+  if (epos_device_send_message(dev, &message))
     return -dev->error.code;
+  
+  if (reset) {
+    int result;
+    
+    if (dev->node_id != CAN_NODE_ID_BROADCAST)
+      while (!(result = epos_bus_receive(dev->bus, dev->node_id,
+        epos_bus_nmt, &message, dev->timeout)) &&
+        message.content[0]);
+    else
+      result = epos_bus_dispatch(dev->bus);
+    
+    if (result) {
+      error_set(&dev->error, EPOS_DEVICE_ERROR_RECEIVE);
+      return -dev->error.code;
+    }
+  }
 
   ++dev->num_written;
 
@@ -340,6 +836,7 @@ int epos_device_store_parameters(epos_device_t* dev) {
 int epos_device_restore_parameters(epos_device_t* dev) {
   epos_device_write(dev, EPOS_DEVICE_INDEX_RESTORE,
     EPOS_DEVICE_SUBINDEX_RESTORE, (unsigned char*)"daol", 4);
+  epos_cache_invalidate_parameters(&dev->cache);
   
   return dev->error.code;
 }
@@ -414,6 +911,86 @@ int epos_device_set_rs232_baud_rate(epos_device_t* dev, int baud_rate) {
   return dev->error.code;
 }
 
+void epos_device_get_statistics(epos_device_t* dev,
+    epos_device_statistics_t* statistics) {
+  *statistics = dev->statistics;
+}
+
+double epos_device_get_bus_load(epos_device_t* dev) {
+  double time = epos_clock_get()-dev->statistics.start_time;
+  
+  if ((dev->can_bit_rate <= 0) || (time <= 0.0))
+    return 0.0;
+  
+  return (dev->statistics.num_bits_sent+dev->statistics.num_bits_received)/
+    (dev->can_bit_rate*1e3*time);
+}
+
+void epos_device_reset_statistics(epos_device_t* dev) {
+  memset(&dev->statistics, 0, sizeof(epos_device_statistics_t));
+  dev->statistics.start_time = epos_clock_get();
+  
+  epos_histogram_clear(&dev->latency);
+  epos_histogram_set_clear(&dev->latencies);
+}
+
+void epos_device_count_abort(epos_device_statistics_t* statistics, int code) {
+  size_t i;
+  
+  ++statistics->num_aborts;
+  
+  for (i = 0; (i < statistics->num_abort_codes) &&
+    (statistics->aborts[i].code != code); ++i);
+  if (i < statistics->num_abort_codes)
+    ++statistics->aborts[i].count;
+  else if (i < EPOS_DEVICE_MAX_ABORT_CODES) {
+    statistics->aborts[i].code = code;
+    statistics->aborts[i].count = 1;
+    ++statistics->num_abort_codes;
+  }
+}
+
+void epos_device_count_sent(epos_device_t* dev, const can_message_t*
+    message) {
+  ++dev->statistics.num_sent;
+  dev->statistics.num_bits_sent += EPOS_DEVICE_FRAME_OVERHEAD+
+    8*message->length;
+}
+
+void epos_device_count_round_trip(epos_device_t* dev, short index, double
+    latency) {
+  epos_histogram_record(&dev->latency, latency);
+  epos_histogram_set_record(&dev->latencies, (unsigned short)index,
+    latency);
+  
+  if (!dev->statistics.num_round_trips ||
+      (latency < dev->statistics.min_round_trip))
+    dev->statistics.min_round_trip = latency;
+  if (latency > dev->statistics.max_round_trip)
+    dev->statistics.max_round_trip = latency;
+  dev->statistics.sum_round_trip += latency;
+  ++dev->statistics.num_round_trips;
+}
+
+double epos_device_get_heartbeat(epos_device_t* dev) {
+  unsigned short heartbeat = 0;
+  epos_device_read(dev, EPOS_DEVICE_INDEX_HEARTBEAT, 0,
+    (unsigned char*)&heartbeat, sizeof(unsigned short));
+
+  return heartbeat*1e-3;
+}
+
+int epos_device_set_heartbeat(epos_device_t* dev, double period) {
+  unsigned short heartbeat = period*1e3+0.5;
+  
+  error_clear(&dev->error);
+  
+  epos_device_write(dev, EPOS_DEVICE_INDEX_HEARTBEAT, 0,
+    (unsigned char*)&heartbeat, sizeof(unsigned short));
+  
+  return dev->error.code;
+}
+
 short epos_device_get_hardware_version(epos_device_t* dev) {
   short hardware_version = 0;
   epos_device_read(dev, EPOS_DEVICE_INDEX_VERSION,
@@ -442,20 +1019,44 @@ short epos_device_get_status(epos_device_t* dev) {
 
 int epos_device_wait_status(epos_device_t* dev, short status, double
     timeout) {
-  struct timeval tv;
-  gettimeofday(&tv, 0);
-  double time = tv.tv_sec+tv.tv_usec/1e6;
+  const epos_pdo_t* pdo = 0;
+  double start_time = epos_clock_get(), time;
+  short status_word;
 
   error_clear(&dev->error);
   
-  while (!(status & epos_device_get_status(dev)) && !dev->error.code) {
-    if (timeout >= 0.0) {
-      gettimeofday(&tv, 0);
+  if (dev->pdo_image) {
+    pdo = epos_pdo_image_find(dev->pdo_image, epos_pdo_transmit,
+      EPOS_DEVICE_INDEX_STATUS, 0);
+    if (pdo && (!pdo->cob_id ||
+        (pdo->transmission_type != EPOS_PDO_TRANSMISSION_ASYNCHRONOUS)))
+      pdo = 0;
+  }
+  
+  status_word = epos_device_get_status(dev);
+  while (!(status & status_word) && !dev->error.code) {
+    time = epos_clock_get();
+    if ((timeout >= 0.0) && (time-start_time > timeout)) {
+      error_set(&dev->error, EPOS_DEVICE_ERROR_WAIT_TIMEOUT);
+      break;
+    }
+    
+    if (pdo) {
+      size_t num_transferred = pdo->num_transferred;
       
-      if (tv.tv_sec+tv.tv_usec/1e6-time > timeout) {
-        error_set(&dev->error, EPOS_DEVICE_ERROR_WAIT_TIMEOUT);
-        break;
-      }
+      if (epos_bus_dispatch(dev->bus))
+        status_word = epos_device_get_status(dev);
+      else if (pdo->num_transferred != num_transferred)
+        epos_pdo_image_get(dev->pdo_image, EPOS_DEVICE_INDEX_STATUS, 0,
+          (unsigned char*)&status_word, sizeof(short));
+    }
+    else {
+      if (timeout >= 0.0)
+        epos_clock_sleep(min(dev->poll_period, start_time+timeout-time));
+      else
+        epos_clock_sleep(dev->poll_period);
+      
+      status_word = epos_device_get_status(dev);
     }
   }
 
@@ -518,3 +1119,117 @@ int epos_device_reset_communication(epos_device_t *dev) {
   epos_device_send_nmt(dev, EPOS_DEVICE_NMT_CS_RESET_COMMUNICATION);
   return dev->error.code;
 }
+
+int epos_device_start_node(epos_device_t* dev) {
+  epos_device_send_nmt(dev, EPOS_DEVICE_NMT_CS_START_REMOTE_NODE);
+  return dev->error.code;
+}
+
+int epos_device_enter_preoperational(epos_device_t* dev) {
+  epos_device_send_nmt(dev, EPOS_DEVICE_NMT_CS_ENTER_PRE_OPERATIONAL);
+  return dev->error.code;
+}
+
+int epos_device_check_response(epos_device_t* dev, const can_message_t*
+    message, unsigned char cs, short index, unsigned char subindex) {
+  if (((message->content[0] & EPOS_SDO_CS_MASK) != cs) ||
+      (message->content[1]+(message->content[2] << 8) != (index & 0xFFFF)) ||
+      (message->content[3] != subindex)) {
+    epos_device_abort(dev, index, subindex, EPOS_SDO_ABORT_COMMAND);
+    error_setf(&dev->error, EPOS_DEVICE_ERROR_INVALID_RESPONSE,
+      "[Node 0x%hX]: 0x%02X", dev->node_id, message->content[0]);
+  }
+  
+  return dev->error.code;
+}
+
+int epos_device_check_segment(epos_device_t* dev, const can_message_t*
+    message, unsigned char cs, unsigned char toggle, short index, unsigned
+    char subindex) {
+  if ((message->content[0] & EPOS_SDO_CS_MASK) != cs) {
+    epos_device_abort(dev, index, subindex, EPOS_SDO_ABORT_COMMAND);
+    error_setf(&dev->error, EPOS_DEVICE_ERROR_INVALID_RESPONSE,
+      "[Node 0x%hX]: 0x%02X", dev->node_id, message->content[0]);
+  }
+  else if ((message->content[0] & EPOS_SDO_FLAG_TOGGLE) != toggle) {
+    epos_device_abort(dev, index, subindex, EPOS_SDO_ABORT_TOGGLE);
+    error_setf(&dev->error, EPOS_DEVICE_ERROR_INVALID_RESPONSE,
+      "[Node 0x%hX]: %s", dev->node_id,
+      epos_error_comm(EPOS_SDO_ABORT_TOGGLE));
+  }
+  
+  return dev->error.code;
+}
+
+int epos_device_check_block(epos_device_t* dev, const can_message_t*
+    message, unsigned char cs, unsigned char subcommand, short index,
+    unsigned char subindex) {
+  unsigned char mask = EPOS_SDO_BLOCK_SUBCOMMAND_MASK;
+  
+  if (cs == EPOS_SDO_CS_BLOCK_UPLOAD_RESPONSE)
+    mask = EPOS_SDO_BLOCK_END;
+  if (((message->content[0] & EPOS_SDO_CS_MASK) != cs) ||
+      ((message->content[0] & mask) != subcommand)) {
+    epos_device_abort(dev, index, subindex, EPOS_SDO_ABORT_COMMAND);
+    error_setf(&dev->error, EPOS_DEVICE_ERROR_INVALID_RESPONSE,
+      "[Node 0x%hX]: 0x%02X", dev->node_id, message->content[0]);
+  }
+  
+  return dev->error.code;
+}
+
+int epos_device_block_rejected(epos_device_t* dev, const can_message_t*
+    message) {
+  int code;
+  
+  if (dev->error.code != EPOS_DEVICE_ERROR_ABORT)
+    return 0;
+  memcpy(&code, &message->content[4], sizeof(code));
+  
+  return (code == EPOS_SDO_ABORT_COMMAND);
+}
+
+int epos_device_block_overflow(epos_device_t* dev, short index, unsigned
+    char subindex, size_t num) {
+  epos_device_abort(dev, index, subindex, EPOS_SDO_ABORT_LENGTH_HIGH);
+  error_setf(&dev->error, EPOS_DEVICE_ERROR_INVALID_SIZE, "%lu",
+    (unsigned long)num);
+  
+  return dev->error.code;
+}
+
+void epos_device_abort(epos_device_t* dev, short index, unsigned char
+    subindex, int code) {
+  can_message_t message;
+  
+  message.id = CAN_COB_ID_SDO_SEND+dev->node_id;
+  message.content[0] = EPOS_SDO_CS_ABORT;
+  message.content[1] = index;
+  message.content[2] = index >> 8;
+  message.content[3] = subindex;
+  memcpy(&message.content[4], &code, sizeof(code));
+  message.length = 8;
+  
+  if (dev->bus && !epos_bus_send(dev->bus, &message))
+    epos_device_count_sent(dev, &message);
+}
+
+int epos_device_retry(epos_device_t* dev, short index, unsigned char
+    subindex, int download, int* retry) {
+  double delay;
+  
+  if ((dev->error.code != EPOS_DEVICE_ERROR_WAIT_TIMEOUT) &&
+      (dev->error.code != EPOS_DEVICE_ERROR_RECEIVE))
+    return 0;
+  if ((delay = epos_device_get_retry_delay(dev, download, *retry)) < 0.0)
+    return 0;
+  
+  epos_device_abort(dev, index, subindex, EPOS_SDO_ABORT_TIMEOUT);
+  epos_clock_sleep(delay);
+  epos_bus_clear(dev->bus, dev->node_id, epos_bus_sdo);
+  
+  ++(*retry);
+  ++dev->statistics.num_retries;
+  
+  return 1;
+}
@@ -25,6 +25,10 @@
 
 #include <error/error.h>
 
+#include "cache.h"
+#include "emergency.h"
+#include "histogram.h"
+
 /** \file device.h
   * \brief EPOS device interface
   * 
@@ -37,8 +41,15 @@
   */
 //@{
 #define EPOS_DEVICE_WAIT_FOREVER                -1.0
+#define EPOS_DEVICE_RECEIVE_TIMEOUT             1.0
+#define EPOS_DEVICE_RETRIES                     1
+#define EPOS_DEVICE_RETRY_BACKOFF               0.01
+#define EPOS_DEVICE_POLL_PERIOD                 0.01
 #define EPOS_DEVICE_CAN_BIT_RATE_RESERVED       1
 #define EPOS_DEVICE_CAN_BIT_RATE_AUTO           0
+#define EPOS_DEVICE_BLOCK_SIZE                  16
+#define EPOS_DEVICE_MAX_ABORT_CODES             8
+#define EPOS_DEVICE_FRAME_OVERHEAD              47
 //@}
 
 /** \name Object Indexes
@@ -50,6 +61,7 @@
 #define EPOS_DEVICE_SUBINDEX_STORE              0x01
 #define EPOS_DEVICE_INDEX_RESTORE               0x1011
 #define EPOS_DEVICE_SUBINDEX_RESTORE            0x01
+#define EPOS_DEVICE_INDEX_HEARTBEAT             0x1017
 #define EPOS_DEVICE_INDEX_ID                    0x2000
 #define EPOS_DEVICE_INDEX_CAN_BIT_RATE          0x2001
 #define EPOS_DEVICE_INDEX_RS232_BAUD_RATE       0x2002
@@ -114,6 +126,8 @@
 //!< Invalid EPOS RS232 baud rate
 #define EPOS_DEVICE_ERROR_WAIT_TIMEOUT          10
 //!< EPOS device timeout
+#define EPOS_DEVICE_ERROR_INVALID_RESPONSE      11
+//!< Invalid EPOS SDO response
 //@}
 
 /** \brief Predefined EPOS device error descriptions
@@ -146,6 +160,47 @@ typedef enum {
   epos_device_unknown                 //!< Unknown device.
 } epos_device_type_t;
 
+/** \brief Structure defining an EPOS device abort count
+  */
+typedef struct epos_device_abort_count_t {
+  int code;                   //!< The SDO abort code.
+  size_t count;               //!< The number of aborts with this code.
+} epos_device_abort_count_t;
+
+/** \brief Structure defining EPOS device statistics
+  * 
+  * Frames received from the node are counted by the bus dispatcher, and
+  * the number of bits on the bus is estimated from the frame lengths,
+  * neglecting bit stuffing.
+  */
+typedef struct epos_device_statistics_t {
+  double start_time;          //!< The time of the latest reset in [s].
+
+  size_t num_sent;            //!< The number of frames sent to the node.
+  size_t num_received;        //!< The number of frames received from the node.
+  size_t num_bits_sent;       //!< The number of bits sent to the node.
+  size_t num_bits_received;   //!< The number of bits received from the node.
+
+  size_t num_bytes_read;      //!< The number of object bytes read by SDO.
+  size_t num_bytes_written;   //!< The number of object bytes written by SDO.
+  size_t num_timeouts;        //!< The number of SDO response timeouts.
+  size_t num_retries;         //!< The number of retried SDO transfers.
+  size_t num_emergencies;     //!< The number of emergencies received.
+
+  size_t num_aborts;          //!< The number of SDO aborts received.
+  epos_device_abort_count_t
+    aborts[EPOS_DEVICE_MAX_ABORT_CODES]; //!< The SDO aborts by code.
+  size_t num_abort_codes;     //!< The number of distinct abort codes.
+
+  size_t num_round_trips;     //!< The number of SDO round trips.
+  double min_round_trip;      //!< The minimum SDO round trip time in [s].
+  double max_round_trip;      //!< The maximum SDO round trip time in [s].
+  double sum_round_trip;      //!< The sum of SDO round trip times in [s].
+} epos_device_statistics_t;
+
+struct epos_pdo_image_t;
+struct epos_bus_t;
+
 /** \brief Structure defining an EPOS device
   */
 typedef struct epos_device_t {
@@ -166,6 +221,28 @@ typedef struct epos_device_t {
   size_t num_read;            //!< The number of messages read from the EPOS.
   size_t num_written;         //!< The number of messages written to the EPOS.
   
+  struct epos_pdo_image_t*
+    pdo_image;                //!< The process image of the EPOS device.
+  struct epos_bus_t* bus;     //!< The bus the EPOS device is attached to.
+  int bus_open;               //!< The EPOS device holds an open bus.
+  double poll_period;         //!< The status polling period in [s].
+  int block_transfer;         //!< The EPOS device supports block transfer.
+  double timeout;             //!< The SDO response timeout in [s].
+  int retries;                //!< The maximum number of SDO retries.
+  double retry_backoff;       //!< The delay before the first retry in [s].
+  int retry_downloads;        //!< Also retry downloads which timed out.
+  epos_cache_t cache;         //!< The object dictionary cache of the device.
+  epos_emergency_queue_t
+    emergency;                //!< The emergency queue of the device.
+  
+  double sdo_timestamp;       //!< The time of the latest SDO request in [s].
+  short sdo_index;            //!< The object index of the SDO transfer.
+  epos_histogram_t latency;   //!< The SDO round trip latencies.
+  epos_histogram_set_t
+    latencies;                //!< The SDO round trip latencies by index.
+  epos_device_statistics_t
+    statistics;               //!< The communication statistics.
+  
   error_t error;              //!< The most recent EPOS device error.
 } epos_device_t;
 
@@ -175,6 +252,10 @@ typedef struct epos_device_t {
   * \param[in] node_id The node identifier of the EPOS device to be
   *   initialized.
   * \param[in] reset Reset the EPOS device after opening.
+  * 
+  * The device will be attached to the bus of its CAN device. Its object
+  * dictionary cache is initially disabled, and its emergency queue has
+  * no callback.
   */
 void epos_device_init(
   epos_device_t* dev,
@@ -193,6 +274,10 @@ void epos_device_destroy(
   * \return The resulting error code.
   * 
   * This method also reads basic setup parameters from the EPOS node.
+  * Opening fails if another device on the same bus has been registered
+  * for the node identifier of the device. The device holds an open
+  * reference of its bus until it is closed, and opening it again does not
+  * acquire another reference.
   */
 int epos_device_open(
   epos_device_t* dev);
@@ -217,6 +302,17 @@ int epos_device_send_message(
   * \param[in] dev The EPOS device the CAN message shall be received from.
   * \param[out] message The received CAN message.
   * \return The resulting error code.
+  * 
+  * This function returns the next SDO response sent by the node of the
+  * device. Messages received from other nodes in the meantime are routed
+  * to their respective devices by the bus dispatcher, process data
+  * objects are decoded into the process images of the devices, and
+  * emergencies into their emergency queues. Emergencies do not affect
+  * the result of this function.
+  * 
+  * The time elapsed since the latest message was sent to the node is
+  * recorded as SDO round trip latency of the device, both in total and
+  * for the object index of the current transfer.
   */
 int epos_device_receive_message(
   epos_device_t* dev,
@@ -229,6 +325,18 @@ int epos_device_receive_message(
   * \param[out] data The array the read EPOS data object shall be stored to.
   * \param[in] num The size of the EPOS data object to be read.
   * \return The number of data object bytes read or the negative error code.
+  * 
+  * Data objects of up to four bytes are uploaded in a single expedited
+  * transfer, larger data objects in segments. A data object larger than
+  * the specified size is rejected with an error.
+  * 
+  * If the object dictionary cache of the device is enabled and knows the
+  * value of the data object, the read is served from the cache.
+  * 
+  * If the node does not respond within the timeout of the device, the
+  * transfer is aborted and repeated as decided by
+  * epos_device_get_retry_delay(). Transfers aborted by the node are not
+  * repeated.
   */
 int epos_device_read(
   epos_device_t* dev,
@@ -244,6 +352,18 @@ int epos_device_read(
   * \param[in] data The array representing the EPOS data object to be written.
   * \param[in] num The size of the EPOS data object to be written.
   * \return The number of data object bytes written or the negative error code.
+  * 
+  * Data objects of up to four bytes are downloaded in a single expedited
+  * transfer, larger data objects in segments.
+  * 
+  * If the object dictionary cache of the device is enabled and knows the
+  * data object to already hold the specified value, the write is elided.
+  * 
+  * Since a download which timed out may nevertheless have been executed
+  * by the node, it is only repeated if dev->retry_downloads is set, i.e.,
+  * if all objects written to the device are known to be idempotent.
+  * Otherwise, transfers which time out are repeated as described for
+  * epos_device_read().
   */
 int epos_device_write(
   epos_device_t* dev,
@@ -252,6 +372,73 @@ int epos_device_write(
   unsigned char* data,
   size_t num);
 
+/** \brief Read an EPOS device data object using SDO block transfer
+  * \param[in] dev The EPOS device the data object will be read from.
+  * \param[in] index The index of the EPOS data object.
+  * \param[in] subindex The subindex of the EPOS data object.
+  * \param[out] data The array the read EPOS data object shall be stored to.
+  * \param[in] num The size of the EPOS data object to be read.
+  * \return The number of data object bytes read or the negative error code.
+  * 
+  * Block transfer transmits up to EPOS_DEVICE_BLOCK_SIZE segments per
+  * confirmation and is thus suited for large data objects. If the device
+  * rejects the block upload command, it is marked as not supporting block
+  * transfer and this function falls back to epos_device_read(). The same
+  * applies to data objects of up to four bytes.
+  * 
+  * Transfers which time out are repeated as described for
+  * epos_device_read().
+  */
+int epos_device_read_block(
+  epos_device_t* dev,
+  short index,
+  unsigned char subindex,
+  unsigned char* data,
+  size_t num);
+
+/** \brief Write an EPOS device data object using SDO block transfer
+  * \param[in] dev The EPOS device the data object will be written to.
+  * \param[in] index The index of the EPOS data object.
+  * \param[in] subindex The subindex of the EPOS data object.
+  * \param[in] data The array representing the EPOS data object to be written.
+  * \param[in] num The size of the EPOS data object to be written.
+  * \return The number of data object bytes written or the negative error code.
+  * 
+  * The block size is negotiated by the device. If the device rejects the
+  * block download command, it is marked as not supporting block transfer
+  * and this function falls back to epos_device_write(). The same applies
+  * to data objects of up to four bytes.
+  * 
+  * Transfers which time out are repeated as described for
+  * epos_device_write().
+  */
+int epos_device_write_block(
+  epos_device_t* dev,
+  short index,
+  unsigned char subindex,
+  unsigned char* data,
+  size_t num);
+
+/** \brief Retrieve the delay before retrying an EPOS device SDO transfer
+  * \param[in] dev The EPOS device whose SDO transfer timed out.
+  * \param[in] download Non-zero if the timed out transfer is a download.
+  * \param[in] retry The number of retries already attempted.
+  * \return The delay before the next retry in [s], or a negative value
+  *   if the transfer must not be retried.
+  * 
+  * This function defines the retry policy shared by the blocking SDO
+  * transfers of the device and the asynchronous SDO client. Uploads are
+  * retried up to dev->retries times, downloads only if
+  * dev->retry_downloads is set. The first retry is delayed by
+  * dev->retry_backoff, and the delay doubles with each further retry.
+  * In the worst case, a transfer thus blocks for dev->retries+1 times
+  * the timeout of the device in addition to the accumulated delays.
+  */
+double epos_device_get_retry_delay(
+  epos_device_t* dev,
+  int download,
+  int retry);
+
 /** \brief Send NMT frame
   * \param[in] dev The EPOS device the NMT frame will be sent to.
   * \param[in] cmd The NMT command specifier.
@@ -329,6 +516,91 @@ int epos_device_set_rs232_baud_rate(
   epos_device_t* dev,
   int baud_rate);
 
+/** \brief Retrieve communication statistics of an EPOS device
+  * \param[in] dev The EPOS device to retrieve the statistics for.
+  * \param[out] statistics The snapshot of the device statistics.
+  * 
+  * Since received frames are counted by the dispatching thread, the
+  * snapshot may be slightly inconsistent if the bus is dispatched
+  * concurrently.
+  */
+void epos_device_get_statistics(
+  epos_device_t* dev,
+  epos_device_statistics_t* statistics);
+
+/** \brief Estimate the bus load caused by an EPOS device
+  * \param[in] dev The EPOS device to estimate the bus load for.
+  * \return The estimated fraction of the CAN bus capacity used by the
+  *   frames exchanged with the node since the latest statistics reset,
+  *   or zero if the CAN bit rate of the device is unknown.
+  */
+double epos_device_get_bus_load(
+  epos_device_t* dev);
+
+/** \brief Reset communication statistics of an EPOS device
+  * \param[in] dev The EPOS device to reset the statistics for.
+  * 
+  * The SDO latency histograms of the device are cleared along with the
+  * statistics.
+  */
+void epos_device_reset_statistics(
+  epos_device_t* dev);
+
+/** \brief Count an SDO abort in EPOS device statistics
+  * \param[in] statistics The EPOS device statistics to count the abort in.
+  * \param[in] code The SDO abort code received from the node. Aborts
+  *   beyond EPOS_DEVICE_MAX_ABORT_CODES distinct codes are only counted
+  *   in total.
+  */
+void epos_device_count_abort(
+  epos_device_statistics_t* statistics,
+  int code);
+
+/** \brief Count a sent frame in EPOS device statistics
+  * \param[in] dev The EPOS device to count the frame for.
+  * \param[in] message The CAN message which has been sent to the node.
+  * 
+  * Every path sending a frame on behalf of the device counts it here,
+  * such that the bus load also covers block transfers and aborts.
+  */
+void epos_device_count_sent(
+  epos_device_t* dev,
+  const can_message_t* message);
+
+/** \brief Count an SDO round trip in EPOS device statistics
+  * \param[in] dev The EPOS device to count the round trip for.
+  * \param[in] index The object index of the SDO transfer.
+  * \param[in] latency The time from the request expecting a response to
+  *   the response in [s].
+  * 
+  * The latency is recorded in the latency histograms of the device, both
+  * in total and by object index.
+  */
+void epos_device_count_round_trip(
+  epos_device_t* dev,
+  short index,
+  double latency);
+
+/** \brief Retrieve heartbeat period of an EPOS device
+  * \param[in] dev The EPOS device to retrieve the heartbeat period for.
+  * \return The period of the heartbeat produced by the specified EPOS
+  *   device in [s], or zero if heartbeat production is disabled. On error,
+  *   the return value will be zero and the error code set in dev->error.
+  */
+double epos_device_get_heartbeat(
+  epos_device_t* dev);
+
+/** \brief Set heartbeat period of an EPOS device
+  * \param[in] dev The EPOS device to set the heartbeat period for.
+  * \param[in] period The period of the heartbeat to be produced by the
+  *   specified EPOS device in [s], with a resolution of 1 ms. Zero
+  *   disables heartbeat production.
+  * \return The resulting error code.
+  */
+int epos_device_set_heartbeat(
+  epos_device_t* dev,
+  double period);
+
 /** \brief Retrieve hardware version of an EPOS device
   * \param[in] dev The EPOS device to retrieve the hardware version for.
   * \return The hardware version of the specified EPOS device. On error,
@@ -359,6 +631,15 @@ short epos_device_get_status(
   * \param[in] timeout The timeout of the wait operation in [s].
   *   A negative value will be interpreted as an eternal wait.
   * \return The resulting error code.
+  * 
+  * If the status word is mapped into a configured asynchronous TPDO of
+  * the device's process image, this function blocks on status word
+  * changes delivered by the TPDO. Should the bus remain silent for the
+  * receive timeout of the CAN device, the status word is read from the
+  * object dictionary instead. Otherwise, the status word is polled at the
+  * polling period of the device. In both cases, the status word is read
+  * once before waiting, and the timeout is checked after each received
+  * message or poll.
   */
 int epos_device_wait_status(
   epos_device_t* dev,
@@ -439,4 +720,20 @@ int epos_device_reset(
 int epos_device_reset_communication(
   epos_device_t* dev);
 
+/** \brief Put EPOS device into operational NMT state
+  * \param[in] dev The EPOS device to be started.
+  * \return The resulting error code.
+  * 
+  * Process data objects are exchanged in operational NMT state only.
+  */
+int epos_device_start_node(
+  epos_device_t* dev);
+
+/** \brief Put EPOS device into pre-operational NMT state
+  * \param[in] dev The EPOS device to be put into pre-operational state.
+  * \return The resulting error code.
+  */
+int epos_device_enter_preoperational(
+  epos_device_t* dev);
+
 #endif
@@ -0,0 +1,89 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "emergency.h"
+#include "error.h"
+#include "clock.h"
+
+void epos_emergency_decode(epos_emergency_t* emergency, const
+    can_message_t* message, double timestamp) {
+  emergency->node_id = message->id-CAN_COB_ID_SDO_EMERGENCY;
+  emergency->code = message->content[0] | (message->content[1] << 8);
+  emergency->error_register = message->content[2];
+  memcpy(emergency->data, &message->content[3], sizeof(emergency->data));
+  emergency->timestamp = timestamp;
+}
+
+const char* epos_emergency_get_description(const epos_emergency_t*
+    emergency) {
+  return epos_error_device(emergency->code);
+}
+
+void epos_emergency_queue_init(epos_emergency_queue_t* queue) {
+  queue->first = 0;
+  queue->last = 0;
+  queue->num_dropped = 0;
+  
+  queue->callback = 0;
+  queue->user_data = 0;
+}
+
+void epos_emergency_queue_set_callback(epos_emergency_queue_t* queue,
+    epos_emergency_callback_t callback, void* user_data) {
+  queue->callback = callback;
+  queue->user_data = user_data;
+}
+
+void epos_emergency_queue_receive_message(epos_emergency_queue_t* queue,
+    const can_message_t* message, epos_emergency_t* emergency) {
+  size_t last = queue->last;
+  size_t next = (last+1) % EPOS_EMERGENCY_QUEUE_SIZE;
+  
+  epos_emergency_decode(emergency, message, epos_clock_get());
+  
+  if (next != __atomic_load_n(&queue->first, __ATOMIC_ACQUIRE)) {
+    queue->emergencies[last] = *emergency;
+    __atomic_store_n(&queue->last, next, __ATOMIC_RELEASE);
+  }
+  else
+    ++queue->num_dropped;
+}
+
+void epos_emergency_queue_notify(epos_emergency_queue_t* queue, const
+    epos_emergency_t* emergency) {
+  if (queue->callback)
+    queue->callback(emergency, queue->user_data);
+}
+
+int epos_emergency_queue_poll(epos_emergency_queue_t* queue,
+    epos_emergency_t* emergency) {
+  size_t first = queue->first;
+  
+  if (first == __atomic_load_n(&queue->last, __ATOMIC_ACQUIRE))
+    return 0;
+  
+  *emergency = queue->emergencies[first];
+  __atomic_store_n(&queue->first, (first+1) % EPOS_EMERGENCY_QUEUE_SIZE,
+    __ATOMIC_RELEASE);
+  
+  return 1;
+}
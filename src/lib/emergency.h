@@ -0,0 +1,163 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef EPOS_EMERGENCY_H
+#define EPOS_EMERGENCY_H
+
+#include <stdlib.h>
+
+#include <can.h>
+
+/** \file emergency.h
+  * \brief EPOS emergency handling
+  * 
+  * EPOS nodes report device errors through emergency (EMCY) messages
+  * which are sent asynchronously as soon as an error occurs. The bus
+  * dispatcher decodes each emergency message received for a device into
+  * the emergency queue of the device, independent of any SDO transfer.
+  * 
+  * The emergency queue is a lock-free ring buffer with a single producer,
+  * the thread currently dispatching the bus, and a single consumer which
+  * polls the queue. If the queue is full, the most recent emergency will
+  * be dropped. In addition, an emergency callback may be installed which
+  * is invoked by the dispatching thread right after the bus has been
+  * unlocked. The callback should nevertheless return quickly, since the
+  * bus is not dispatched while it runs.
+  * 
+  * Emergencies are only received while some thread dispatches the bus.
+  * Blocking SDO transfers dispatch the bus for their duration only. A
+  * heartbeat consumer started on the CAN device (see heartbeat.h) provides
+  * a permanent dispatching thread. Applications which supervise no
+  * heartbeats must otherwise call epos_bus_dispatch() from a thread of
+  * their own in order to receive emergencies while the bus is idle.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS emergency constants
+  */
+//@{
+#define EPOS_EMERGENCY_QUEUE_SIZE                 32
+//@}
+
+/** \brief Structure defining a decoded EPOS emergency
+  */
+typedef struct epos_emergency_t {
+  int node_id;                     //!< The identifier of the reporting node.
+  unsigned short code;             //!< The emergency error code.
+  unsigned char error_register;    //!< The error register of the node.
+  unsigned char data[5];           //!< The manufacturer-specific error data.
+  double timestamp;                //!< The time of reception in [s].
+} epos_emergency_t;
+
+/** \brief EPOS emergency callback
+  * \param[in] emergency The received EPOS emergency.
+  * \param[in] user_data The user data passed with the callback.
+  */
+typedef void (*epos_emergency_callback_t)(
+  const epos_emergency_t* emergency,
+  void* user_data);
+
+/** \brief Structure defining an EPOS emergency queue
+  */
+typedef struct epos_emergency_queue_t {
+  epos_emergency_t
+    emergencies[EPOS_EMERGENCY_QUEUE_SIZE]; //!< The queued emergencies.
+  size_t first;                    //!< The index of the first emergency.
+  size_t last;                     //!< The index past the last emergency.
+  size_t num_dropped;              //!< The number of dropped emergencies.
+
+  epos_emergency_callback_t
+    callback;                      //!< The emergency callback, or null.
+  void* user_data;                 //!< The user data of the callback.
+} epos_emergency_queue_t;
+
+/** \brief Decode EPOS emergency message
+  * \param[out] emergency The decoded EPOS emergency.
+  * \param[in] message The emergency message to be decoded.
+  * \param[in] timestamp The time of reception of the message in [s].
+  */
+void epos_emergency_decode(
+  epos_emergency_t* emergency,
+  const can_message_t* message,
+  double timestamp);
+
+/** \brief Retrieve the description of an EPOS emergency
+  * \param[in] emergency The EPOS emergency to retrieve the description
+  *   for.
+  * \return The description of the emergency error code.
+  */
+const char* epos_emergency_get_description(
+  const epos_emergency_t* emergency);
+
+/** \brief Initialize EPOS emergency queue
+  * \param[in] queue The EPOS emergency queue to be initialized.
+  */
+void epos_emergency_queue_init(
+  epos_emergency_queue_t* queue);
+
+/** \brief Set the callback of an EPOS emergency queue
+  * \param[in] queue The EPOS emergency queue to set the callback for.
+  * \param[in] callback The emergency callback, or null.
+  * \param[in] user_data The user data passed to the callback.
+  * 
+  * The callback should be set before the bus of the device is dispatched.
+  */
+void epos_emergency_queue_set_callback(
+  epos_emergency_queue_t* queue,
+  epos_emergency_callback_t callback,
+  void* user_data);
+
+/** \brief Receive an emergency message into an EPOS emergency queue
+  * \param[in] queue The EPOS emergency queue to receive the message into.
+  * \param[in] message The received emergency message.
+  * \param[out] emergency The decoded EPOS emergency.
+  * 
+  * This function is called by the bus dispatcher while the bus is locked.
+  * It decodes the message and pushes the emergency.
+  */
+void epos_emergency_queue_receive_message(
+  epos_emergency_queue_t* queue,
+  const can_message_t* message,
+  epos_emergency_t* emergency);
+
+/** \brief Notify the callback of an EPOS emergency queue
+  * \param[in] queue The EPOS emergency queue to notify the callback for.
+  * \param[in] emergency The received EPOS emergency.
+  * 
+  * This function is called by the bus dispatcher after the bus has been
+  * unlocked. It invokes the callback of the queue if set.
+  */
+void epos_emergency_queue_notify(
+  epos_emergency_queue_t* queue,
+  const epos_emergency_t* emergency);
+
+/** \brief Poll an EPOS emergency queue
+  * \param[in] queue The EPOS emergency queue to be polled.
+  * \param[out] emergency The polled EPOS emergency.
+  * \return One if an emergency has been taken from the queue, zero
+  *   otherwise.
+  * 
+  * Only a single thread may poll the queue at a time.
+  */
+int epos_emergency_queue_poll(
+  epos_emergency_queue_t* queue,
+  epos_emergency_t* emergency);
+
+#endif
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "epos.h"
 
@@ -29,6 +30,10 @@
 #include "position.h"
 #include "velocity.h"
 #include "current.h"
+#include "interpolated_position.h"
+#include "sim.h"
+#include "recorder.h"
+#include "replay.h"
 
 const char* epos_errors[] = {
   "Success",
@@ -51,6 +56,68 @@ config_param_t epos_default_params[] = {
     "false",
     "false|true",
     "Reset EPOS device on initialization"},
+  {EPOS_PARAMETER_DEVICE_POLL_PERIOD,
+    config_param_type_float,
+    "0.01",
+    "[0.0, inf)",
+    "Period of polling the EPOS device status in [s], applicable if the "
+    "status word is not mapped into a TPDO"},
+  {EPOS_PARAMETER_DEVICE_TIMEOUT,
+    config_param_type_float,
+    "1.0",
+    "(0.0, inf)",
+    "Timeout of SDO transfers with the EPOS device in [s]"},
+  {EPOS_PARAMETER_DEVICE_RETRIES,
+    config_param_type_int,
+    "1",
+    "[0, inf)",
+    "Number of retries of SDO transfers with the EPOS device which "
+    "timed out, with the delay between retries doubling each time"},
+  {EPOS_PARAMETER_DEVICE_RETRY_BACKOFF,
+    config_param_type_float,
+    "0.01",
+    "[0.0, inf)",
+    "Delay before the first retry of a timed out SDO transfer with the "
+    "EPOS device in [s]"},
+  {EPOS_PARAMETER_DEVICE_RETRY_WRITES,
+    config_param_type_bool,
+    "false",
+    "false|true",
+    "Also retry SDO writes to the EPOS device which timed out, applicable "
+    "only if all written objects are idempotent"},
+  {EPOS_PARAMETER_DEVICE_SIMULATE,
+    config_param_type_bool,
+    "false",
+    "false|true",
+    "Simulate the EPOS device in software instead of communicating "
+    "through the CAN device, which then applies to all nodes sharing "
+    "this CAN device"},
+  {EPOS_PARAMETER_DEVICE_RECORD,
+    config_param_type_string,
+    "",
+    "",
+    "Record all traffic of the CAN device to the specified file, which "
+    "then applies to all nodes sharing this CAN device"},
+  {EPOS_PARAMETER_DEVICE_REPLAY,
+    config_param_type_string,
+    "",
+    "",
+    "Replay the traffic recorded in the specified file instead of "
+    "communicating through the CAN device, which then applies to all "
+    "nodes sharing this CAN device"},
+  {EPOS_PARAMETER_DEVICE_CACHE,
+    config_param_type_bool,
+    "false",
+    "false|true",
+    "Cache static objects and configuration parameters of the EPOS "
+    "device on the host, eliding writes which would not change their "
+    "values, requires that no other host modifies the configuration"},
+  {EPOS_PARAMETER_DEVICE_HEARTBEAT,
+    config_param_type_float,
+    "0.0",
+    "[0.0, 65.535]",
+    "Period of the heartbeat produced by the EPOS device in [s], or zero "
+    "to retain the heartbeat configuration of the device"},
   {EPOS_PARAMETER_SENSOR_TYPE,
     config_param_type_enum,
     "3chan",
@@ -96,9 +163,22 @@ config_param_t epos_default_params[] = {
     config_param_type_enum,
     "homing",
     "homing|profile_velocity|profile_position|position|velocity|current|"
-    "diagnostic|master_enc|step_dir",
+    "diagnostic|master_enc|step_dir|interpolated_position",
     "Operation mode of the controller as documented by the EPOS firmware "
     "specification"},
+  {EPOS_PARAMETER_PDO_MODE,
+    config_param_type_enum,
+    "none",
+    "none|async|sync",
+    "Process data exchange mode, where 'none' reads all process data via "
+    "SDO, 'async' maps the process data into TPDOs which are sent "
+    "by the node whenever their content changes, and 'sync' maps the "
+    "process data into TPDOs which are sent in response to each SYNC"},
+  {EPOS_PARAMETER_PDO_INHIBIT_TIME,
+    config_param_type_float,
+    "1.0",
+    "[0.0, 6553.5]",
+    "Minimum time between two subsequent asynchronous TPDOs in [ms]"},
   {EPOS_PARAMETER_HOME_METHOD,
     config_param_type_enum,
     "pos_current_index",
@@ -146,6 +226,9 @@ const config_default_t epos_default_config = {
 };
 
 void epos_node_init_components(epos_node_t* node, can_device_t* can_dev);
+void epos_node_init_pdo(epos_node_t* node);
+int epos_node_reset_group(epos_node_t* nodes, size_t num_nodes);
+void* epos_node_connect_run(void* arg);
 
 void epos_node_init(epos_node_t* node, can_device_t* can_dev) {
   config_init_default(&node->config, &epos_default_config);
@@ -198,6 +281,36 @@ void epos_node_init_components(epos_node_t* node, can_device_t* can_dev) {
   epos_device_init(&node->dev, can_dev,
     config_get_int(&node->config, EPOS_PARAMETER_DEVICE_NODE_ID),
     config_get_bool(&node->config, EPOS_PARAMETER_DEVICE_RESET));
+  node->dev.poll_period = config_get_float(&node->config,
+    EPOS_PARAMETER_DEVICE_POLL_PERIOD);
+  node->dev.timeout = config_get_float(&node->config,
+    EPOS_PARAMETER_DEVICE_TIMEOUT);
+  node->dev.retries = config_get_int(&node->config,
+    EPOS_PARAMETER_DEVICE_RETRIES);
+  node->dev.retry_backoff = config_get_float(&node->config,
+    EPOS_PARAMETER_DEVICE_RETRY_BACKOFF);
+  node->dev.retry_downloads = config_get_bool(&node->config,
+    EPOS_PARAMETER_DEVICE_RETRY_WRITES);
+  node->dev.cache.enabled = config_get_bool(&node->config,
+    EPOS_PARAMETER_DEVICE_CACHE);
+  if (!node->dev.bus)
+    error_blame(&node->error, &node->dev.error, EPOS_ERROR_CONFIG);
+  else {
+    if (config_get_bool(&node->config, EPOS_PARAMETER_DEVICE_SIMULATE) &&
+        !epos_sim_attach(node->dev.bus, node->dev.node_id))
+      error_setf(&node->error, EPOS_ERROR_CONFIG,
+        "Failed to simulate node 0x%X", node->dev.node_id);
+    if (config_get_string(&node->config, EPOS_PARAMETER_DEVICE_REPLAY)[0] &&
+        !epos_replay_attach(node->dev.bus, config_get_string(&node->config,
+        EPOS_PARAMETER_DEVICE_REPLAY)))
+      error_setf(&node->error, EPOS_ERROR_CONFIG, "Failed to replay %s",
+        config_get_string(&node->config, EPOS_PARAMETER_DEVICE_REPLAY));
+    if (config_get_string(&node->config, EPOS_PARAMETER_DEVICE_RECORD)[0] &&
+        !epos_recorder_attach(node->dev.bus, config_get_string(&node->config,
+        EPOS_PARAMETER_DEVICE_RECORD)))
+      error_setf(&node->error, EPOS_ERROR_CONFIG, "Failed to record %s",
+        config_get_string(&node->config, EPOS_PARAMETER_DEVICE_RECORD));
+  }
   epos_sensor_init(&node->sensor, &node->dev,
     config_get_enum(&node->config, EPOS_PARAMETER_SENSOR_TYPE),
     config_get_enum(&node->config, EPOS_PARAMETER_SENSOR_POLARITY),
@@ -211,11 +324,49 @@ void epos_node_init_components(epos_node_t* node, can_device_t* can_dev) {
   epos_input_init(&node->input, &node->dev);
   epos_control_init(&node->control, &node->dev,
     config_get_enum(&node->config, EPOS_PARAMETER_CONTROL_MODE));
+  epos_pdo_image_init(&node->pdo, &node->dev);
+  
+  if (config_get_enum(&node->config, EPOS_PARAMETER_PDO_MODE) !=
+      epos_node_pdo_none)
+    epos_node_init_pdo(node);
+}
+
+void epos_node_init_pdo(epos_node_t* node) {
+  unsigned char transmission_type = EPOS_PDO_TRANSMISSION_ASYNCHRONOUS;
+  if (config_get_enum(&node->config, EPOS_PARAMETER_PDO_MODE) ==
+      epos_node_pdo_sync)
+    transmission_type = EPOS_PDO_TRANSMISSION_SYNCHRONOUS;
+  unsigned short inhibit_time = config_get_float(&node->config,
+    EPOS_PARAMETER_PDO_INHIBIT_TIME)*10.0;
+  
+  epos_pdo_init(&node->pdo.transmit[0], epos_pdo_transmit, 0,
+    transmission_type, inhibit_time);
+  epos_pdo_add_mapping(&node->pdo.transmit[0], EPOS_DEVICE_INDEX_STATUS, 0,
+    sizeof(short));
+  epos_pdo_add_mapping(&node->pdo.transmit[0],
+    EPOS_POSITION_INDEX_ACTUAL_VALUE, 0, sizeof(int));
+  epos_pdo_add_mapping(&node->pdo.transmit[0],
+    EPOS_CURRENT_INDEX_AVERAGE_VALUE, 0, sizeof(short));
+  
+  epos_pdo_init(&node->pdo.transmit[1], epos_pdo_transmit, 1,
+    transmission_type, inhibit_time);
+  epos_pdo_add_mapping(&node->pdo.transmit[1],
+    EPOS_VELOCITY_INDEX_AVERAGE_VALUE, 0, sizeof(int));
+  
+  if (config_get_enum(&node->config, EPOS_PARAMETER_CONTROL_MODE) ==
+      epos_control_interpolated_pos) {
+    epos_pdo_init(&node->pdo.receive[0], epos_pdo_receive, 0,
+      EPOS_PDO_TRANSMISSION_ASYNCHRONOUS, 0);
+    epos_pdo_add_mapping(&node->pdo.receive[0],
+      EPOS_INTERPOLATED_POSITION_INDEX_DATA, 0,
+      EPOS_INTERPOLATED_POSITION_RECORD_SIZE);
+  }
 }
 
 void epos_node_destroy(epos_node_t* node) {
   can_device_t* can_dev = node->dev.can_dev;
 
+  epos_pdo_image_destroy(&node->pdo);
   epos_control_destroy(&node->control);
   epos_gear_destroy(&node->gear);
   epos_motor_destroy(&node->motor);
@@ -231,18 +382,90 @@ void epos_node_destroy(epos_node_t* node) {
 }
 
 int epos_node_connect(epos_node_t* node) {
+  double heartbeat = config_get_float(&node->config,
+    EPOS_PARAMETER_DEVICE_HEARTBEAT);
+  
   error_clear(&node->error);
   
   if (epos_device_open(&node->dev))
     error_blame(&node->error, &node->dev.error, EPOS_ERROR_CONNECT);
+  else if ((heartbeat > 0.0) &&
+      epos_device_set_heartbeat(&node->dev, heartbeat))
+    error_blame(&node->error, &node->dev.error, EPOS_ERROR_CONNECT);
   else if (epos_motor_setup(&node->motor) ||
       epos_sensor_setup(&node->sensor) ||
       epos_input_setup(&node->input))
     error_set(&node->error, EPOS_ERROR_CONNECT);
+  else if (epos_pdo_image_is_mapped(&node->pdo) &&
+      epos_pdo_image_setup(&node->pdo))
+    error_blame(&node->error, &node->dev.error, EPOS_ERROR_CONNECT);
 
   return node->error.code;
 }
 
+int epos_node_connect_group(epos_node_t* nodes, size_t num_nodes) {
+  pthread_t* threads;
+  int* running;
+  int* reset;
+  int result = EPOS_ERROR_NONE;
+  size_t i, j;
+  
+  for (i = 0; i < num_nodes; ++i) {
+    error_clear(&nodes[i].error);
+    
+    if (!nodes[i].dev.bus)
+      error_blame(&nodes[i].error, &nodes[i].dev.error, EPOS_ERROR_CONNECT);
+    else if (nodes[i].dev.node_id == CAN_NODE_ID_BROADCAST)
+      error_setf(&nodes[i].error, EPOS_ERROR_CONFIG,
+        "Node identifier required in group");
+    for (j = 0; (j < i) && !nodes[i].error.code; ++j)
+      if ((nodes[j].dev.bus == nodes[i].dev.bus) &&
+          (nodes[j].dev.node_id == nodes[i].dev.node_id))
+        error_setf(&nodes[i].error, EPOS_ERROR_CONFIG,
+          "[Node 0x%hX]: Duplicate node identifier in group",
+          nodes[i].dev.node_id);
+    
+    if (nodes[i].error.code)
+      return nodes[i].error.code;
+  }
+  
+  threads = malloc(num_nodes*sizeof(pthread_t));
+  running = malloc(num_nodes*sizeof(int));
+  reset = malloc(num_nodes*sizeof(int));
+  
+  if (!threads || !running || !reset) {
+    for (i = 0; i < num_nodes; ++i)
+      if (epos_node_connect(&nodes[i]) && !result)
+        result = nodes[i].error.code;
+  }
+  else if (!(result = epos_node_reset_group(nodes, num_nodes))) {
+    for (i = 0; i < num_nodes; ++i) {
+      reset[i] = nodes[i].dev.reset;
+      nodes[i].dev.reset = 0;
+      
+      running[i] = !pthread_create(&threads[i], 0, epos_node_connect_run,
+        &nodes[i]);
+      if (!running[i])
+        epos_node_connect(&nodes[i]);
+    }
+    
+    for (i = 0; i < num_nodes; ++i) {
+      if (running[i])
+        pthread_join(threads[i], 0);
+      nodes[i].dev.reset = reset[i];
+      
+      if (!result)
+        result = nodes[i].error.code;
+    }
+  }
+  
+  free(reset);
+  free(running);
+  free(threads);
+  
+  return result;
+}
+
 int epos_node_disconnect(epos_node_t* node) {
   error_clear(&node->error);
   
@@ -255,37 +478,58 @@ int epos_node_disconnect(epos_node_t* node) {
 float epos_node_get_position(epos_node_t* node) {
   error_clear(&node->error);
   
-  int pos = epos_position_get_actual(&node->dev);
-  if (node->dev.error.code) {
-    error_blame(&node->error, &node->dev.error, EPOS_ERROR_READ);
-    return NAN;
+  int pos = 0;
+  if (!epos_pdo_image_get(&node->pdo, EPOS_POSITION_INDEX_ACTUAL_VALUE, 0,
+      (unsigned char*)&pos, sizeof(int))) {
+    pos = epos_position_get_actual(&node->dev);
+    if (node->dev.error.code) {
+      error_blame(&node->error, &node->dev.error, EPOS_ERROR_READ);
+      return NAN;
+    }
   }
-  else  
-    return epos_gear_to_angle(&node->gear, pos);
+  
+  return epos_gear_to_angle(&node->gear, pos);
 }
 
 float epos_node_get_velocity(epos_node_t* node) {
   error_clear(&node->error);
   
-  int vel = epos_velocity_get_average(&node->dev);
-  if (node->dev.error.code) {
-    error_blame(&node->error, &node->dev.error, EPOS_ERROR_READ);
-    return NAN;
+  int vel = 0;
+  if (!epos_pdo_image_get(&node->pdo, EPOS_VELOCITY_INDEX_AVERAGE_VALUE, 0,
+      (unsigned char*)&vel, sizeof(int))) {
+    vel = epos_velocity_get_average(&node->dev);
+    if (node->dev.error.code) {
+      error_blame(&node->error, &node->dev.error, EPOS_ERROR_READ);
+      return NAN;
+    }
   }
-  else  
-    return epos_gear_to_angular_velocity(&node->gear, vel);
+  
+  return epos_gear_to_angular_velocity(&node->gear, vel);
 }
 
 float epos_node_get_current(epos_node_t* node) {
   error_clear(&node->error);
   
-  short current = epos_current_get_average(&node->dev);
-  if (node->dev.error.code) {
-    error_blame(&node->error, &node->dev.error, EPOS_ERROR_READ);
-    return NAN;
+  short current = 0;
+  if (!epos_pdo_image_get(&node->pdo, EPOS_CURRENT_INDEX_AVERAGE_VALUE, 0,
+      (unsigned char*)&current, sizeof(short))) {
+    current = epos_current_get_average(&node->dev);
+    if (node->dev.error.code) {
+      error_blame(&node->error, &node->dev.error, EPOS_ERROR_READ);
+      return NAN;
+    }
   }
-  else
-    return current*1e-3;
+  
+  return current*1e-3;
+}
+
+int epos_node_receive_pdo(epos_node_t* node) {
+  error_clear(&node->error);
+  
+  if (epos_pdo_image_receive(&node->pdo))
+    error_blame(&node->error, &node->dev.error, EPOS_ERROR_READ);
+  
+  return node->error.code;
 }
 
 int epos_node_home(epos_node_t* node, double timeout) {
@@ -312,3 +556,70 @@ int epos_node_home(epos_node_t* node, double timeout) {
   
   return node->error.code;
 }
+
+void* epos_node_connect_run(void* arg) {
+  epos_node_connect(arg);
+  return 0;
+}
+
+int epos_node_reset_group(epos_node_t* nodes, size_t num_nodes) {
+  can_message_t message;
+  epos_bus_t* bus;
+  size_t i, j;
+  int result;
+  
+  for (i = 0; i < num_nodes; ++i)
+    if (!nodes[i].dev.bus_open) {
+      if (epos_bus_open(nodes[i].dev.bus)) {
+        error_blame(&nodes[i].error, &nodes[i].dev.bus->error,
+          EPOS_ERROR_CONNECT);
+        return nodes[i].error.code;
+      }
+      nodes[i].dev.bus_open = 1;
+    }
+  
+  for (i = 0; i < num_nodes; ++i) {
+    bus = nodes[i].dev.bus;
+    
+    for (j = 0; (j < i) && (nodes[j].dev.bus != bus); ++j);
+    if (j < i)
+      continue;
+    
+    for (j = i; j < num_nodes; ++j) {
+      if ((nodes[j].dev.bus != bus) || !nodes[j].dev.reset)
+        continue;
+      
+      epos_bus_clear(bus, nodes[j].dev.node_id, epos_bus_nmt);
+      
+      message.id = CAN_COB_NMT_SEND;
+      message.content[0] = EPOS_DEVICE_NMT_CS_RESET_COMMUNICATION;
+      message.content[1] = nodes[j].dev.node_id;
+      message.length = 2;
+      
+      if (epos_bus_send(bus, &message)) {
+        error_blame(&nodes[j].error, &bus->error, EPOS_ERROR_CONNECT);
+        return nodes[j].error.code;
+      }
+      epos_device_count_sent(&nodes[j].dev, &message);
+    }
+    
+    for (j = i; j < num_nodes; ++j) {
+      if ((nodes[j].dev.bus != bus) || !nodes[j].dev.reset)
+        continue;
+      
+      while (!(result = epos_bus_receive(bus, nodes[j].dev.node_id,
+        epos_bus_nmt, &message, nodes[j].dev.timeout)) &&
+        message.content[0]);
+      if (result) {
+        error_setf(&nodes[j].error, EPOS_ERROR_CONNECT, "[Node 0x%hX]: %s",
+          nodes[j].dev.node_id, epos_bus_errors[result]);
+        return nodes[j].error.code;
+      }
+      
+      epos_cache_invalidate_parameters(&nodes[j].dev.cache);
+      epos_device_clear_fault(&nodes[j].dev);
+    }
+  }
+  
+  return EPOS_ERROR_NONE;
+}
@@ -31,6 +31,7 @@
 #include "gear.h"
 #include "input.h"
 #include "control.h"
+#include "pdo.h"
 
 /** \file epos.h
   * \brief EPOS convenience functions
@@ -46,6 +47,16 @@
 //@{
 #define EPOS_PARAMETER_DEVICE_NODE_ID         "dev-node-id"
 #define EPOS_PARAMETER_DEVICE_RESET           "dev-reset"
+#define EPOS_PARAMETER_DEVICE_POLL_PERIOD     "dev-poll-period"
+#define EPOS_PARAMETER_DEVICE_TIMEOUT         "dev-timeout"
+#define EPOS_PARAMETER_DEVICE_RETRIES         "dev-retries"
+#define EPOS_PARAMETER_DEVICE_RETRY_BACKOFF   "dev-retry-backoff"
+#define EPOS_PARAMETER_DEVICE_RETRY_WRITES    "dev-retry-writes"
+#define EPOS_PARAMETER_DEVICE_SIMULATE        "dev-sim"
+#define EPOS_PARAMETER_DEVICE_RECORD          "dev-record"
+#define EPOS_PARAMETER_DEVICE_REPLAY          "dev-replay"
+#define EPOS_PARAMETER_DEVICE_CACHE           "dev-cache"
+#define EPOS_PARAMETER_DEVICE_HEARTBEAT       "dev-heartbeat"
 #define EPOS_PARAMETER_SENSOR_TYPE            "enc-type"
 #define EPOS_PARAMETER_SENSOR_POLARITY        "enc-polarity"
 #define EPOS_PARAMETER_SENSOR_PULSES          "enc-pulses"
@@ -54,6 +65,8 @@
 #define EPOS_PARAMETER_MOTOR_CURRENT          "motor-current"
 #define EPOS_PARAMETER_GEAR_TRANSMISSION      "gear-trans"
 #define EPOS_PARAMETER_CONTROL_MODE           "control-mode"
+#define EPOS_PARAMETER_PDO_MODE               "pdo-mode"
+#define EPOS_PARAMETER_PDO_INHIBIT_TIME       "pdo-inhibit"
 
 #define EPOS_PARAMETER_HOME_METHOD            "home-method"
 #define EPOS_PARAMETER_HOME_TYPE              "home-type"
@@ -88,6 +101,14 @@
   */
 extern const char* epos_errors[];
 
+/** \brief EPOS node process data modes
+  */
+typedef enum {
+  epos_node_pdo_none,             //!< Process data is exchanged via SDO.
+  epos_node_pdo_async,            //!< Asynchronous TPDOs on change.
+  epos_node_pdo_sync              //!< Synchronous TPDOs on every SYNC.
+} epos_node_pdo_mode_t;
+
 /** \brief Predefined EPOS default configuration
   */
 extern const config_default_t epos_default_config;
@@ -101,6 +122,7 @@ typedef struct epos_node_t {
   epos_gear_t gear;               //!< The EPOS gear assembly.
   epos_input_t input;             //!< The EPOS input module.
   epos_control_t control;         //!< The EPOS controller.
+  epos_pdo_image_t pdo;           //!< The EPOS process image.
 
   config_t config;                //!< The EPOS node configuration parameters.
   
@@ -161,10 +183,38 @@ void epos_node_destroy(
 /** \brief Connect EPOS node
   * \param[in] node The initialized EPOS node to be connected.
   * \return The resulting error code.
+  * 
+  * Unless the process data mode of the node is configured to be
+  * epos_node_pdo_none, this function also maps the status word, the actual
+  * position, and the average velocity and current into TPDOs of the
+  * node's process image. In interpolated position mode, the interpolation
+  * data record is further mapped into an RPDO.
   */
 int epos_node_connect(
   epos_node_t* node);
 
+/** \brief Connect a group of EPOS nodes
+  * \param[in] nodes The array of initialized EPOS nodes to be connected.
+  * \param[in] num_nodes The number of EPOS nodes in the array.
+  * \return The resulting error code of the first node which failed to
+  *   connect, or EPOS_ERROR_NONE if all nodes have been connected.
+  * 
+  * The nodes may be attached to the same or to different CAN devices, but
+  * must have distinct and explicitly configured node identifiers on a
+  * shared CAN device. The buses of all nodes are opened once before
+  * connecting, such that no thread reopens a bus another thread may be
+  * receiving from. Each node configured to be reset receives a
+  * node-addressed communication reset, such that nodes outside the group
+  * are left alone, and the boot-up of all reset nodes is awaited before
+  * connecting. Each node is then connected by epos_node_connect() in a
+  * separate thread, such that the SDO traffic of all nodes is interleaved
+  * on the bus and the total time is bounded by the slowest node. The error
+  * of each node is reported in its own error member.
+  */
+int epos_node_connect_group(
+  epos_node_t* nodes,
+  size_t num_nodes);
+
 /** \brief Disconnect EPOS node
   * \param[in] node The opened EPOS node to be disconnected.
   * \return The resulting error code.
@@ -176,6 +226,10 @@ int epos_node_disconnect(
   * \param[in] node The opened EPOS node to retrieve the angular position for.
   * \return The angular position of the specified EPOS node in [rad]. On error,
   *   the return value will be NaN and the error code set in node->error.
+  * 
+  * If the actual position is available from the process image of the node,
+  * it will be served from the most recently received TPDO. Otherwise, it
+  * will be read from the node.
   */
 float epos_node_get_position(
   epos_node_t* node);
@@ -185,6 +239,9 @@ float epos_node_get_position(
   * \return The angular velocity of the specified EPOS node in [rad/s]. On
   *   error, the return value will be NaN and the error code set in
   *   node->error.
+  * 
+  * Like epos_node_get_position(), this function prefers the process image
+  * of the node over reading the average velocity from the node.
   */
 float epos_node_get_velocity(
   epos_node_t* node);
@@ -193,10 +250,23 @@ float epos_node_get_velocity(
   * \param[in] node The opened EPOS node to retrieve the current for.
   * \return The current of the specified EPOS node in [A]. On error,
   *   the return value will be NaN and the error code set in node->error.
+  * 
+  * Like epos_node_get_position(), this function prefers the process image
+  * of the node over reading the average current from the node.
   */
 float epos_node_get_current(
   epos_node_t* node);
 
+/** \brief Receive process data of an EPOS node
+  * \param[in] node The opened EPOS node to receive the process data for.
+  * \return The resulting error code.
+  * 
+  * This function blocks until the next TPDO of the node has been received
+  * and decoded into its process image.
+  */
+int epos_node_receive_pdo(
+  epos_node_t* node);
+
 /** \brief Home an EPOS node from configuration settings
   * \param[in] node The opened EPOS node to be homed.
   * \param[in] timeout The timeout of the wait operation in [s].
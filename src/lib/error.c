@@ -27,6 +27,9 @@ epos_error_comm_t epos_errors_comm[] = {
   {0x05030000, "Toggle bit not alternated"},
   {0x05040000, "SDO protocol timed out"},
   {0x05040001, "Client/server command specifier not valid or unknown"},
+  {0x05040002, "Invalid block size"},
+  {0x05040003, "Invalid sequence number"},
+  {0x05040004, "CRC error"},
   {0x05040005, "Out of memory"},
   {0x06010000, "Unsupported access to an object"},
   {0x06010001, "Read command to a write only object"},
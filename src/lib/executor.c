@@ -0,0 +1,238 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+#include "executor.h"
+#include "clock.h"
+
+const char* epos_executor_errors[] = {
+  "Success",
+  "Failed to start executor thread",
+  "Failed to apply executor scheduling",
+  "Invalid executor nodes",
+};
+
+void* epos_executor_run(void* arg);
+void epos_executor_advance(struct timespec* time, double period);
+
+void epos_executor_init(epos_executor_t* executor, epos_node_t* nodes,
+    size_t num_nodes, double frequency, epos_executor_callback_t callback,
+    void* user_data) {
+  int i;
+  
+  executor->nodes = nodes;
+  executor->num_nodes = num_nodes;
+  
+  epos_sync_init(&executor->sync, num_nodes ? nodes[0].dev.can_dev : 0,
+    frequency);
+  for (i = 0; i < num_nodes; ++i)
+    epos_sync_add_image(&executor->sync, &nodes[i].pdo);
+  epos_sync_snapshot_init(&executor->inputs);
+  
+  executor->callback = callback;
+  executor->user_data = user_data;
+  
+  executor->priority = 0;
+  executor->cpu = -1;
+  
+  pthread_mutex_init(&executor->mutex, 0);
+  executor->running = 0;
+  
+  memset(&executor->statistics, 0, sizeof(epos_executor_statistics_t));
+  epos_histogram_init(&executor->latencies);
+  epos_histogram_init(&executor->durations);
+  
+  error_init(&executor->error, epos_executor_errors);
+}
+
+void epos_executor_destroy(epos_executor_t* executor) {
+  if (executor->running)
+    epos_executor_stop(executor);
+  
+  epos_sync_snapshot_destroy(&executor->inputs);
+  epos_sync_destroy(&executor->sync);
+  
+  pthread_mutex_destroy(&executor->mutex);
+  error_destroy(&executor->error);
+}
+
+void epos_executor_set_scheduling(epos_executor_t* executor, int priority,
+    int cpu) {
+  executor->priority = priority;
+  executor->cpu = cpu;
+}
+
+int epos_executor_start(epos_executor_t* executor) {
+  pthread_attr_t attr;
+  struct sched_param param;
+  cpu_set_t cpus;
+  int i;
+  
+  error_clear(&executor->error);
+  
+  if (!executor->num_nodes) {
+    error_setf(&executor->error, EPOS_EXECUTOR_ERROR_NODES, "No nodes");
+    return executor->error.code;
+  }
+  for (i = 1; i < executor->num_nodes; ++i)
+    if (executor->nodes[i].dev.can_dev != executor->sync.can_dev) {
+      error_setf(&executor->error, EPOS_EXECUTOR_ERROR_NODES,
+        "[Node 0x%hX]: Different CAN device", executor->nodes[i].dev.node_id);
+      return executor->error.code;
+    }
+  
+  if (!executor->running) {
+    pthread_attr_init(&attr);
+    
+    if (executor->priority > 0) {
+      param.sched_priority = executor->priority;
+      
+      pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+      pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+      if (pthread_attr_setschedparam(&attr, &param))
+        error_setf(&executor->error, EPOS_EXECUTOR_ERROR_SCHEDULING,
+          "Invalid SCHED_FIFO priority %d", executor->priority);
+    }
+    if (!executor->error.code && (executor->cpu >= 0)) {
+      CPU_ZERO(&cpus);
+      CPU_SET(executor->cpu, &cpus);
+      
+      if (pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus))
+        error_setf(&executor->error, EPOS_EXECUTOR_ERROR_SCHEDULING,
+          "Invalid CPU %d", executor->cpu);
+    }
+    
+    if (!executor->error.code) {
+      executor->running = 1;
+      
+      if (pthread_create(&executor->thread, &attr, epos_executor_run,
+          executor)) {
+        executor->running = 0;
+        error_set(&executor->error, EPOS_EXECUTOR_ERROR_START);
+      }
+    }
+    
+    pthread_attr_destroy(&attr);
+  }
+  
+  return executor->error.code;
+}
+
+int epos_executor_stop(epos_executor_t* executor) {
+  if (executor->running) {
+    pthread_mutex_lock(&executor->mutex);
+    executor->running = 0;
+    pthread_mutex_unlock(&executor->mutex);
+    
+    pthread_join(executor->thread, 0);
+  }
+  
+  return executor->error.code;
+}
+
+void epos_executor_get_statistics(epos_executor_t* executor,
+    epos_executor_statistics_t* statistics) {
+  pthread_mutex_lock(&executor->mutex);
+  *statistics = executor->statistics;
+  pthread_mutex_unlock(&executor->mutex);
+}
+
+void epos_executor_get_histograms(epos_executor_t* executor,
+    epos_histogram_t* latencies, epos_histogram_t* durations) {
+  pthread_mutex_lock(&executor->mutex);
+  if (latencies)
+    *latencies = executor->latencies;
+  if (durations)
+    *durations = executor->durations;
+  pthread_mutex_unlock(&executor->mutex);
+}
+
+void* epos_executor_run(void* arg) {
+  epos_executor_t* executor = arg;
+  epos_executor_statistics_t* statistics = &executor->statistics;
+  double period = executor->sync.period;
+  double deadline, start, time;
+  struct timespec next;
+  unsigned int counter;
+  int i, missed, running = 1;
+  
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  
+  while (running) {
+    epos_executor_advance(&next, period);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0);
+    
+    deadline = next.tv_sec+next.tv_nsec/1e9;
+    start = epos_clock_get();
+    
+    missed = epos_sync_send(&executor->sync);
+    if (!missed) {
+      counter = epos_sync_get_counter(&executor->sync);
+      missed = epos_sync_snapshot(&executor->sync, &executor->inputs,
+        counter, deadline+period-start);
+    }
+    
+    if (executor->callback)
+      executor->callback(executor, &executor->inputs, executor->user_data);
+    
+    for (i = 0; i < executor->num_nodes; ++i)
+      if (epos_pdo_image_is_mapped(&executor->nodes[i].pdo))
+        epos_pdo_image_send(&executor->nodes[i].pdo);
+    
+    time = epos_clock_get();
+    
+    pthread_mutex_lock(&executor->mutex);
+    
+    ++statistics->num_cycles;
+    if (missed)
+      ++statistics->num_missed;
+    if (start-deadline > statistics->max_latency)
+      statistics->max_latency = start-deadline;
+    if (time-start > statistics->max_duration)
+      statistics->max_duration = time-start;
+    epos_histogram_record(&executor->latencies, start-deadline);
+    epos_histogram_record(&executor->durations, time-start);
+    
+    if (time > deadline+period) {
+      ++statistics->num_overruns;
+      epos_executor_advance(&next, floor((time-deadline)/period)*period);
+    }
+    
+    running = executor->running;
+    pthread_mutex_unlock(&executor->mutex);
+  }
+  
+  return 0;
+}
+
+void epos_executor_advance(struct timespec* time, double period) {
+  time->tv_sec += (time_t)period;
+  time->tv_nsec += (period-(time_t)period)*1e9;
+  if (time->tv_nsec >= 1000000000) {
+    time->tv_nsec -= 1000000000;
+    ++time->tv_sec;
+  }
+}
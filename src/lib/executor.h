@@ -0,0 +1,201 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef EPOS_EXECUTOR_H
+#define EPOS_EXECUTOR_H
+
+#include <pthread.h>
+
+#include "epos.h"
+#include "sync.h"
+#include "histogram.h"
+
+/** \file executor.h
+  * \brief EPOS cyclic executor
+  * 
+  * The cyclic executor runs the control loop of a group of EPOS nodes
+  * sharing a CAN device on a dedicated thread at a fixed period. Each
+  * cycle waits for an absolute deadline of the monotonic clock and then
+  * sends a SYNC message, latches the synchronous TPDOs of all nodes into
+  * a snapshot, invokes the user callback with this snapshot, and finally
+  * flushes the RPDOs of all nodes. The callback thus reads consistent
+  * inputs and sets its outputs in the process images of the nodes.
+  * 
+  * The executor thread may be given real-time priority under the
+  * SCHED_FIFO policy and be pinned to a CPU. A cycle which exceeds its
+  * period is counted as an overrun, and the executor resumes with the
+  * next deadline in the future rather than trying to catch up.
+  */
+
+/** \name Error Codes
+  * \brief Predefined EPOS executor error codes
+  */
+//@{
+#define EPOS_EXECUTOR_ERROR_NONE                  0
+//!< Success
+#define EPOS_EXECUTOR_ERROR_START                 1
+//!< Failed to start executor thread
+#define EPOS_EXECUTOR_ERROR_SCHEDULING            2
+//!< Failed to apply executor scheduling
+#define EPOS_EXECUTOR_ERROR_NODES                 3
+//!< Invalid executor nodes
+//@}
+
+/** \brief Predefined EPOS executor error descriptions
+  */
+extern const char* epos_executor_errors[];
+
+struct epos_executor_t;
+
+/** \brief EPOS executor cycle callback
+  * \param[in] executor The EPOS executor running the cycle.
+  * \param[in] inputs The snapshot of the process images latched in this
+  *   cycle. Its counter lags behind the counter of the SYNC producer if
+  *   the synchronous TPDOs did not arrive within the period.
+  * \param[in] user_data The user data passed to the executor.
+  */
+typedef void (*epos_executor_callback_t)(
+  struct epos_executor_t* executor,
+  const epos_sync_snapshot_t* inputs,
+  void* user_data);
+
+/** \brief Structure defining EPOS executor statistics
+  */
+typedef struct epos_executor_statistics_t {
+  size_t num_cycles;               //!< The number of completed cycles.
+  size_t num_overruns;             //!< The number of cycles overrunning.
+  size_t num_missed;               //!< The number of incomplete snapshots.
+  double max_latency;              //!< The maximum wake-up latency in [s].
+  double max_duration;             //!< The maximum cycle duration in [s].
+} epos_executor_statistics_t;
+
+/** \brief Structure defining an EPOS cyclic executor
+  */
+typedef struct epos_executor_t {
+  epos_node_t* nodes;              //!< The nodes controlled by the executor.
+  size_t num_nodes;                //!< The number of controlled nodes.
+
+  epos_sync_t sync;                //!< The SYNC producer of the executor.
+  epos_sync_snapshot_t inputs;     //!< The latched process images.
+
+  epos_executor_callback_t
+    callback;                      //!< The cycle callback, or null.
+  void* user_data;                 //!< The user data of the callback.
+
+  int priority;                    //!< The SCHED_FIFO priority, or zero.
+  int cpu;                         //!< The CPU of the thread, or negative.
+
+  pthread_t thread;                //!< The executor thread.
+  pthread_mutex_t mutex;           //!< The executor mutex.
+  int running;                     //!< The executor is running.
+
+  epos_executor_statistics_t
+    statistics;                    //!< The executor statistics.
+  epos_histogram_t latencies;      //!< The wake-up latencies of the cycles.
+  epos_histogram_t durations;      //!< The durations of the cycles.
+
+  error_t error;                   //!< The most recent executor error.
+} epos_executor_t;
+
+/** \brief Initialize EPOS cyclic executor
+  * \param[in] executor The EPOS executor to be initialized.
+  * \param[in] nodes The array of EPOS nodes to be controlled. All nodes
+  *   must share the same CAN device.
+  * \param[in] num_nodes The number of nodes in the array.
+  * \param[in] frequency The cycle frequency of the executor in [Hz].
+  * \param[in] callback The cycle callback, or null.
+  * \param[in] user_data The user data passed to the callback.
+  * 
+  * The executor initially runs under the default scheduling policy and
+  * is not pinned to any CPU.
+  */
+void epos_executor_init(
+  epos_executor_t* executor,
+  epos_node_t* nodes,
+  size_t num_nodes,
+  double frequency,
+  epos_executor_callback_t callback,
+  void* user_data);
+
+/** \brief Destroy EPOS cyclic executor
+  * \param[in] executor The EPOS executor to be destroyed.
+  * 
+  * A running executor will be stopped before destruction.
+  */
+void epos_executor_destroy(
+  epos_executor_t* executor);
+
+/** \brief Set the scheduling of an EPOS executor thread
+  * \param[in] executor The EPOS executor to set the scheduling for.
+  * \param[in] priority The SCHED_FIFO priority of the executor thread,
+  *   or zero for the default scheduling policy.
+  * \param[in] cpu The CPU the executor thread will be pinned to, or a
+  *   negative value to let the thread run on any CPU.
+  * 
+  * The scheduling applies to the next start of the executor. Real-time
+  * priorities usually require appropriate privileges.
+  */
+void epos_executor_set_scheduling(
+  epos_executor_t* executor,
+  int priority,
+  int cpu);
+
+/** \brief Start EPOS cyclic executor
+  * \param[in] executor The EPOS executor to be started.
+  * \return The resulting error code.
+  * 
+  * Since the executor produces the SYNC on a single CAN device, it refuses
+  * to start with an empty set of nodes or with nodes attached to different
+  * CAN devices.
+  */
+int epos_executor_start(
+  epos_executor_t* executor);
+
+/** \brief Stop EPOS cyclic executor
+  * \param[in] executor The EPOS executor to be stopped.
+  * \return The resulting error code.
+  * 
+  * The executor completes its current cycle before it stops.
+  */
+int epos_executor_stop(
+  epos_executor_t* executor);
+
+/** \brief Retrieve the statistics of an EPOS executor
+  * \param[in] executor The EPOS executor to retrieve the statistics for.
+  * \param[out] statistics The statistics of the executor.
+  */
+void epos_executor_get_statistics(
+  epos_executor_t* executor,
+  epos_executor_statistics_t* statistics);
+
+/** \brief Retrieve the histograms of an EPOS executor
+  * \param[in] executor The EPOS executor to retrieve the histograms for.
+  * \param[out] latencies The histogram of the wake-up latencies of the
+  *   executor cycles, i.e., their jitter with respect to the deadlines,
+  *   or null.
+  * \param[out] durations The histogram of the durations of the executor
+  *   cycles, or null.
+  */
+void epos_executor_get_histograms(
+  epos_executor_t* executor,
+  epos_histogram_t* latencies,
+  epos_histogram_t* durations);
+
+#endif
@@ -0,0 +1,249 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "heartbeat.h"
+#include "bus.h"
+#include "clock.h"
+#include "macros.h"
+
+const char* epos_heartbeat_errors[] = {
+  "Success",
+  "No EPOS bus attached to CAN device",
+  "Failed to start heartbeat consumer",
+};
+
+void* epos_heartbeat_run(void* arg);
+void* epos_heartbeat_dispatch(void* arg);
+int epos_heartbeat_update(epos_heartbeat_node_t* node, epos_bus_t* bus,
+  double time);
+
+void epos_heartbeat_init(epos_heartbeat_t* heartbeat, can_device_t* can_dev,
+    epos_heartbeat_callback_t callback, void* user_data) {
+  pthread_condattr_t cond_attr;
+  
+  heartbeat->can_dev = can_dev;
+  
+  heartbeat->nodes = 0;
+  heartbeat->num_nodes = 0;
+  
+  heartbeat->callback = callback;
+  heartbeat->user_data = user_data;
+  
+  pthread_mutex_init(&heartbeat->mutex, 0);
+  pthread_condattr_init(&cond_attr);
+  pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&heartbeat->cond, &cond_attr);
+  pthread_condattr_destroy(&cond_attr);
+  heartbeat->running = 0;
+  
+  error_init(&heartbeat->error, epos_heartbeat_errors);
+}
+
+void epos_heartbeat_destroy(epos_heartbeat_t* heartbeat) {
+  if (heartbeat->running)
+    epos_heartbeat_stop(heartbeat);
+  
+  if (heartbeat->num_nodes) {
+    free(heartbeat->nodes);
+    
+    heartbeat->nodes = 0;
+    heartbeat->num_nodes = 0;
+  }
+  
+  pthread_cond_destroy(&heartbeat->cond);
+  pthread_mutex_destroy(&heartbeat->mutex);
+  error_destroy(&heartbeat->error);
+}
+
+void epos_heartbeat_add_device(epos_heartbeat_t* heartbeat, epos_device_t*
+    dev, double timeout) {
+  epos_heartbeat_node_t* node;
+  
+  pthread_mutex_lock(&heartbeat->mutex);
+  
+  heartbeat->nodes = realloc(heartbeat->nodes, (heartbeat->num_nodes+1)*
+    sizeof(epos_heartbeat_node_t));
+  node = &heartbeat->nodes[heartbeat->num_nodes];
+  ++heartbeat->num_nodes;
+  
+  node->dev = dev;
+  node->timeout = timeout;
+  
+  node->timestamp = 0.0;
+  node->nmt_state = 0;
+  node->alive = 0;
+  
+  pthread_mutex_unlock(&heartbeat->mutex);
+}
+
+int epos_heartbeat_start(epos_heartbeat_t* heartbeat) {
+  epos_bus_t* bus = epos_bus_find(heartbeat->can_dev);
+  double time = epos_clock_get();
+  int i;
+  
+  error_clear(&heartbeat->error);
+  
+  if (!bus)
+    error_set(&heartbeat->error, EPOS_HEARTBEAT_ERROR_BUS);
+  else if (!heartbeat->running) {
+    for (i = 0; i < heartbeat->num_nodes; ++i) {
+      epos_heartbeat_node_t* node = &heartbeat->nodes[i];
+      
+      node->timestamp = time;
+      node->nmt_state = epos_bus_get_nmt_state(bus, node->dev->node_id);
+      node->alive = 1;
+    }
+    
+    heartbeat->running = 1;
+    
+    if (pthread_create(&heartbeat->thread, 0, epos_heartbeat_run,
+        heartbeat)) {
+      heartbeat->running = 0;
+      error_set(&heartbeat->error, EPOS_HEARTBEAT_ERROR_START);
+    }
+    else if (pthread_create(&heartbeat->dispatch_thread, 0,
+        epos_heartbeat_dispatch, heartbeat)) {
+      pthread_mutex_lock(&heartbeat->mutex);
+      heartbeat->running = 0;
+      pthread_cond_signal(&heartbeat->cond);
+      pthread_mutex_unlock(&heartbeat->mutex);
+      
+      pthread_join(heartbeat->thread, 0);
+      error_set(&heartbeat->error, EPOS_HEARTBEAT_ERROR_START);
+    }
+  }
+  
+  return heartbeat->error.code;
+}
+
+int epos_heartbeat_stop(epos_heartbeat_t* heartbeat) {
+  if (heartbeat->running) {
+    pthread_mutex_lock(&heartbeat->mutex);
+    heartbeat->running = 0;
+    pthread_cond_signal(&heartbeat->cond);
+    pthread_mutex_unlock(&heartbeat->mutex);
+    
+    pthread_join(heartbeat->dispatch_thread, 0);
+    pthread_join(heartbeat->thread, 0);
+  }
+  
+  return heartbeat->error.code;
+}
+
+int epos_heartbeat_get_node(epos_heartbeat_t* heartbeat, epos_device_t* dev,
+    epos_heartbeat_node_t* node) {
+  int i, result = 0;
+  
+  pthread_mutex_lock(&heartbeat->mutex);
+  
+  for (i = 0; (i < heartbeat->num_nodes) && !result; ++i)
+    if (heartbeat->nodes[i].dev == dev) {
+    *node = heartbeat->nodes[i];
+    result = 1;
+  }
+  
+  pthread_mutex_unlock(&heartbeat->mutex);
+  
+  return result;
+}
+
+void* epos_heartbeat_run(void* arg) {
+  epos_heartbeat_t* heartbeat = arg;
+  epos_bus_t* bus = epos_bus_find(heartbeat->can_dev);
+  epos_heartbeat_node_t node;
+  struct timespec wakeup;
+  double time, deadline;
+  int i, changed;
+  
+  pthread_mutex_lock(&heartbeat->mutex);
+  while (heartbeat->running) {
+    time = epos_clock_get();
+    deadline = time+EPOS_HEARTBEAT_CHECK_PERIOD;
+    
+    for (i = 0; i < heartbeat->num_nodes; ++i) {
+      changed = epos_heartbeat_update(&heartbeat->nodes[i], bus, time);
+      node = heartbeat->nodes[i];
+      
+      if (node.alive)
+        deadline = min(deadline, node.timestamp+node.timeout);
+      
+      if (changed && heartbeat->callback) {
+        pthread_mutex_unlock(&heartbeat->mutex);
+        heartbeat->callback(&node, heartbeat->user_data);
+        pthread_mutex_lock(&heartbeat->mutex);
+      }
+    }
+    
+    if (heartbeat->running) {
+      wakeup.tv_sec = deadline;
+      wakeup.tv_nsec = (deadline-wakeup.tv_sec)*1e9;
+      
+      pthread_cond_timedwait(&heartbeat->cond, &heartbeat->mutex, &wakeup);
+    }
+  }
+  pthread_mutex_unlock(&heartbeat->mutex);
+  
+  return 0;
+}
+
+void* epos_heartbeat_dispatch(void* arg) {
+  epos_heartbeat_t* heartbeat = arg;
+  epos_bus_t* bus = epos_bus_find(heartbeat->can_dev);
+  
+  pthread_mutex_lock(&heartbeat->mutex);
+  while (heartbeat->running) {
+    pthread_mutex_unlock(&heartbeat->mutex);
+    
+    if (epos_bus_dispatch(bus))
+      epos_clock_sleep(EPOS_HEARTBEAT_RETRY_PERIOD);
+    
+    pthread_mutex_lock(&heartbeat->mutex);
+    pthread_cond_signal(&heartbeat->cond);
+  }
+  pthread_mutex_unlock(&heartbeat->mutex);
+  
+  return 0;
+}
+
+int epos_heartbeat_update(epos_heartbeat_node_t* node, epos_bus_t* bus,
+    double time) {
+  int node_id = node->dev->node_id;
+  double timestamp = epos_bus_get_nmt_timestamp(bus, node_id);
+  
+  if (timestamp > node->timestamp) {
+    unsigned char nmt_state = epos_bus_get_nmt_state(bus, node_id);
+    int changed = !node->alive || (nmt_state != node->nmt_state);
+    
+    node->timestamp = timestamp;
+    node->nmt_state = nmt_state;
+    node->alive = 1;
+    
+    return changed;
+  }
+  else if (node->alive && (time-node->timestamp > node->timeout)) {
+    node->alive = 0;
+    return 1;
+  }
+  
+  return 0;
+}
@@ -0,0 +1,178 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef EPOS_HEARTBEAT_H
+#define EPOS_HEARTBEAT_H
+
+#include <pthread.h>
+
+#include "device.h"
+
+/** \file heartbeat.h
+  * \brief EPOS heartbeat consumer
+  * 
+  * EPOS devices configured to produce a heartbeat periodically broadcast
+  * their NMT state without being requested. The heartbeat consumer runs
+  * a background thread which supervises the heartbeats of its devices
+  * and notifies the application through a callback as soon as a device
+  * is lost, recovers, or changes its NMT state. Supervision thus does
+  * not require any SDO transfers.
+  * 
+  * The consumer runs two threads. The dispatch thread takes part in
+  * dispatching the bus of its CAN device and wakes the supervision thread
+  * whenever a message has been dispatched. The supervision thread waits
+  * for the earliest heartbeat deadline of its alive devices, such that a
+  * lost device is detected as soon as its heartbeat has timed out, even
+  * if the bus has fallen silent.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS heartbeat constants
+  */
+//@{
+#define EPOS_HEARTBEAT_RETRY_PERIOD               1e-3
+#define EPOS_HEARTBEAT_CHECK_PERIOD               0.1
+//@}
+
+/** \name Error Codes
+  * \brief Predefined EPOS heartbeat error codes
+  */
+//@{
+#define EPOS_HEARTBEAT_ERROR_NONE                 0
+//!< Success
+#define EPOS_HEARTBEAT_ERROR_BUS                  1
+//!< No EPOS bus attached to CAN device
+#define EPOS_HEARTBEAT_ERROR_START                2
+//!< Failed to start heartbeat consumer
+//@}
+
+/** \brief Predefined EPOS heartbeat error descriptions
+  */
+extern const char* epos_heartbeat_errors[];
+
+/** \brief Structure defining an EPOS heartbeat consumer node
+  */
+typedef struct epos_heartbeat_node_t {
+  epos_device_t* dev;              //!< The supervised EPOS device.
+  double timeout;                  //!< The heartbeat timeout in [s].
+
+  double timestamp;                //!< The time of the latest heartbeat.
+  unsigned char nmt_state;         //!< The latest reported NMT state.
+  int alive;                       //!< The device is considered alive.
+} epos_heartbeat_node_t;
+
+/** \brief EPOS heartbeat callback
+  * \param[in] node The EPOS heartbeat consumer node which has been lost,
+  *   recovered, or has changed its NMT state.
+  * \param[in] user_data The user data passed to the heartbeat consumer.
+  * 
+  * The callback is invoked from the supervision thread of the consumer
+  * and should return quickly.
+  */
+typedef void (*epos_heartbeat_callback_t)(
+  const epos_heartbeat_node_t* node,
+  void* user_data);
+
+/** \brief Structure defining an EPOS heartbeat consumer
+  */
+typedef struct epos_heartbeat_t {
+  can_device_t* can_dev;           //!< The CAN device of the consumer.
+
+  epos_heartbeat_node_t* nodes;    //!< The supervised nodes.
+  size_t num_nodes;                //!< The number of supervised nodes.
+
+  epos_heartbeat_callback_t
+    callback;                      //!< The liveness callback, or null.
+  void* user_data;                 //!< The user data of the callback.
+
+  pthread_t thread;                //!< The heartbeat supervision thread.
+  pthread_t dispatch_thread;       //!< The heartbeat dispatch thread.
+  pthread_mutex_t mutex;           //!< The heartbeat consumer mutex.
+  pthread_cond_t cond;             //!< The heartbeat dispatch condition.
+  int running;                     //!< The heartbeat consumer is running.
+
+  error_t error;                   //!< The most recent consumer error.
+} epos_heartbeat_t;
+
+/** \brief Initialize EPOS heartbeat consumer
+  * \param[in] heartbeat The EPOS heartbeat consumer to be initialized.
+  * \param[in] can_dev The CAN device of the supervised devices.
+  * \param[in] callback The liveness callback, or null.
+  * \param[in] user_data The user data passed to the callback.
+  */
+void epos_heartbeat_init(
+  epos_heartbeat_t* heartbeat,
+  can_device_t* can_dev,
+  epos_heartbeat_callback_t callback,
+  void* user_data);
+
+/** \brief Destroy EPOS heartbeat consumer
+  * \param[in] heartbeat The EPOS heartbeat consumer to be destroyed.
+  * 
+  * A running heartbeat consumer will be stopped before destruction.
+  */
+void epos_heartbeat_destroy(
+  epos_heartbeat_t* heartbeat);
+
+/** \brief Add a device to an EPOS heartbeat consumer
+  * \param[in] heartbeat The EPOS heartbeat consumer to add the device to.
+  * \param[in] dev The EPOS device to be supervised. Its heartbeat
+  *   production should have been configured using
+  *   epos_device_set_heartbeat().
+  * \param[in] timeout The heartbeat timeout of the device in [s], which
+  *   must exceed the heartbeat period of the device.
+  */
+void epos_heartbeat_add_device(
+  epos_heartbeat_t* heartbeat,
+  epos_device_t* dev,
+  double timeout);
+
+/** \brief Start EPOS heartbeat consumer
+  * \param[in] heartbeat The EPOS heartbeat consumer to be started.
+  * \return The resulting error code.
+  * 
+  * All supervised devices are initially considered alive, such that a
+  * device which does not produce a heartbeat within its timeout will be
+  * reported lost.
+  */
+int epos_heartbeat_start(
+  epos_heartbeat_t* heartbeat);
+
+/** \brief Stop EPOS heartbeat consumer
+  * \param[in] heartbeat The EPOS heartbeat consumer to be stopped.
+  * \return The resulting error code.
+  */
+int epos_heartbeat_stop(
+  epos_heartbeat_t* heartbeat);
+
+/** \brief Retrieve the state of a supervised device
+  * \param[in] heartbeat The EPOS heartbeat consumer supervising the device.
+  * \param[in] dev The supervised EPOS device to retrieve the state for.
+  * \param[out] node The state of the heartbeat consumer node of the
+  *   device.
+  * \return One if the device is supervised by the heartbeat consumer,
+  *   zero otherwise.
+  */
+int epos_heartbeat_get_node(
+  epos_heartbeat_t* heartbeat,
+  epos_device_t* dev,
+  epos_heartbeat_node_t* node);
+
+#endif
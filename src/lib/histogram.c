@@ -0,0 +1,238 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "histogram.h"
+
+size_t epos_histogram_get_bucket(double value);
+double epos_histogram_get_upper_bound(size_t bucket);
+
+void epos_histogram_init(epos_histogram_t* histogram) {
+  epos_histogram_clear(histogram);
+}
+
+void epos_histogram_clear(epos_histogram_t* histogram) {
+  memset(histogram->counts, 0, sizeof(histogram->counts));
+  
+  histogram->num_values = 0;
+  histogram->min = 0.0;
+  histogram->max = 0.0;
+  histogram->sum = 0.0;
+}
+
+void epos_histogram_record(epos_histogram_t* histogram, double value) {
+  if (value < 0.0)
+    value = 0.0;
+  
+  ++histogram->counts[epos_histogram_get_bucket(value)];
+  
+  if (!histogram->num_values || (value < histogram->min))
+    histogram->min = value;
+  if (!histogram->num_values || (value > histogram->max))
+    histogram->max = value;
+  histogram->sum += value;
+  ++histogram->num_values;
+}
+
+void epos_histogram_merge(epos_histogram_t* histogram, const
+    epos_histogram_t* other) {
+  size_t i;
+  
+  if (!other->num_values)
+    return;
+  
+  for (i = 0; i < EPOS_HISTOGRAM_NUM_BUCKETS; ++i)
+    histogram->counts[i] += other->counts[i];
+  
+  if (!histogram->num_values || (other->min < histogram->min))
+    histogram->min = other->min;
+  if (!histogram->num_values || (other->max > histogram->max))
+    histogram->max = other->max;
+  histogram->sum += other->sum;
+  histogram->num_values += other->num_values;
+}
+
+double epos_histogram_get_mean(const epos_histogram_t* histogram) {
+  return histogram->num_values ?
+    histogram->sum/histogram->num_values : 0.0;
+}
+
+double epos_histogram_get_percentile(const epos_histogram_t* histogram,
+    double percentile) {
+  size_t i, count = 0, rank = percentile*1e-2*histogram->num_values+0.5;
+  double bound;
+  
+  if (!histogram->num_values)
+    return 0.0;
+  if (!rank)
+    rank = 1;
+  
+  for (i = 0; i < EPOS_HISTOGRAM_NUM_BUCKETS; ++i) {
+    count += histogram->counts[i];
+    if (count >= rank)
+      break;
+  }
+  
+  bound = epos_histogram_get_upper_bound(i);
+  return (bound < histogram->max) ? bound : histogram->max;
+}
+
+void epos_histogram_print(const epos_histogram_t* histogram, FILE* stream) {
+  size_t i, count = 0;
+  
+  fprintf(stream, "# count %zu min %g mean %g max %g\n",
+    histogram->num_values, histogram->min,
+    epos_histogram_get_mean(histogram), histogram->max);
+  
+  for (i = 0; i < EPOS_HISTOGRAM_NUM_BUCKETS; ++i)
+      if (histogram->counts[i]) {
+    count += histogram->counts[i];
+    fprintf(stream, "%g %.3f %zu\n", epos_histogram_get_upper_bound(i),
+      1e2*count/histogram->num_values, count);
+  }
+}
+
+void epos_histogram_set_init(epos_histogram_set_t* set) {
+  set->keys = 0;
+  set->histograms = 0;
+  set->num_histograms = 0;
+  set->num_dropped = 0;
+}
+
+void epos_histogram_set_destroy(epos_histogram_set_t* set) {
+  size_t i;
+  
+  for (i = 0; i < set->num_histograms; ++i)
+    free(set->histograms[i]);
+  free(set->histograms);
+  free(set->keys);
+  
+  set->keys = 0;
+  set->histograms = 0;
+  set->num_histograms = 0;
+}
+
+void epos_histogram_set_clear(epos_histogram_set_t* set) {
+  size_t i;
+  
+  for (i = 0; i < set->num_histograms; ++i)
+    epos_histogram_clear(set->histograms[i]);
+  set->num_dropped = 0;
+}
+
+epos_histogram_t* epos_histogram_set_find(const epos_histogram_set_t* set,
+    int key) {
+  size_t first = 0, last = set->num_histograms;
+  
+  while (first < last) {
+    size_t middle = (first+last)/2;
+    
+    if (set->keys[middle] < key)
+      first = middle+1;
+    else if (set->keys[middle] > key)
+      last = middle;
+    else
+      return set->histograms[middle];
+  }
+  
+  return 0;
+}
+
+int epos_histogram_set_record(epos_histogram_set_t* set, int key, double
+    value) {
+  epos_histogram_t* histogram = epos_histogram_set_find(set, key);
+  epos_histogram_t** histograms;
+  int* keys;
+  size_t i;
+  
+  if (!histogram) {
+    if ((keys = realloc(set->keys, (set->num_histograms+1)*sizeof(int))))
+      set->keys = keys;
+    if ((histograms = realloc(set->histograms, (set->num_histograms+1)*
+        sizeof(epos_histogram_t*))))
+      set->histograms = histograms;
+    
+    if (!keys || !histograms ||
+        !(histogram = malloc(sizeof(epos_histogram_t)))) {
+      ++set->num_dropped;
+      return 0;
+    }
+    epos_histogram_init(histogram);
+    
+    for (i = set->num_histograms; (i > 0) && (set->keys[i-1] > key); --i) {
+      set->keys[i] = set->keys[i-1];
+      set->histograms[i] = set->histograms[i-1];
+    }
+    set->keys[i] = key;
+    set->histograms[i] = histogram;
+    ++set->num_histograms;
+  }
+  
+  epos_histogram_record(histogram, value);
+  
+  return 1;
+}
+
+void epos_histogram_set_print(const epos_histogram_set_t* set, FILE*
+    stream) {
+  size_t i;
+  
+  if (set->num_dropped)
+    fprintf(stream, "# dropped %lu\n", (unsigned long)set->num_dropped);
+  for (i = 0; i < set->num_histograms; ++i) {
+    fprintf(stream, "# key 0x%04X\n", set->keys[i]);
+    epos_histogram_print(set->histograms[i], stream);
+  }
+}
+
+size_t epos_histogram_get_bucket(double value) {
+  double steps = value/EPOS_HISTOGRAM_RESOLUTION;
+  unsigned long long quantized;
+  size_t magnitude = EPOS_HISTOGRAM_SUB_BUCKET_BITS;
+  
+  if (steps >= (double)(1ULL << (EPOS_HISTOGRAM_MAGNITUDES+
+      EPOS_HISTOGRAM_SUB_BUCKET_BITS-1)))
+    return EPOS_HISTOGRAM_NUM_BUCKETS-1;
+  
+  quantized = steps;
+  if (quantized < EPOS_HISTOGRAM_SUB_BUCKETS)
+    return quantized;
+  
+  while (quantized >> (magnitude+1))
+    ++magnitude;
+  
+  return (magnitude-EPOS_HISTOGRAM_SUB_BUCKET_BITS+1)*
+    EPOS_HISTOGRAM_SUB_BUCKETS+((quantized >> (magnitude-
+    EPOS_HISTOGRAM_SUB_BUCKET_BITS)) & (EPOS_HISTOGRAM_SUB_BUCKETS-1));
+}
+
+double epos_histogram_get_upper_bound(size_t bucket) {
+  size_t magnitude, sub_bucket;
+  
+  if (bucket < EPOS_HISTOGRAM_SUB_BUCKETS)
+    return (bucket+1)*EPOS_HISTOGRAM_RESOLUTION;
+  
+  magnitude = bucket/EPOS_HISTOGRAM_SUB_BUCKETS-1;
+  sub_bucket = bucket % EPOS_HISTOGRAM_SUB_BUCKETS;
+  
+  return (double)((EPOS_HISTOGRAM_SUB_BUCKETS+sub_bucket+1ULL) <<
+    magnitude)*EPOS_HISTOGRAM_RESOLUTION;
+}
@@ -0,0 +1,190 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef EPOS_HISTOGRAM_H
+#define EPOS_HISTOGRAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/** \file histogram.h
+  * \brief EPOS latency histograms
+  * 
+  * Latency histograms record the distribution of time intervals, such
+  * as SDO round trip times or the wake-up latencies of control loops,
+  * at constant memory and recording cost. Values are quantized to the
+  * histogram resolution and sorted into log-linear buckets: Values below
+  * EPOS_HISTOGRAM_SUB_BUCKETS resolution steps are recorded exactly,
+  * whereas each further power of two is divided into
+  * EPOS_HISTOGRAM_SUB_BUCKETS buckets of equal width. The relative error
+  * of a recorded value is thus bounded by the inverse of the number of
+  * sub-buckets.
+  * 
+  * Histogram sets maintain one histogram per integer key, such as the
+  * index of an object dictionary entry, which is created on demand.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS histogram constants
+  */
+//@{
+#define EPOS_HISTOGRAM_RESOLUTION                 1e-6
+#define EPOS_HISTOGRAM_SUB_BUCKET_BITS            4
+#define EPOS_HISTOGRAM_SUB_BUCKETS                16
+#define EPOS_HISTOGRAM_MAGNITUDES                 29
+#define EPOS_HISTOGRAM_NUM_BUCKETS                \
+  (EPOS_HISTOGRAM_MAGNITUDES*EPOS_HISTOGRAM_SUB_BUCKETS)
+//@}
+
+/** \brief Structure defining an EPOS latency histogram
+  */
+typedef struct epos_histogram_t {
+  size_t counts[EPOS_HISTOGRAM_NUM_BUCKETS]; //!< The bucket counts.
+  size_t num_values;               //!< The number of recorded values.
+  double min;                      //!< The minimum recorded value in [s].
+  double max;                      //!< The maximum recorded value in [s].
+  double sum;                      //!< The sum of recorded values in [s].
+} epos_histogram_t;
+
+/** \brief Structure defining a set of EPOS latency histograms
+  */
+typedef struct epos_histogram_set_t {
+  int* keys;                       //!< The sorted keys of the histograms.
+  epos_histogram_t** histograms;   //!< The histograms by key.
+  size_t num_histograms;           //!< The number of histograms in the set.
+  size_t num_dropped;              //!< The number of values not recorded.
+} epos_histogram_set_t;
+
+/** \brief Initialize EPOS latency histogram
+  * \param[in] histogram The EPOS histogram to be initialized.
+  */
+void epos_histogram_init(
+  epos_histogram_t* histogram);
+
+/** \brief Clear EPOS latency histogram
+  * \param[in] histogram The EPOS histogram to be cleared.
+  */
+void epos_histogram_clear(
+  epos_histogram_t* histogram);
+
+/** \brief Record a value in an EPOS latency histogram
+  * \param[in] histogram The EPOS histogram to record the value in.
+  * \param[in] value The value to be recorded in [s]. Negative values are
+  *   recorded as zero, values beyond the range of the histogram are
+  *   recorded in its last bucket.
+  */
+void epos_histogram_record(
+  epos_histogram_t* histogram,
+  double value);
+
+/** \brief Merge EPOS latency histograms
+  * \param[in] histogram The EPOS histogram to merge the values into.
+  * \param[in] other The EPOS histogram whose values are to be merged.
+  */
+void epos_histogram_merge(
+  epos_histogram_t* histogram,
+  const epos_histogram_t* other);
+
+/** \brief Retrieve the mean of an EPOS latency histogram
+  * \param[in] histogram The EPOS histogram to retrieve the mean for.
+  * \return The mean of the recorded values in [s], or zero if the
+  *   histogram is empty.
+  */
+double epos_histogram_get_mean(
+  const epos_histogram_t* histogram);
+
+/** \brief Retrieve a percentile of an EPOS latency histogram
+  * \param[in] histogram The EPOS histogram to retrieve the percentile for.
+  * \param[in] percentile The requested percentile in [%].
+  * \return The upper bound of the bucket containing the requested
+  *   percentile in [s], limited to the maximum recorded value, or zero
+  *   if the histogram is empty.
+  */
+double epos_histogram_get_percentile(
+  const epos_histogram_t* histogram,
+  double percentile);
+
+/** \brief Print an EPOS latency histogram
+  * \param[in] histogram The EPOS histogram to be printed.
+  * \param[in] stream The stream the histogram will be printed to.
+  * 
+  * A summary of the histogram is printed as a comment line, followed by
+  * a line for each non-empty bucket which lists its upper bound in [s],
+  * the percentile of values up to this bound in [%], and the cumulated
+  * count.
+  */
+void epos_histogram_print(
+  const epos_histogram_t* histogram,
+  FILE* stream);
+
+/** \brief Initialize set of EPOS latency histograms
+  * \param[in] set The EPOS histogram set to be initialized.
+  */
+void epos_histogram_set_init(
+  epos_histogram_set_t* set);
+
+/** \brief Destroy set of EPOS latency histograms
+  * \param[in] set The EPOS histogram set to be destroyed.
+  */
+void epos_histogram_set_destroy(
+  epos_histogram_set_t* set);
+
+/** \brief Clear all histograms of a set of EPOS latency histograms
+  * \param[in] set The EPOS histogram set to be cleared.
+  */
+void epos_histogram_set_clear(
+  epos_histogram_set_t* set);
+
+/** \brief Find a histogram in a set of EPOS latency histograms
+  * \param[in] set The EPOS histogram set to find the histogram in.
+  * \param[in] key The key of the histogram to be found.
+  * \return The histogram with the specified key, or null if the set
+  *   does not contain such histogram.
+  */
+epos_histogram_t* epos_histogram_set_find(
+  const epos_histogram_set_t* set,
+  int key);
+
+/** \brief Record a value in a set of EPOS latency histograms
+  * \param[in] set The EPOS histogram set to record the value in.
+  * \param[in] key The key of the histogram to record the value in. The
+  *   histogram will be created if the set does not contain it.
+  * \param[in] value The value to be recorded in [s].
+  * \return One if the value has been recorded, or zero if the histogram
+  *   could not be allocated. Values not recorded are counted in the set.
+  */
+int epos_histogram_set_record(
+  epos_histogram_set_t* set,
+  int key,
+  double value);
+
+/** \brief Print a set of EPOS latency histograms
+  * \param[in] set The EPOS histogram set to be printed.
+  * \param[in] stream The stream the histograms will be printed to.
+  * 
+  * Each histogram is preceded by a comment line stating its key in
+  * hexadecimal notation. A leading comment line states the number of
+  * values not recorded, if any.
+  */
+void epos_histogram_set_print(
+  const epos_histogram_set_t* set,
+  FILE* stream);
+
+#endif
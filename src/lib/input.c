@@ -22,6 +22,7 @@
 #include <string.h>
 
 #include "input.h"
+#include "sdo.h"
 
 short epos_input_channel_masks[] = {
   0x003F,
@@ -169,24 +170,48 @@ int epos_input_set_enabled(epos_input_t* input, short enabled) {
 }
 
 int epos_input_setup(epos_input_t* input) {
+  epos_sdo_client_t client;
+  epos_sdo_request_t requests[sizeof(input->channels)/
+    sizeof(epos_input_func_type_t)+3];
+  short channels[sizeof(input->channels)/sizeof(epos_input_func_type_t)];
+  size_t num_requests = 0;
+  int i;
+  
   input->channel_mask = epos_input_channel_masks[input->dev->type];
 
-  int i;
   for (i = 0; i < sizeof(input->channels)/sizeof(epos_input_func_type_t);
       ++i) {
     short c = (0x01 << i);
-    if (c & input->channel_mask) {
-      input->channels[i] = epos_input_get_channel_func(input, i+1);
-      error_return(&input->dev->error);
-    }
+    if (c & input->channel_mask)
+      epos_sdo_request_init_read(&requests[num_requests++], input->dev,
+        EPOS_INPUT_INDEX_CONFIG, i+1, (unsigned char*)&channels[i],
+        sizeof(short), 0, 0);
   }
-  input->polarity = epos_input_get_polarity(input);
-  error_return(&input->dev->error);  
-  input->execute = epos_input_get_execute(input);
-  error_return(&input->dev->error);
-  input->enabled = epos_input_get_enabled(input);
+  epos_sdo_request_init_read(&requests[num_requests++], input->dev,
+    EPOS_INPUT_INDEX_FUNCS, EPOS_INPUT_SUBINDEX_POLARITY,
+    (unsigned char*)&input->polarity, sizeof(short), 0, 0);
+  epos_sdo_request_init_read(&requests[num_requests++], input->dev,
+    EPOS_INPUT_INDEX_FUNCS, EPOS_INPUT_SUBINDEX_EXECUTE,
+    (unsigned char*)&input->execute, sizeof(short), 0, 0);
+  epos_sdo_request_init_read(&requests[num_requests++], input->dev,
+    EPOS_INPUT_INDEX_FUNCS, EPOS_INPUT_SUBINDEX_MASK,
+    (unsigned char*)&input->enabled, sizeof(short), 0, 0);
+  
+  error_clear(&input->dev->error);
+  epos_sdo_client_init(&client, input->dev->can_dev, input->dev->timeout);
+  if (epos_sdo_transfer(&client, requests, num_requests))
+    error_blame(&input->dev->error, &client.error,
+      (client.error.code == EPOS_SDO_ERROR_ABORT) ? EPOS_DEVICE_ERROR_ABORT :
+      EPOS_DEVICE_ERROR_RECEIVE);
+  epos_sdo_client_destroy(&client);
   error_return(&input->dev->error);
-
+  
+  for (i = 0; i < sizeof(input->channels)/sizeof(epos_input_func_type_t);
+      ++i) {
+    short c = (0x01 << i);
+    if (c & input->channel_mask)
+      input->channels[i] = channels[i];
+  }
   for (i = 0; i < sizeof(input->funcs)/sizeof(epos_input_func_t); ++i)
     epos_input_get_func(input, i, &input->funcs[i]);
 
@@ -195,11 +220,11 @@ int epos_input_setup(epos_input_t* input) {
 
 void epos_input_get_func(epos_input_t* input, epos_input_func_type_t type,
     epos_input_func_t* func) {
-  input->funcs[type].channel = epos_input_get_func_channel(input, type);
-  input->funcs[type].polarity = epos_input_get_func_polarity(input, type);
-  input->funcs[type].execute = epos_input_get_func_execute(input, type);
+  func->channel = epos_input_get_func_channel(input, type);
+  func->polarity = epos_input_get_func_polarity(input, type);
+  func->execute = epos_input_get_func_execute(input, type);
 
-  input->funcs[type].enabled = epos_input_get_func_enabled(input, type);
+  func->enabled = epos_input_get_func_enabled(input, type);
 }
 
 int epos_input_set_func(epos_input_t* input, epos_input_func_type_t type,
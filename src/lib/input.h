@@ -124,6 +124,10 @@ void epos_input_destroy(
 /** \brief Set EPOS input parameters
   * \param[in] input The EPOS input module to set the parameters for.
   * \return The resulting device error code.
+  * 
+  * The channel configurations and the polarity, execution and enabled
+  * masks are read from the device in a single burst of SDO requests.
+  * The input functionalities are then derived in one pass.
   */
 int epos_input_setup(
   epos_input_t* input);
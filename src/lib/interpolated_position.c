@@ -22,18 +22,41 @@
 #include <string.h>
 #include <math.h>
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <timer/timer.h>
 
 #include "interpolated_position.h"
 
 #include "gear.h"
+#include "clock.h"
 #include "macros.h"
 
 const char* epos_interpolated_position_errors[] = {
   "Success",
   "Profile undefined at value",
+  "Interpolation buffer underflow",
+  "Interpolation buffer overflow",
+  "Failed to prepare profile segments",
 };
 
+void epos_interpolated_position_init_stream(epos_interpolated_position_t*
+  profile);
+int epos_interpolated_position_stream(epos_node_t* node,
+  epos_interpolated_position_t* profile);
+int epos_interpolated_position_send(epos_node_t* node, float position,
+  float velocity, double time);
+ssize_t epos_interpolated_position_search(const epos_interpolated_position_t*
+  profile, double time, size_t index);
+void epos_interpolated_position_eval_polynomials(const
+  epos_interpolated_position_segments_t* segments, const double* times,
+  const size_t* indexes, float* positions, float* velocities, float*
+  accelerations);
+
 void epos_interpolated_position_init(epos_interpolated_position_t* profile,
     const epos_interpolated_position_knot_t* knots, size_t num_knots) {
   if (knots && num_knots) {
@@ -52,6 +75,10 @@ void epos_interpolated_position_init(epos_interpolated_position_t* profile,
   profile->start_knot.time = 0.0;
   profile->start_knot.position = 0.0;
   profile->start_knot.velocity = 0.0;
+  
+  profile->segments.times = 0;
+  epos_interpolated_position_prepare(profile);
+  epos_interpolated_position_init_stream(profile);
 }
 
 void epos_interpolated_position_init_spline(epos_interpolated_position_t*
@@ -87,22 +114,210 @@ void epos_interpolated_position_init_spline(epos_interpolated_position_t*
     
     profile->knots = 0;
     profile->num_knots = 0;
-  }  
+  }
+  
+  profile->segments.times = 0;
+  epos_interpolated_position_prepare(profile);
+  epos_interpolated_position_init_stream(profile);
+}
+
+void epos_interpolated_position_init_stream(epos_interpolated_position_t*
+    profile) {
+  profile->stream_index = 0;
+  profile->stream_time = profile->start_knot.time;
+  profile->stream_terminated = 0;
+}
+
+int epos_interpolated_position_prepare(epos_interpolated_position_t*
+    profile) {
+  size_t size = (profile->num_knots+EPOS_INTERPOLATED_POSITION_ALIGNMENT/
+    sizeof(double)) & ~(EPOS_INTERPOLATED_POSITION_ALIGNMENT/
+    sizeof(double)-1);
+  void* buffer;
+  size_t i;
+  
+  free(profile->segments.times);
+  memset(&profile->segments, 0, sizeof(profile->segments));
+  
+  if (!profile->num_knots)
+    return EPOS_INTERPOLATED_POSITION_ERROR_NONE;
+  else if (posix_memalign(&buffer, EPOS_INTERPOLATED_POSITION_ALIGNMENT,
+      5*size*sizeof(double)))
+    return EPOS_INTERPOLATED_POSITION_ERROR_PREPARE;
+  else {
+    profile->segments.start_knot = profile->start_knot;
+    profile->segments.times = buffer;
+    profile->segments.a = profile->segments.times+size;
+    profile->segments.b = profile->segments.a+size;
+    profile->segments.c = profile->segments.b+size;
+    profile->segments.d = profile->segments.c+size;
+    
+    profile->segments.times[0] = profile->start_knot.time;
+    for (i = 0; i < profile->num_knots; ++i) {
+      const epos_interpolated_position_knot_t* knot_j = i ?
+        &profile->knots[i-1] : &profile->start_knot;
+      const epos_interpolated_position_knot_t* knot_i = &profile->knots[i];
+      double p_j = knot_j->position, v_j = knot_j->velocity;
+      double p_i = knot_i->position, v_i = knot_i->velocity;
+      double t = knot_i->time-knot_j->time;
+      
+      profile->segments.times[i+1] = knot_i->time;
+      profile->segments.a[i] = (-2.0*(p_i-p_j)+t*(v_i+v_j))/cub(t);
+      profile->segments.b[i] = (3.0*(p_i-p_j)-t*(v_i+2.0*v_j))/sqr(t);
+      profile->segments.c[i] = v_j;
+      profile->segments.d[i] = p_j;
+    }
+    
+    return EPOS_INTERPOLATED_POSITION_ERROR_NONE;
+  }
+}
+
+int epos_interpolated_position_is_prepared(const
+    epos_interpolated_position_t* profile) {
+  const epos_interpolated_position_knot_t* knot =
+    &profile->segments.start_knot;
+  
+  return profile->segments.times &&
+    (knot->time == profile->start_knot.time) &&
+    (knot->position == profile->start_knot.position) &&
+    (knot->velocity == profile->start_knot.velocity);
 }
 
 void epos_interpolated_position_destroy(epos_interpolated_position_t*
     profile) {
   if (profile->num_knots) {
     free(profile->knots);
+    free(profile->segments.times);
     
     profile->knots = 0;
+    memset(&profile->segments, 0, sizeof(profile->segments));
     profile->num_knots = 0;
   }
 }
 
+int epos_interpolated_position_set_submode(epos_device_t* dev, short
+    submode) {
+  epos_device_write(dev, EPOS_INTERPOLATED_POSITION_INDEX_SUBMODE, 0,
+    (unsigned char*)&submode, sizeof(short));
+  
+  return dev->error.code;
+}
+
+unsigned short epos_interpolated_position_get_buffer_status(epos_device_t*
+    dev) {
+  unsigned short status = 0;
+  epos_device_read(dev, EPOS_INTERPOLATED_POSITION_INDEX_BUFFER,
+    EPOS_INTERPOLATED_POSITION_SUBINDEX_STATUS, (unsigned char*)&status,
+    sizeof(unsigned short));
+  
+  return status;
+}
+
+unsigned int epos_interpolated_position_get_buffer_free(epos_device_t* dev) {
+  unsigned int size = 0;
+  epos_device_read(dev, EPOS_INTERPOLATED_POSITION_INDEX_CONFIGURATION,
+    EPOS_INTERPOLATED_POSITION_SUBINDEX_ACTUAL_BUFFER_SIZE,
+    (unsigned char*)&size, sizeof(unsigned int));
+  
+  return size;
+}
+
+int epos_interpolated_position_clear_buffer(epos_device_t* dev) {
+  unsigned char clear = 0;
+  unsigned char enable = 1;
+  
+  if (epos_device_write(dev, EPOS_INTERPOLATED_POSITION_INDEX_CONFIGURATION,
+      EPOS_INTERPOLATED_POSITION_SUBINDEX_BUFFER_CLEAR, &clear,
+      sizeof(clear)) > 0)
+    epos_device_write(dev, EPOS_INTERPOLATED_POSITION_INDEX_CONFIGURATION,
+      EPOS_INTERPOLATED_POSITION_SUBINDEX_BUFFER_CLEAR, &enable,
+      sizeof(enable));
+  
+  return dev->error.code;
+}
+
 int epos_interpolated_position_start(epos_node_t* node,
     epos_interpolated_position_t* profile) {
-  return EPOS_DEVICE_ERROR_NONE;
+  epos_interpolated_position_init_stream(profile);
+  
+  error_clear(&node->dev.error);
+  if (profile->num_knots && !epos_interpolated_position_is_prepared(profile) &&
+      epos_interpolated_position_prepare(profile)) {
+    error_setf(&node->dev.error, EPOS_DEVICE_ERROR_INTERNAL,
+      "[Node 0x%hX]: %s", node->dev.node_id,
+      epos_interpolated_position_errors[
+        EPOS_INTERPOLATED_POSITION_ERROR_PREPARE]);
+    return node->dev.error.code;
+  }
+  
+  if (!epos_control_set_mode(&node->control,
+        epos_control_interpolated_pos) &&
+      !epos_interpolated_position_set_submode(&node->dev,
+        EPOS_INTERPOLATED_POSITION_SUBMODE_PVT) &&
+      !epos_interpolated_position_clear_buffer(&node->dev) &&
+      !epos_control_start(&node->control) &&
+      !epos_interpolated_position_update(node, profile))
+    epos_device_set_control(&node->dev,
+      EPOS_INTERPOLATED_POSITION_CONTROL_START);
+  
+  return node->dev.error.code;
+}
+
+int epos_interpolated_position_update(epos_node_t* node,
+    epos_interpolated_position_t* profile) {
+  unsigned short status;
+  unsigned int num_free;
+  
+  status = epos_interpolated_position_get_buffer_status(&node->dev);
+  error_return(&node->dev.error);
+  
+  if (status & EPOS_INTERPOLATED_POSITION_BUFFER_OVERFLOW_ERROR)
+    error_setf(&node->dev.error, EPOS_DEVICE_ERROR_INTERNAL,
+      "[Node 0x%hX]: %s", node->dev.node_id,
+      epos_interpolated_position_errors[
+        EPOS_INTERPOLATED_POSITION_ERROR_OVERFLOW]);
+  else if (!profile->stream_terminated &&
+      (status & EPOS_INTERPOLATED_POSITION_BUFFER_UNDERFLOW_ERROR))
+    error_setf(&node->dev.error, EPOS_DEVICE_ERROR_INTERNAL,
+      "[Node 0x%hX]: %s", node->dev.node_id,
+      epos_interpolated_position_errors[
+        EPOS_INTERPOLATED_POSITION_ERROR_UNDERFLOW]);
+  else if (!profile->stream_terminated) {
+    num_free = epos_interpolated_position_get_buffer_free(&node->dev);
+    
+    while (num_free && !profile->stream_terminated &&
+        !epos_interpolated_position_stream(node, profile))
+      --num_free;
+  }
+  
+  return node->dev.error.code;
+}
+
+int epos_interpolated_position_wait(epos_node_t* node,
+    epos_interpolated_position_t* profile, double timeout) {
+  double start_time = epos_clock_get(), time;
+  
+  error_clear(&node->dev.error);
+  
+  while (!profile->stream_terminated) {
+    if (epos_interpolated_position_update(node, profile))
+      return node->dev.error.code;
+    
+    time = epos_clock_get();
+    if ((timeout >= 0.0) && (time-start_time > timeout)) {
+      error_set(&node->dev.error, EPOS_DEVICE_ERROR_WAIT_TIMEOUT);
+      return node->dev.error.code;
+    }
+    
+    if (!profile->stream_terminated)
+      epos_clock_sleep(node->dev.poll_period);
+  }
+  
+  if (timeout >= 0.0)
+    timeout = max(0.0, timeout-(epos_clock_get()-start_time));
+  
+  return epos_device_wait_status(&node->dev,
+    EPOS_INTERPOLATED_POSITION_STATUS_REACHED, timeout);
 }
 
 int epos_interpolated_position_stop(epos_node_t* node) {
@@ -124,11 +339,11 @@ ssize_t epos_interpolated_position_find_segment_bisect(const
     size_t j = (index_max <= profile->num_knots) ? index_max : 
       profile->num_knots;
       
-    if ((j > i) && (time >= i ? profile->knots[i-1].time :
-        profile->start_knot.time) && (time <= profile->knots[j-1].time)) {    
+    if ((j > i) && (time >= (i ? profile->knots[i-1].time :
+        profile->start_knot.time)) && (time <= profile->knots[j-1].time)) {    
       while (j-i > 1) {
         size_t k = (i+j) >> 1;
-        if (time < k ? profile->knots[k-1].time : profile->start_knot.time)
+        if (time < (k ? profile->knots[k-1].time : profile->start_knot.time))
           j = k;
         else
           i = k;
@@ -145,11 +360,12 @@ ssize_t epos_interpolated_position_find_segment_linear(const
     epos_interpolated_position_t* profile, double time, size_t index_start) {
   if (profile->num_knots && (time >= profile->start_knot.time) &&
       (time <= profile->knots[profile->num_knots-1].time)) {
-    size_t i = (index_start <= profile->num_knots) ? index_start : 
-      profile->num_knots;
+    size_t i = (index_start < profile->num_knots) ? index_start : 
+      profile->num_knots-1;
       
     while (1) {
-      if (time >= i ? profile->knots[i-1].time : profile->start_knot.time) {
+      if (time >= (i ? profile->knots[i-1].time :
+          profile->start_knot.time)) {
         if (time <= profile->knots[i].time)
           return i;
         else
@@ -167,28 +383,21 @@ epos_profile_value_t epos_interpolated_position_eval_segment(const
     epos_interpolated_position_t* profile, size_t index, double time) {
   epos_profile_value_t values = {NAN, NAN, NAN};
   
-  if (index <= profile->num_knots) {
-    double t_j = index ? profile->knots[index-1].time :
-      profile->start_knot.time;
-    double t_i = profile->knots[index].time;
-    
-    if ((time >= t_j) && (time <= t_i)) {
-      float p_j = (index > 0) ? profile->knots[index-1].position :
-        profile->start_knot.position;
-      float v_j = (index > 0) ? profile->knots[index-1].velocity :
-        profile->start_knot.velocity;
-      float p_i = profile->knots[index].position;
-      float v_i = profile->knots[index].velocity;
-      
-      double a = (-2.0*(p_i-p_j)+(t_i-t_j)*(v_i+v_j))/cub(t_i-t_j);
-      double b = (3.0*(p_i-p_j)-(t_i-t_j)*(v_i+2.0*v_j))/sqr(t_i-t_j);
-      double c = v_j;
-      double d = p_j;
-      double t = time-t_j;
+  if ((index < profile->num_knots) &&
+      epos_interpolated_position_is_prepared(profile)) {
+    const epos_interpolated_position_segments_t* segments =
+      &profile->segments;
+    
+    if ((time >= segments->times[index]) &&
+        (time <= segments->times[index+1])) {
+      double t = time-segments->times[index];
       
-      values.position = a*cub(t)+b*sqr(t)+c*t+d;
-      values.velocity = 3.0*a*sqr(t)+2.0*b*t+c;
-      values.acceleration = 6.0*a*t+2.0*b;
+      values.position = ((segments->a[index]*t+segments->b[index])*t+
+        segments->c[index])*t+segments->d[index];
+      values.velocity = (3.0*segments->a[index]*t+2.0*segments->b[index])*
+        t+segments->c[index];
+      values.acceleration = 6.0*segments->a[index]*t+
+        2.0*segments->b[index];
     }
   }
   
@@ -229,3 +438,218 @@ epos_profile_value_t epos_interpolated_position_eval_linear(const
     return values;
   }
 }
+
+void epos_interpolated_position_eval_batch(const
+    epos_interpolated_position_t* profile, const double* times, float*
+    positions, float* velocities, float* accelerations, size_t num_times) {
+  const double* knot_times = profile->segments.times;
+  double t[EPOS_INTERPOLATED_POSITION_BATCH_SIZE];
+  size_t indexes[EPOS_INTERPOLATED_POSITION_BATCH_SIZE];
+  int defined[EPOS_INTERPOLATED_POSITION_BATCH_SIZE];
+  float p[EPOS_INTERPOLATED_POSITION_BATCH_SIZE];
+  float v[EPOS_INTERPOLATED_POSITION_BATCH_SIZE];
+  float a[EPOS_INTERPOLATED_POSITION_BATCH_SIZE];
+  size_t i, j, num_batch, num_defined, index = 0;
+  int prepared = epos_interpolated_position_is_prepared(profile);
+  
+  for (i = 0; i < num_times; i += EPOS_INTERPOLATED_POSITION_BATCH_SIZE) {
+    num_batch = min(num_times-i, EPOS_INTERPOLATED_POSITION_BATCH_SIZE);
+    num_defined = 0;
+    
+    for (j = 0; j < EPOS_INTERPOLATED_POSITION_BATCH_SIZE; ++j) {
+      ssize_t segment = -EPOS_INTERPOLATED_POSITION_ERROR_UNDEFINED;
+      
+      t[j] = (j < num_batch) ? times[i+j] : t[0];
+      if ((j < num_batch) && prepared) {
+        if ((t[j] >= knot_times[index]) && (t[j] < knot_times[index+1]))
+          segment = index;
+        else
+          segment = epos_interpolated_position_search(profile, t[j], index);
+      }
+      
+      if ((defined[j] = (segment >= 0))) {
+        index = segment;
+        ++num_defined;
+      }
+      indexes[j] = index;
+    }
+    
+    if (num_defined == EPOS_INTERPOLATED_POSITION_BATCH_SIZE)
+      epos_interpolated_position_eval_polynomials(&profile->segments, t,
+        indexes, positions ? &positions[i] : p, velocities ?
+        &velocities[i] : v, accelerations ? &accelerations[i] : a);
+    else {
+      if (num_defined)
+        epos_interpolated_position_eval_polynomials(&profile->segments, t,
+          indexes, p, v, a);
+      
+      for (j = 0; j < num_batch; ++j) {
+        if (positions)
+          positions[i+j] = defined[j] ? p[j] : NAN;
+        if (velocities)
+          velocities[i+j] = defined[j] ? v[j] : NAN;
+        if (accelerations)
+          accelerations[i+j] = defined[j] ? a[j] : NAN;
+      }
+    }
+  }
+}
+
+int epos_interpolated_position_stream(epos_node_t* node,
+    epos_interpolated_position_t* profile) {
+  const epos_interpolated_position_knot_t* knot = profile->stream_index ?
+    &profile->knots[profile->stream_index-1] : &profile->start_knot;
+  epos_profile_value_t values = {knot->position, knot->velocity, 0.0};
+  double time, duration;
+  
+  if (profile->stream_time != knot->time) {
+    values = epos_interpolated_position_eval_segment(profile,
+      profile->stream_index, profile->stream_time);
+    
+    if (isnan(values.position)) {
+      error_setf(&node->dev.error, EPOS_DEVICE_ERROR_INTERNAL,
+        "[Node 0x%hX]: %s", node->dev.node_id,
+        epos_interpolated_position_errors[
+          EPOS_INTERPOLATED_POSITION_ERROR_UNDEFINED]);
+      return node->dev.error.code;
+    }
+  }
+  
+  if (profile->stream_index < profile->num_knots) {
+    knot = &profile->knots[profile->stream_index];
+    time = min(knot->time, (round(profile->stream_time*1e3)+
+      round(EPOS_INTERPOLATED_POSITION_MAX_RECORD_TIME*1e3))*1e-3);
+    duration = round(time*1e3)-round(profile->stream_time*1e3);
+    
+    if (!epos_interpolated_position_send(node, values.position,
+        values.velocity, max(duration, 1.0)*1e-3)) {
+      profile->stream_time = time;
+      if (time == knot->time)
+        ++profile->stream_index;
+    }
+  }
+  else if (!epos_interpolated_position_send(node, values.position,
+      values.velocity, 0.0))
+    profile->stream_terminated = 1;
+  
+  return node->dev.error.code;
+}
+
+int epos_interpolated_position_send(epos_node_t* node, float position,
+    float velocity, double time) {
+  unsigned char data[EPOS_INTERPOLATED_POSITION_RECORD_SIZE];
+  int pos = epos_gear_from_angle(&node->gear, position);
+  int vel = clip(epos_gear_from_angular_velocity(&node->gear, velocity),
+    -0x800000, 0x7FFFFF);
+  unsigned char t = clip(round(time*1e3), 0, 0xFF);
+  const epos_pdo_t* pdo = epos_pdo_image_find(&node->pdo, epos_pdo_receive,
+    EPOS_INTERPOLATED_POSITION_INDEX_DATA, 0);
+  
+  data[0] = pos;
+  data[1] = pos >> 8;
+  data[2] = pos >> 16;
+  data[3] = pos >> 24;
+  data[4] = vel;
+  data[5] = vel >> 8;
+  data[6] = vel >> 16;
+  data[7] = t;
+  
+  if (pdo && pdo->cob_id) {
+    epos_pdo_image_set(&node->pdo, EPOS_INTERPOLATED_POSITION_INDEX_DATA, 0,
+      data, sizeof(data));
+    epos_pdo_send(&node->dev, (epos_pdo_t*)pdo);
+  }
+  else
+    epos_device_write(&node->dev, EPOS_INTERPOLATED_POSITION_INDEX_DATA, 0,
+      data, sizeof(data));
+  
+  return node->dev.error.code;
+}
+
+ssize_t epos_interpolated_position_search(const epos_interpolated_position_t*
+    profile, double time, size_t index) {
+  const double* times = profile->segments.times;
+  size_t i = 0, j = profile->num_knots, k;
+  
+  if (!epos_interpolated_position_is_prepared(profile) ||
+      !((time >= times[0]) && (time <= times[j])))
+    return -EPOS_INTERPOLATED_POSITION_ERROR_UNDEFINED;
+  
+  for (k = index; (k < j) && (k <= index+1); ++k)
+    if ((time >= times[k]) && ((time < times[k+1]) || (k+1 == j)))
+      return k;
+  
+  while (j-i > 1) {
+    k = (i+j) >> 1;
+    if (time < times[k])
+      j = k;
+    else
+      i = k;
+  }
+  
+  return i;
+}
+
+void epos_interpolated_position_eval_polynomials(const
+    epos_interpolated_position_segments_t* segments, const double* times,
+    const size_t* indexes, float* positions, float* velocities, float*
+    accelerations) {
+#if defined(__AVX__)
+  __m256d t_j = _mm256_set_pd(segments->times[indexes[3]],
+    segments->times[indexes[2]], segments->times[indexes[1]],
+    segments->times[indexes[0]]);
+  __m256d a = _mm256_set_pd(segments->a[indexes[3]], segments->a[indexes[2]],
+    segments->a[indexes[1]], segments->a[indexes[0]]);
+  __m256d b = _mm256_set_pd(segments->b[indexes[3]], segments->b[indexes[2]],
+    segments->b[indexes[1]], segments->b[indexes[0]]);
+  __m256d c = _mm256_set_pd(segments->c[indexes[3]], segments->c[indexes[2]],
+    segments->c[indexes[1]], segments->c[indexes[0]]);
+  __m256d d = _mm256_set_pd(segments->d[indexes[3]], segments->d[indexes[2]],
+    segments->d[indexes[1]], segments->d[indexes[0]]);
+  __m256d t = _mm256_sub_pd(_mm256_loadu_pd(times), t_j);
+  __m256d a_3 = _mm256_mul_pd(_mm256_set1_pd(3.0), a);
+  __m256d b_2 = _mm256_add_pd(b, b);
+  
+  _mm_storeu_ps(positions, _mm256_cvtpd_ps(_mm256_add_pd(_mm256_mul_pd(
+    _mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(a, t), b), t),
+    c), t), d)));
+  _mm_storeu_ps(velocities, _mm256_cvtpd_ps(_mm256_add_pd(_mm256_mul_pd(
+    _mm256_add_pd(_mm256_mul_pd(a_3, t), b_2), t), c)));
+  _mm_storeu_ps(accelerations, _mm256_cvtpd_ps(_mm256_add_pd(_mm256_mul_pd(
+    _mm256_add_pd(a_3, a_3), t), b_2)));
+#elif defined(__SSE2__)
+  size_t i;
+  
+  for (i = 0; i < EPOS_INTERPOLATED_POSITION_BATCH_SIZE; i += 2) {
+    __m128d t_j = _mm_set_pd(segments->times[indexes[i+1]],
+      segments->times[indexes[i]]);
+    __m128d a = _mm_set_pd(segments->a[indexes[i+1]], segments->a[indexes[i]]);
+    __m128d b = _mm_set_pd(segments->b[indexes[i+1]], segments->b[indexes[i]]);
+    __m128d c = _mm_set_pd(segments->c[indexes[i+1]], segments->c[indexes[i]]);
+    __m128d d = _mm_set_pd(segments->d[indexes[i+1]], segments->d[indexes[i]]);
+    __m128d t = _mm_sub_pd(_mm_loadu_pd(&times[i]), t_j);
+    __m128d a_3 = _mm_mul_pd(_mm_set1_pd(3.0), a);
+    __m128d b_2 = _mm_add_pd(b, b);
+    
+    _mm_storel_pi((__m64*)&positions[i], _mm_cvtpd_ps(_mm_add_pd(_mm_mul_pd(
+      _mm_add_pd(_mm_mul_pd(_mm_add_pd(_mm_mul_pd(a, t), b), t), c), t), d)));
+    _mm_storel_pi((__m64*)&velocities[i], _mm_cvtpd_ps(_mm_add_pd(
+      _mm_mul_pd(_mm_add_pd(_mm_mul_pd(a_3, t), b_2), t), c)));
+    _mm_storel_pi((__m64*)&accelerations[i], _mm_cvtpd_ps(_mm_add_pd(
+      _mm_mul_pd(_mm_add_pd(a_3, a_3), t), b_2)));
+  }
+#else
+  size_t i;
+  
+  for (i = 0; i < EPOS_INTERPOLATED_POSITION_BATCH_SIZE; ++i) {
+    size_t k = indexes[i];
+    double t = times[i]-segments->times[k];
+    
+    positions[i] = ((segments->a[k]*t+segments->b[k])*t+segments->c[k])*t+
+      segments->d[k];
+    velocities[i] = (3.0*segments->a[k]*t+2.0*segments->b[k])*t+
+      segments->c[k];
+    accelerations[i] = 6.0*segments->a[k]*t+2.0*segments->b[k];
+  }
+#endif
+}
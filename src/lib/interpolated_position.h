@@ -34,7 +34,28 @@
   * for equal second derivatives at the spline knots. Instead, each knot
   * defines a target position and target velocity, and the spline segments
   * can be evaluated based on their two adjacent knots.
+  * 
+  * On the EPOS node, the knots are streamed as PVT reference points into
+  * the interpolation buffer, starting with the start knot. Each reference
+  * point carries the duration of the segment towards the next point, and
+  * the final point with a zero duration terminates the motion. Durations
+  * are derived from the knot times rounded to milliseconds, such that the
+  * rounding errors do not accumulate along the profile. The buffer is
+  * refilled ahead of the motion, such that arbitrarily long profiles can
+  * be executed continuously.
+  * Reference points are sent via RPDO if the data record is mapped into
+  * a configured RPDO of the node's process image, and via SDO otherwise.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS interpolated position constants
   */
+//@{
+#define EPOS_INTERPOLATED_POSITION_MAX_RECORD_TIME           0.255
+#define EPOS_INTERPOLATED_POSITION_RECORD_SIZE               8
+#define EPOS_INTERPOLATED_POSITION_ALIGNMENT                 32
+#define EPOS_INTERPOLATED_POSITION_BATCH_SIZE                4
+//@}
 
 /** \name Error Codes
   * \brief Predefined EPOS interpolated position error codes
@@ -44,6 +65,12 @@
 //!< Success
 #define EPOS_INTERPOLATED_POSITION_ERROR_UNDEFINED             1
 //!< Profile undefined at value
+#define EPOS_INTERPOLATED_POSITION_ERROR_UNDERFLOW             2
+//!< Interpolation buffer underflow
+#define EPOS_INTERPOLATED_POSITION_ERROR_OVERFLOW              3
+//!< Interpolation buffer overflow
+#define EPOS_INTERPOLATED_POSITION_ERROR_PREPARE               4
+//!< Failed to prepare profile segments
 //@}
 
 /** \brief Predefined EPOS interpolated position error descriptions
@@ -55,6 +82,31 @@ extern const char* epos_interpolated_position_errors[];
   */
 //@{
 #define EPOS_INTERPOLATED_POSITION_INDEX_DATA         0x20C1
+#define EPOS_INTERPOLATED_POSITION_INDEX_BUFFER       0x20C4
+#define EPOS_INTERPOLATED_POSITION_SUBINDEX_STATUS    0x01
+#define EPOS_INTERPOLATED_POSITION_INDEX_SUBMODE      0x60C0
+#define EPOS_INTERPOLATED_POSITION_INDEX_CONFIGURATION  0x60C4
+#define EPOS_INTERPOLATED_POSITION_SUBINDEX_MAX_BUFFER_SIZE     0x01
+#define EPOS_INTERPOLATED_POSITION_SUBINDEX_ACTUAL_BUFFER_SIZE  0x02
+#define EPOS_INTERPOLATED_POSITION_SUBINDEX_BUFFER_CLEAR        0x06
+//@}
+
+/** \name Submodes
+  * \brief Predefined EPOS interpolated position submodes
+  */
+//@{
+#define EPOS_INTERPOLATED_POSITION_SUBMODE_PVT        -1
+//@}
+
+/** \name Buffer Status
+  * \brief Predefined EPOS interpolated position buffer status bits
+  */
+//@{
+#define EPOS_INTERPOLATED_POSITION_BUFFER_UNDERFLOW_WARNING  0x0001
+#define EPOS_INTERPOLATED_POSITION_BUFFER_OVERFLOW_WARNING   0x0002
+#define EPOS_INTERPOLATED_POSITION_BUFFER_UNDERFLOW_ERROR    0x0100
+#define EPOS_INTERPOLATED_POSITION_BUFFER_OVERFLOW_ERROR     0x0200
+#define EPOS_INTERPOLATED_POSITION_BUFFER_ENABLED            0x8000
 //@}
 
 /** \name Control Words
@@ -62,6 +114,15 @@ extern const char* epos_interpolated_position_errors[];
   */
 //@{
 #define EPOS_INTERPOLATED_POSITION_CONTROL_SET        0x007F
+#define EPOS_INTERPOLATED_POSITION_CONTROL_START      0x001F
+//@}
+
+/** \name Status Words
+  * \brief Predefined EPOS interpolated position status words
+  */
+//@{
+#define EPOS_INTERPOLATED_POSITION_STATUS_REACHED     0x0400
+#define EPOS_INTERPOLATED_POSITION_STATUS_ACTIVE      0x1000
 //@}
 
 /** \brief Structure defining a knot of an EPOS interpolated position
@@ -77,6 +138,26 @@ typedef struct epos_interpolated_position_knot_t {
   float velocity;            //!< The target velocity of the knot in [rad/s].
 } epos_interpolated_position_knot_t;
 
+/** \brief Structure defining the prepared segments of an EPOS interpolated
+  *   position profile
+  * 
+  * The segments are stored as a structure of arrays, each aligned to
+  * EPOS_INTERPOLATED_POSITION_ALIGNMENT bytes. The segment with index i
+  * spans the time interval [times[i], times[i+1]] and interpolates the
+  * position by a cubic polynomial with coefficients a[i], b[i], c[i], and
+  * d[i] in the time elapsed since times[i]. A copy of the start knot the
+  * segments have been prepared for allows to detect stale segments.
+  */
+typedef struct epos_interpolated_position_segments_t {
+  epos_interpolated_position_knot_t
+    start_knot;              //!< The start knot of the prepared segments.
+  double* times;             //!< The knot times of the segments in [s].
+  double* a;                 //!< The cubic coefficients in [rad/s^3].
+  double* b;                 //!< The quadratic coefficients in [rad/s^2].
+  double* c;                 //!< The linear coefficients in [rad/s].
+  double* d;                 //!< The constant coefficients in [rad].
+} epos_interpolated_position_segments_t;
+
 /** \brief Structure defining an EPOS interpolated position control operation
   */
 typedef struct epos_interpolated_position_t {
@@ -86,6 +167,13 @@ typedef struct epos_interpolated_position_t {
   
   epos_interpolated_position_knot_t
     start_knot;              //!< The start knot of the profile.
+  
+  epos_interpolated_position_segments_t
+    segments;                //!< The prepared segments of the profile.
+  
+  size_t stream_index;       //!< The index of the segment being streamed.
+  double stream_time;        //!< The time of the next point to stream in [s].
+  int stream_terminated;     //!< The terminating point has been streamed.
 } epos_interpolated_position_t;
 
 /** \brief Initialize EPOS interpolated position control operation
@@ -111,6 +199,34 @@ void epos_interpolated_position_init_spline(
   epos_interpolated_position_t* profile,
   const spline_t* spline);
 
+/** \brief Prepare EPOS interpolated position control operation
+  * \param[in] profile The EPOS interpolated position control operation to be
+  *   prepared.
+  * \return The resulting error code.
+  * 
+  * Preparing the profile computes the polynomial coefficients of all its
+  * segments, such that evaluating the profile amounts to a polynomial
+  * evaluation. The profile is prepared upon initialization, but needs to
+  * be prepared again whenever its start knot or knots are modified. A
+  * profile whose start knot has been modified since its preparation is
+  * considered unprepared and evaluates to NaN, while
+  * epos_interpolated_position_start() prepares it again. If the segments
+  * cannot be allocated, EPOS_INTERPOLATED_POSITION_ERROR_PREPARE is
+  * returned and the profile remains unprepared.
+  */
+int epos_interpolated_position_prepare(
+  epos_interpolated_position_t* profile);
+
+/** \brief Check if an EPOS interpolated position control operation is
+  *   prepared
+  * \param[in] profile The EPOS interpolated position control operation to be
+  *   checked.
+  * \return One if the segments of the profile have been prepared for its
+  *   current start knot, zero otherwise.
+  */
+int epos_interpolated_position_is_prepared(
+  const epos_interpolated_position_t* profile);
+
 /** \brief Destroy EPOS interpolated position control operation
   * \param[in] profile The EPOS interpolated position control operation to be
   *   destroyed.
@@ -118,17 +234,98 @@ void epos_interpolated_position_init_spline(
 void epos_interpolated_position_destroy(
   epos_interpolated_position_t* profile);
 
+/** \brief Set EPOS interpolated position submode
+  * \param[in] dev The EPOS device to set the interpolated position
+  *   submode for.
+  * \param[in] submode The interpolated position submode to be set.
+  * \return The resulting device error code.
+  */
+int epos_interpolated_position_set_submode(
+  epos_device_t* dev,
+  short submode);
+
+/** \brief Retrieve EPOS interpolation buffer status
+  * \param[in] dev The EPOS device to retrieve the buffer status for.
+  * \return The status of the interpolation buffer of the specified EPOS
+  *   device. On error, the return value will be zero and the error code
+  *   set in dev->error.
+  */
+unsigned short epos_interpolated_position_get_buffer_status(
+  epos_device_t* dev);
+
+/** \brief Retrieve the free size of an EPOS interpolation buffer
+  * \param[in] dev The EPOS device to retrieve the free buffer size for.
+  * \return The number of reference points which can be appended to the
+  *   interpolation buffer of the specified EPOS device. On error, the
+  *   return value will be zero and the error code set in dev->error.
+  */
+unsigned int epos_interpolated_position_get_buffer_free(
+  epos_device_t* dev);
+
+/** \brief Clear EPOS interpolation buffer
+  * \param[in] dev The EPOS device to clear the interpolation buffer for.
+  * \return The resulting device error code.
+  * 
+  * Clearing the buffer discards all reference points and resets the
+  * buffer errors. The buffer is enabled again afterwards.
+  */
+int epos_interpolated_position_clear_buffer(
+  epos_device_t* dev);
+
 /** \brief Start EPOS interpolated position control operation
   * \param[in] node The EPOS node to start the interpolated position control
   *   operation for.
   * \param[in] profile The EPOS interpolated position control operation to be
   *   started.
   * \return The resulting device error code.
+  * 
+  * The interpolation buffer of the node will be cleared and filled with
+  * the initial reference points of the profile before the motion starts.
+  * The start knot of the profile is expected to coincide with the actual
+  * position of the node. Subsequent calls to
+  * epos_interpolated_position_update() are required in order to stream
+  * the remaining reference points.
   */
 int epos_interpolated_position_start(
   epos_node_t* node,
   epos_interpolated_position_t* profile);
 
+/** \brief Update EPOS interpolated position control operation
+  * \param[in] node The EPOS node to update the interpolated position control
+  *   operation for.
+  * \param[in] profile The started EPOS interpolated position control
+  *   operation to be updated.
+  * \return The resulting device error code.
+  * 
+  * This function monitors the interpolation buffer of the node and refills
+  * it with as many reference points as the buffer can hold. Profile
+  * segments exceeding the maximum duration of a reference point are
+  * subdivided by evaluating the profile. The last knot is sent as the
+  * terminating reference point with a zero duration. An underflow or
+  * overflow of the buffer is reported as internal device error.
+  */
+int epos_interpolated_position_update(
+  epos_node_t* node,
+  epos_interpolated_position_t* profile);
+
+/** \brief Wait for completion of an EPOS interpolated position control
+  *   operation
+  * \param[in] node The EPOS node to wait for.
+  * \param[in] profile The started EPOS interpolated position control
+  *   operation to wait for.
+  * \param[in] timeout The timeout of the wait operation in [s].
+  *   A negative value will be interpreted as an eternal wait.
+  * \return The resulting device error code.
+  * 
+  * This function keeps updating the control operation at the polling
+  * period of the device until the profile has been streamed entirely, and
+  * then waits for the node to reach the target.
+  */
+int epos_interpolated_position_wait(
+  epos_node_t* node,
+  epos_interpolated_position_t* profile,
+  double timeout);
+
 /** \brief Stop EPOS interpolated position control operation
   * \param[in] node The EPOS node to stop the interpolated position control
   *   operation for.
@@ -278,4 +475,33 @@ epos_profile_value_t epos_interpolated_position_eval_linear(
   double time,
   size_t* index);
 
+/** \brief Evaluate the values of an EPOS interpolated position profile
+  *   at an array of times
+  * \param[in] profile The EPOS interpolated position profile to evaluate
+  *   the values for.
+  * \param[in] times The array of times to evaluate the profile values at
+  *   in [s].
+  * \param[out] positions The array receiving the evaluated positions in
+  *   [rad], or null.
+  * \param[out] velocities The array receiving the evaluated velocities in
+  *   [rad/s], or null.
+  * \param[out] accelerations The array receiving the evaluated accelerations
+  *   in [rad/s^2], or null.
+  * \param[in] num_times The number of times to evaluate the profile at.
+  * 
+  * This function is intended for the evaluation of large numbers of
+  * profile values. The segments are searched incrementally from one time
+  * to the next and by bisection otherwise, and the segment polynomials
+  * are evaluated for several times at once using AVX or SSE2 instructions
+  * if available. Where the profile is not defined, the evaluated values
+  * will be NaN.
+  */
+void epos_interpolated_position_eval_batch(
+  const epos_interpolated_position_t* profile,
+  const double* times,
+  float* positions,
+  float* velocities,
+  float* accelerations,
+  size_t num_times);
+
 #endif
@@ -0,0 +1,335 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pdo.h"
+#include "bus.h"
+
+#include "macros.h"
+
+const char* epos_pdo_errors[] = {
+  "Success",
+  "Invalid PDO mapping",
+  "PDO not configured",
+};
+
+size_t epos_pdo_get_mapping_size(const epos_pdo_t* pdo, short index,
+  unsigned char subindex);
+size_t epos_pdo_image_get_num_transferred(const epos_pdo_image_t* image);
+
+void epos_pdo_init(epos_pdo_t* pdo, epos_pdo_type_t type, int number,
+    unsigned char transmission_type, unsigned short inhibit_time) {
+  pdo->type = type;
+  pdo->number = number;
+  pdo->cob_id = 0;
+  
+  pdo->transmission_type = transmission_type;
+  pdo->inhibit_time = inhibit_time;
+  
+  pdo->num_mappings = 0;
+  
+  memset(pdo->data, 0, sizeof(pdo->data));
+  pdo->length = 0;
+  
+  pdo->num_transferred = 0;
+  pdo->sync_counter = 0;
+}
+
+ssize_t epos_pdo_add_mapping(epos_pdo_t* pdo, short index, unsigned char
+    subindex, size_t size) {
+  ssize_t offset = pdo->length;
+  
+  if (!size || (pdo->num_mappings >= EPOS_PDO_MAX_MAPPINGS) ||
+      (pdo->length+size > EPOS_PDO_MAX_LENGTH))
+    return -EPOS_PDO_ERROR_MAPPING;
+  
+  pdo->mappings[pdo->num_mappings].index = index;
+  pdo->mappings[pdo->num_mappings].subindex = subindex;
+  pdo->mappings[pdo->num_mappings].size = size;
+  
+  ++pdo->num_mappings;
+  pdo->length += size;
+  
+  return offset;
+}
+
+ssize_t epos_pdo_find_mapping(const epos_pdo_t* pdo, short index, unsigned
+    char subindex) {
+  size_t i, offset = 0;
+  
+  for (i = 0; i < pdo->num_mappings; ++i) {
+    if ((pdo->mappings[i].index == index) &&
+        (pdo->mappings[i].subindex == subindex))
+      return offset;
+    offset += pdo->mappings[i].size;
+  }
+  
+  return -EPOS_PDO_ERROR_MAPPING;
+}
+
+size_t epos_pdo_get_mapping_size(const epos_pdo_t* pdo, short index,
+    unsigned char subindex) {
+  size_t i;
+  
+  for (i = 0; i < pdo->num_mappings; ++i)
+    if ((pdo->mappings[i].index == index) &&
+        (pdo->mappings[i].subindex == subindex))
+      return pdo->mappings[i].size;
+  
+  return 0;
+}
+
+int epos_pdo_setup(epos_device_t* dev, epos_pdo_t* pdo) {
+  short parameters = (pdo->type == epos_pdo_transmit) ?
+    EPOS_PDO_INDEX_TRANSMIT_PARAMETERS+pdo->number :
+    EPOS_PDO_INDEX_RECEIVE_PARAMETERS+pdo->number;
+  short mapping = (pdo->type == epos_pdo_transmit) ?
+    EPOS_PDO_INDEX_TRANSMIT_MAPPING+pdo->number :
+    EPOS_PDO_INDEX_RECEIVE_MAPPING+pdo->number;
+  int cob_id = ((pdo->type == epos_pdo_transmit) ? EPOS_PDO_COB_ID_TRANSMIT :
+    EPOS_PDO_COB_ID_RECEIVE)+pdo->number*EPOS_PDO_COB_ID_OFFSET+dev->node_id;
+  unsigned int cob_id_invalid = cob_id | EPOS_PDO_COB_ID_INVALID;
+  unsigned char num_mappings = 0;
+  int i;
+  
+  pdo->cob_id = 0;
+  if (epos_device_write(dev, parameters, EPOS_PDO_SUBINDEX_COB_ID,
+      (unsigned char*)&cob_id_invalid, sizeof(int)) < 0)
+    return dev->error.code;
+  if (!pdo->num_mappings)
+    return dev->error.code;
+  
+  if (epos_device_write(dev, parameters, EPOS_PDO_SUBINDEX_TRANSMISSION_TYPE,
+      &pdo->transmission_type, 1) < 0)
+    return dev->error.code;
+  if ((pdo->type == epos_pdo_transmit) && (epos_device_write(dev,
+      parameters, EPOS_PDO_SUBINDEX_INHIBIT_TIME,
+      (unsigned char*)&pdo->inhibit_time, sizeof(short)) < 0))
+    return dev->error.code;
+  
+  if (epos_device_write(dev, mapping, EPOS_PDO_SUBINDEX_NUM_MAPPINGS,
+      &num_mappings, 1) < 0)
+    return dev->error.code;
+  for (i = 0; i < pdo->num_mappings; ++i) {
+    unsigned int entry = ((unsigned short)pdo->mappings[i].index << 16) |
+      (pdo->mappings[i].subindex << 8) | (pdo->mappings[i].size*8);
+    
+    if (epos_device_write(dev, mapping, i+1, (unsigned char*)&entry,
+        sizeof(int)) < 0)
+      return dev->error.code;
+  }
+  num_mappings = pdo->num_mappings;
+  if (epos_device_write(dev, mapping, EPOS_PDO_SUBINDEX_NUM_MAPPINGS,
+      &num_mappings, 1) < 0)
+    return dev->error.code;
+  
+  if (epos_device_write(dev, parameters, EPOS_PDO_SUBINDEX_COB_ID,
+      (unsigned char*)&cob_id, sizeof(int)) > 0)
+    pdo->cob_id = cob_id;
+
+  return dev->error.code;
+}
+
+int epos_pdo_send(epos_device_t* dev, epos_pdo_t* pdo) {
+  can_message_t message;
+  memset(&message, 0, sizeof(can_message_t));
+  
+  if (!pdo->cob_id) {
+    error_setf(&dev->error, EPOS_DEVICE_ERROR_SEND, "%s (RPDO %d)",
+      epos_pdo_errors[EPOS_PDO_ERROR_CONFIGURATION], pdo->number+1);
+    return dev->error.code;
+  }
+  
+  message.id = pdo->cob_id;
+  memcpy(message.content, pdo->data, pdo->length);
+  message.length = pdo->length;
+  
+  if (!epos_device_send_message(dev, &message))
+    ++pdo->num_transferred;
+  
+  return dev->error.code;
+}
+
+void epos_pdo_image_init(epos_pdo_image_t* image, epos_device_t* dev) {
+  int i;
+  
+  image->dev = dev;
+  
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i) {
+    epos_pdo_init(&image->receive[i], epos_pdo_receive, i,
+      EPOS_PDO_TRANSMISSION_ASYNCHRONOUS, 0);
+    epos_pdo_init(&image->transmit[i], epos_pdo_transmit, i,
+      EPOS_PDO_TRANSMISSION_ASYNCHRONOUS, 0);
+  }
+  
+  dev->pdo_image = image;
+}
+
+void epos_pdo_image_destroy(epos_pdo_image_t* image) {
+  if (image->dev && (image->dev->pdo_image == image))
+    image->dev->pdo_image = 0;
+  
+  image->dev = 0;
+}
+
+int epos_pdo_image_setup(epos_pdo_image_t* image) {
+  int i;
+  
+  if (epos_device_enter_preoperational(image->dev))
+    return image->dev->error.code;
+  
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i) {
+    if (epos_pdo_setup(image->dev, &image->receive[i]) ||
+        epos_pdo_setup(image->dev, &image->transmit[i]))
+      return image->dev->error.code;
+  }
+  
+  return epos_device_start_node(image->dev);
+}
+
+int epos_pdo_image_is_mapped(const epos_pdo_image_t* image) {
+  int i;
+  
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i)
+    if (image->receive[i].num_mappings || image->transmit[i].num_mappings)
+      return 1;
+  
+  return 0;
+}
+
+const epos_pdo_t* epos_pdo_image_find(const epos_pdo_image_t* image,
+    epos_pdo_type_t type, short index, unsigned char subindex) {
+  const epos_pdo_t* pdos = (type == epos_pdo_transmit) ? image->transmit :
+    image->receive;
+  int i;
+  
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i)
+    if (epos_pdo_find_mapping(&pdos[i], index, subindex) >= 0)
+      return &pdos[i];
+  
+  return 0;
+}
+
+int epos_pdo_image_receive_message(epos_pdo_image_t* image, const
+    can_message_t* message, unsigned int sync_counter) {
+  int i;
+  
+  if ((message->id < EPOS_PDO_COB_ID_MIN) ||
+      (message->id > EPOS_PDO_COB_ID_MAX))
+    return 0;
+  
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i) {
+    epos_pdo_t* pdo = &image->transmit[i];
+    
+    if (pdo->cob_id && (pdo->cob_id == message->id)) {
+      memcpy(pdo->data, message->content, min(message->length,
+        EPOS_PDO_MAX_LENGTH));
+      ++pdo->num_transferred;
+      pdo->sync_counter = sync_counter;
+      
+      return 1;
+    }
+  }
+  
+  return 0;
+}
+
+int epos_pdo_image_receive(epos_pdo_image_t* image) {
+  size_t num_transferred = epos_pdo_image_get_num_transferred(image);
+  
+  error_clear(&image->dev->error);
+  
+  if (!image->dev->bus) {
+    error_set(&image->dev->error, EPOS_DEVICE_ERROR_RECEIVE);
+    return image->dev->error.code;
+  }
+  while (!epos_bus_dispatch(image->dev->bus))
+    if (epos_pdo_image_get_num_transferred(image) != num_transferred)
+      return image->dev->error.code;
+  
+  error_blame(&image->dev->error, &image->dev->bus->error,
+    EPOS_DEVICE_ERROR_RECEIVE);
+  return image->dev->error.code;
+}
+
+int epos_pdo_image_send(epos_pdo_image_t* image) {
+  int i;
+  
+  error_clear(&image->dev->error);
+  
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i)
+    if (image->receive[i].cob_id &&
+        epos_pdo_send(image->dev, &image->receive[i]))
+      break;
+  
+  return image->dev->error.code;
+}
+
+size_t epos_pdo_image_get(const epos_pdo_image_t* image, short index,
+    unsigned char subindex, unsigned char* data, size_t num) {
+  int i;
+  
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i) {
+    const epos_pdo_t* pdo = &image->transmit[i];
+    ssize_t offset;
+    
+    if (pdo->num_transferred && ((offset = epos_pdo_find_mapping(pdo,
+        index, subindex)) >= 0)) {
+      num = min(num, epos_pdo_get_mapping_size(pdo, index, subindex));
+      memcpy(data, &pdo->data[offset], num);
+      
+      return num;
+    }
+  }
+  
+  return 0;
+}
+
+size_t epos_pdo_image_set(epos_pdo_image_t* image, short index, unsigned
+    char subindex, const unsigned char* data, size_t num) {
+  int i;
+  
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i) {
+    epos_pdo_t* pdo = &image->receive[i];
+    ssize_t offset;
+    
+    if ((offset = epos_pdo_find_mapping(pdo, index, subindex)) >= 0) {
+      num = min(num, epos_pdo_get_mapping_size(pdo, index, subindex));
+      memcpy(&pdo->data[offset], data, num);
+      
+      return num;
+    }
+  }
+  
+  return 0;
+}
+
+size_t epos_pdo_image_get_num_transferred(const epos_pdo_image_t* image) {
+  size_t num_transferred = 0;
+  int i;
+  
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i)
+    num_transferred += image->transmit[i].num_transferred;
+  
+  return num_transferred;
+}
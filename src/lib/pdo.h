@@ -0,0 +1,322 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#ifndef EPOS_PDO_H
+#define EPOS_PDO_H
+
+#include "device.h"
+
+/** \file pdo.h
+  * \brief EPOS process data object functions
+  * 
+  * Process data objects (PDOs) provide the unconfirmed, low-overhead
+  * exchange of up to 8 bytes of mapped object dictionary entries per CAN
+  * frame. Transmit PDOs (TPDOs) are sent by the EPOS node and decoded into
+  * the process image of the host, whereas receive PDOs (RPDOs) are composed
+  * from the host's process image and sent to the EPOS node.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS PDO constants
+  */
+//@{
+#define EPOS_PDO_MAX_NUM                          4
+#define EPOS_PDO_MAX_MAPPINGS                     8
+#define EPOS_PDO_MAX_LENGTH                       8
+//@}
+
+/** \name Object Indexes
+  * \brief Predefined EPOS PDO object indexes
+  */
+//@{
+#define EPOS_PDO_INDEX_RECEIVE_PARAMETERS         0x1400
+#define EPOS_PDO_INDEX_RECEIVE_MAPPING            0x1600
+#define EPOS_PDO_INDEX_TRANSMIT_PARAMETERS        0x1800
+#define EPOS_PDO_INDEX_TRANSMIT_MAPPING           0x1A00
+#define EPOS_PDO_SUBINDEX_NUM_MAPPINGS            0x00
+#define EPOS_PDO_SUBINDEX_COB_ID                  0x01
+#define EPOS_PDO_SUBINDEX_TRANSMISSION_TYPE       0x02
+#define EPOS_PDO_SUBINDEX_INHIBIT_TIME            0x03
+//@}
+
+/** \name COB Identifiers
+  * \brief Predefined EPOS PDO COB identifiers
+  */
+//@{
+#define EPOS_PDO_COB_ID_TRANSMIT                  0x180
+#define EPOS_PDO_COB_ID_RECEIVE                   0x200
+#define EPOS_PDO_COB_ID_OFFSET                    0x100
+#define EPOS_PDO_COB_ID_MIN                       0x180
+#define EPOS_PDO_COB_ID_MAX                       0x57F
+#define EPOS_PDO_COB_ID_INVALID                   0x80000000
+//@}
+
+/** \name Transmission Types
+  * \brief Predefined EPOS PDO transmission types
+  */
+//@{
+#define EPOS_PDO_TRANSMISSION_SYNCHRONOUS         0x01
+#define EPOS_PDO_TRANSMISSION_SYNCHRONOUS_MAX     0xF0
+#define EPOS_PDO_TRANSMISSION_ASYNCHRONOUS        0xFF
+//@}
+
+/** \name Error Codes
+  * \brief Predefined EPOS PDO error codes
+  */
+//@{
+#define EPOS_PDO_ERROR_NONE                       0
+//!< Success
+#define EPOS_PDO_ERROR_MAPPING                    1
+//!< Invalid PDO mapping
+#define EPOS_PDO_ERROR_CONFIGURATION              2
+//!< PDO not configured
+//@}
+
+/** \brief Predefined EPOS PDO error descriptions
+  */
+extern const char* epos_pdo_errors[];
+
+/** \brief EPOS PDO types
+  */
+typedef enum {
+  epos_pdo_receive,                //!< Receive PDO, sent by the host.
+  epos_pdo_transmit                //!< Transmit PDO, sent by the EPOS node.
+} epos_pdo_type_t;
+
+/** \brief Structure defining an EPOS PDO object mapping
+  */
+typedef struct epos_pdo_mapping_t {
+  short index;                     //!< The index of the mapped object.
+  unsigned char subindex;          //!< The subindex of the mapped object.
+  size_t size;                     //!< The size of the mapped object in [B].
+} epos_pdo_mapping_t;
+
+/** \brief Structure defining an EPOS PDO
+  */
+typedef struct epos_pdo_t {
+  epos_pdo_type_t type;            //!< The type of the PDO.
+  int number;                      //!< The zero-based number of the PDO.
+  int cob_id;                      //!< The COB identifier of the PDO.
+
+  unsigned char transmission_type; //!< The transmission type of the PDO.
+  unsigned short inhibit_time;     //!< The inhibit time of the PDO in [100us].
+
+  epos_pdo_mapping_t
+    mappings[EPOS_PDO_MAX_MAPPINGS]; //!< The object mappings of the PDO.
+  size_t num_mappings;             //!< The number of object mappings.
+
+  unsigned char data[EPOS_PDO_MAX_LENGTH]; //!< The process data of the PDO.
+  size_t length;                   //!< The length of the process data in [B].
+
+  size_t num_transferred;          //!< The number of PDO transfers.
+  unsigned int sync_counter;       //!< The SYNC counter of the last transfer.
+} epos_pdo_t;
+
+/** \brief Structure defining the EPOS process image
+  * 
+  * The process image holds the receive and transmit PDOs of an EPOS
+  * node. Mapped objects are served from the process data of the most
+  * recently received TPDOs, thus avoiding confirmed SDO transfers.
+  */
+typedef struct epos_pdo_image_t {
+  epos_device_t* dev;              //!< The EPOS device of the process image.
+
+  epos_pdo_t receive[EPOS_PDO_MAX_NUM];  //!< The receive PDOs of the image.
+  epos_pdo_t transmit[EPOS_PDO_MAX_NUM]; //!< The transmit PDOs of the image.
+} epos_pdo_image_t;
+
+/** \brief Initialize EPOS PDO
+  * \param[in] pdo The EPOS PDO to be initialized.
+  * \param[in] type The type of the EPOS PDO to be initialized.
+  * \param[in] number The zero-based number of the EPOS PDO to be
+  *   initialized.
+  * \param[in] transmission_type The transmission type of the EPOS PDO.
+  * \param[in] inhibit_time The inhibit time of the EPOS PDO in [100us].
+  *   Inhibit times only apply to transmit PDOs.
+  */
+void epos_pdo_init(
+  epos_pdo_t* pdo,
+  epos_pdo_type_t type,
+  int number,
+  unsigned char transmission_type,
+  unsigned short inhibit_time);
+
+/** \brief Add an object mapping to an EPOS PDO
+  * \param[in] pdo The EPOS PDO to add the object mapping to.
+  * \param[in] index The index of the object to be mapped.
+  * \param[in] subindex The subindex of the object to be mapped.
+  * \param[in] size The size of the object to be mapped in [B].
+  * \return The byte offset of the mapped object within the process data
+  *   of the PDO or the negative error code.
+  */
+ssize_t epos_pdo_add_mapping(
+  epos_pdo_t* pdo,
+  short index,
+  unsigned char subindex,
+  size_t size);
+
+/** \brief Find an object mapping of an EPOS PDO
+  * \param[in] pdo The EPOS PDO to be searched for the object mapping.
+  * \param[in] index The index of the mapped object.
+  * \param[in] subindex The subindex of the mapped object.
+  * \return The byte offset of the mapped object within the process data
+  *   of the PDO or the negative error code if the object is not mapped.
+  */
+ssize_t epos_pdo_find_mapping(
+  const epos_pdo_t* pdo,
+  short index,
+  unsigned char subindex);
+
+/** \brief Set up an EPOS PDO on an EPOS device
+  * \param[in] dev The EPOS device to set up the PDO on.
+  * \param[in] pdo The EPOS PDO to be set up. PDOs without any object
+  *   mappings will be disabled on the device.
+  * \return The resulting device error code.
+  * 
+  * The communication parameters and object mappings of a PDO may only be
+  * changed while the EPOS node is in pre-operational NMT state.
+  */
+int epos_pdo_setup(
+  epos_device_t* dev,
+  epos_pdo_t* pdo);
+
+/** \brief Send an EPOS receive PDO
+  * \param[in] dev The EPOS device to send the PDO to.
+  * \param[in] pdo The EPOS receive PDO to be sent.
+  * \return The resulting device error code.
+  * 
+  * The PDO must have been set up successfully by epos_pdo_setup(). A PDO
+  * without a valid COB identifier is never sent, since its message would
+  * otherwise be interpreted as NMT command by all nodes on the bus.
+  */
+int epos_pdo_send(
+  epos_device_t* dev,
+  epos_pdo_t* pdo);
+
+/** \brief Initialize EPOS process image
+  * \param[in] image The EPOS process image to be initialized.
+  * \param[in] dev The EPOS device of the process image.
+  */
+void epos_pdo_image_init(
+  epos_pdo_image_t* image,
+  epos_device_t* dev);
+
+/** \brief Destroy EPOS process image
+  * \param[in] image The EPOS process image to be destroyed.
+  */
+void epos_pdo_image_destroy(
+  epos_pdo_image_t* image);
+
+/** \brief Set up all PDOs of an EPOS process image
+  * \param[in] image The EPOS process image to set up the PDOs for.
+  * \return The resulting device error code.
+  * 
+  * This function temporarily puts the EPOS node into pre-operational NMT
+  * state and then starts it, such that TPDOs will be transmitted.
+  */
+int epos_pdo_image_setup(
+  epos_pdo_image_t* image);
+
+/** \brief Test if an EPOS process image contains mapped PDOs
+  * \param[in] image The EPOS process image to be tested.
+  * \return Non-zero if any PDO of the process image has object mappings.
+  */
+int epos_pdo_image_is_mapped(
+  const epos_pdo_image_t* image);
+
+/** \brief Find the EPOS PDO mapping an object in a process image
+  * \param[in] image The EPOS process image to search.
+  * \param[in] type The type of the PDO to be found.
+  * \param[in] index The index of the mapped object.
+  * \param[in] subindex The subindex of the mapped object.
+  * \return The PDO of the process image which maps the specified object,
+  *   or null if the object is not mapped by any PDO of this type.
+  */
+const epos_pdo_t* epos_pdo_image_find(
+  const epos_pdo_image_t* image,
+  epos_pdo_type_t type,
+  short index,
+  unsigned char subindex);
+
+/** \brief Decode a CAN message into an EPOS process image
+  * \param[in] image The EPOS process image to decode the message into.
+  * \param[in] message The CAN message to be decoded.
+  * \param[in] sync_counter The SYNC counter of the bus at the time the
+  *   message was received, which will be assigned to the decoded TPDO.
+  * \return Non-zero if the message represents a TPDO of the process
+  *   image, zero otherwise.
+  */
+int epos_pdo_image_receive_message(
+  epos_pdo_image_t* image,
+  const can_message_t* message,
+  unsigned int sync_counter);
+
+/** \brief Receive the next TPDO of an EPOS process image
+  * \param[in] image The EPOS process image to receive the TPDO for.
+  * \return The resulting device error code.
+  */
+int epos_pdo_image_receive(
+  epos_pdo_image_t* image);
+
+/** \brief Send all receive PDOs of an EPOS process image
+  * \param[in] image The EPOS process image to send the receive PDOs for.
+  * \return The resulting device error code.
+  */
+int epos_pdo_image_send(
+  epos_pdo_image_t* image);
+
+/** \brief Retrieve a mapped object from an EPOS process image
+  * \param[in] image The EPOS process image to retrieve the object from.
+  * \param[in] index The index of the mapped object.
+  * \param[in] subindex The subindex of the mapped object.
+  * \param[out] data The array the object data shall be stored to.
+  * \param[in] num The size of the object data to be retrieved.
+  * \return The number of object bytes retrieved. The return value will be
+  *   zero if the object is not mapped into any TPDO of the process image
+  *   or if no such TPDO has been received yet.
+  */
+size_t epos_pdo_image_get(
+  const epos_pdo_image_t* image,
+  short index,
+  unsigned char subindex,
+  unsigned char* data,
+  size_t num);
+
+/** \brief Set a mapped object in an EPOS process image
+  * \param[in] image The EPOS process image to set the object in.
+  * \param[in] index The index of the mapped object.
+  * \param[in] subindex The subindex of the mapped object.
+  * \param[in] data The array representing the object data to be set.
+  * \param[in] num The size of the object data to be set.
+  * \return The number of object bytes set. The return value will be zero
+  *   if the object is not mapped into any RPDO of the process image.
+  * 
+  * The object data will be transferred to the EPOS node on the next call
+  * to epos_pdo_image_send().
+  */
+size_t epos_pdo_image_set(
+  epos_pdo_image_t* image,
+  short index,
+  unsigned char subindex,
+  const unsigned char* data,
+  size_t num);
+
+#endif
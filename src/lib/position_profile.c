@@ -77,94 +77,107 @@ int epos_position_profile_stop(epos_node_t* node) {
   return epos_control_stop(&node->control);
 }
 
-epos_profile_value_t epos_position_profile_eval(const epos_position_profile_t*
-    profile, double time) {
-  epos_profile_value_t values;
-  
-  float s_0 = profile->start_value;
-  float s_1 = (profile->relative) ? s_0+profile->target_value :
+void epos_position_profile_prepare(const epos_position_profile_t* profile,
+    epos_profile_prepared_t* prepared) {
+  double s_0 = profile->start_value;
+  double s_1 = (profile->relative) ? s_0+profile->target_value :
     profile->target_value;
-  double t = time-profile->start_time;
+  double s = s_1-s_0;
+  double v = copysign(fabs(profile->velocity), s);
+  double a = copysign(fabs(profile->acceleration), s);
+  double d = copysign(fabs(profile->deceleration), s);
+  double v_c, t_a, t_c, t_d, s_a, s_c, s_d;
+  epos_profile_phase_t* phase;
   
-  if (t > 0.0) {
-    float s = s_1-s_0;
-    float v = copysignf(fabs(profile->velocity), s);
-    float a = copysignf(fabs(profile->acceleration), s);
-    float d = copysignf(fabs(profile->deceleration), s);
+  if (profile->type == epos_profile_sinusoidal) {
+    v_c = copysign(min(fabs(v), sqrt(4.0*fabs(s)/(M_PI/fabs(a)+
+      M_PI/fabs(d)))), s);
     
+    t_a = 0.5*M_PI*v_c/a;
+    t_d = 0.5*M_PI*v_c/d;
+    s_a = 0.25*sqr(v_c)*M_PI/a;
+    s_d = 0.25*sqr(v_c)*M_PI/d;
+  }
+  else {
+    v_c = copysign(min(fabs(v), sqrt(2.0*fabs(s)/(1.0/fabs(a)+
+      1.0/fabs(d)))), s);
+    
+    t_a = v_c/a;
+    t_d = v_c/d;
+    s_a = 0.5*sqr(v_c)/a;
+    s_d = 0.5*sqr(v_c)/d;
+  }
+  t_c = (fabs(s) > fabs(s_a+s_d)) ? (s-s_a-s_d)/v_c : 0.0;
+  s_c = v_c*t_c;
+  
+  epos_profile_prepared_init(prepared);
+  phase = epos_profile_prepared_add_phase(prepared, profile->start_time);
+  phase->position[0] = s_0;
+  
+  if (v_c != 0.0) {
+    phase = epos_profile_prepared_add_phase(prepared, profile->start_time);
+    phase->position[0] = s_0;
     if (profile->type == epos_profile_sinusoidal) {
-      float v_c = sqrt(4.0*fabs(s)/(M_PI/fabs(a)+M_PI/fabs(d)));
-      v_c = copysignf(min(fabs(v), v_c), s);
-      
-      double t_a = 0.5*M_PI*v_c/a;
-      double t_d = 0.5*M_PI*v_c/d;
-      float s_a = 0.25*sqr(v_c)*M_PI/a;
-      float s_d = 0.25*sqr(v_c)*M_PI/d;
-      double t_c = (fabs(s) > fabs(s_a-s_d)) ? (s-s_a-s_d)/v_c : 0.0;
-      float s_c = v_c*t_c;
-
-      if (t <= t_a) {
-        values.position = s_0+0.5*v_c*(t-0.5*v_c/a*sin(2.0*a/v_c*t));
-        values.velocity = 0.5*v_c*(1.0-cos(2.0*a/v_c*t));
-        values.acceleration = a*sin(2.0*a/v_c*t);
-      }
-      else if (t <= t_a+t_c) {
-        values.position = s_0+s_a+v_c*(t-t_a);
-        values.velocity = v_c;
-        values.acceleration = 0.0;
-      }
-      else if (t <= t_a+t_c+t_d) {
-        values.position = s_0+s_a+s_c+0.5*v_c*(t-t_a-t_c+0.5*v_c/d*
-          sin(2.0*d/v_c*(t-t_a-t_c)));
-        values.velocity = 0.5*v_c*(1.0+cos(2.0*d/v_c*(t-t_a-t_c)));
-        values.acceleration = -d*sin(2.0*a/v_c*(t-t_a-t_c));
-      }
-      else {
-        values.position = s_0+s;
-        values.velocity = 0.0;
-        values.acceleration = 0.0;
-      }
+      phase->frequency = 2.0*a/v_c;
+      phase->position[1] = 0.5*v_c;
+      phase->position[3] = -0.25*sqr(v_c)/a;
+      phase->velocity[0] = 0.5*v_c;
+      phase->velocity[3] = -0.5*v_c;
+      phase->acceleration[3] = a;
     }
     else {
-      float v_c = sqrt(2.0*fabs(s)/(1.0/fabs(a)+1.0/fabs(d)));
-      v_c = copysignf(min(fabs(v), v_c), s);
-
-      double t_a = v_c/a;
-      double t_d = v_c/d;
-      float s_a = 0.5*sqr(v_c)/a;
-      float s_d = 0.5*sqr(v_c)/d;
-      double t_c = (fabs(s) > fabs(s_a+s_d)) ? (s-s_a-s_d)/v_c : 0.0;
-      float s_c = v_c*t_c;
-
-      if (t <= t_a) {
-        values.position = s_0+0.5*a*sqr(t);
-        values.velocity = a*t;
-        values.acceleration = a;
-      }
-      else if (t <= t_a+t_c) {
-        values.position = s_0+s_a+v_c*(t-t_a);
-        values.velocity = v_c;
-        values.acceleration = 0.0;
-      }
-      else if (t <= t_a+t_c+t_d) {
-        values.position = s_0+s_a+s_c+v_c*(t-t_a-t_c)-0.5*d*sqr(t-t_a-t_c);
-        values.velocity = v_c-d*(t-t_a-t_c);
-        values.acceleration = -d;
-      }
-      else {
-        values.position = s_0+s;
-        values.velocity = 0.0;
-        values.acceleration = 0.0;
-      }
+      phase->position[2] = 0.5*a;
+      phase->velocity[1] = a;
+      phase->acceleration[0] = a;
     }
+    
+    phase = epos_profile_prepared_add_phase(prepared,
+      profile->start_time+t_a);
+    phase->position[0] = s_0+s_a;
+    phase->position[1] = v_c;
+    phase->velocity[0] = v_c;
+    
+    phase = epos_profile_prepared_add_phase(prepared,
+      profile->start_time+t_a+t_c);
+    phase->position[0] = s_0+s_a+s_c;
+    if (profile->type == epos_profile_sinusoidal) {
+      phase->frequency = 2.0*d/v_c;
+      phase->position[1] = 0.5*v_c;
+      phase->position[3] = 0.25*sqr(v_c)/d;
+      phase->velocity[0] = 0.5*v_c;
+      phase->velocity[3] = 0.5*v_c;
+      phase->acceleration[3] = -d;
+    }
+    else {
+      phase->position[1] = v_c;
+      phase->position[2] = -0.5*d;
+      phase->velocity[0] = v_c;
+      phase->velocity[1] = -d;
+      phase->acceleration[0] = -d;
+    }
+    
+    phase = epos_profile_prepared_add_phase(prepared,
+      profile->start_time+t_a+t_c+t_d);
+    phase->position[0] = s_1;
   }
-  else {
-    values.position = s_0;
-    values.velocity = 0.0;
-    values.acceleration = 0.0;
-  }
+}
 
-  return values;
+epos_profile_value_t epos_position_profile_eval(const epos_position_profile_t*
+    profile, double time) {
+  epos_profile_prepared_t prepared;
+  
+  epos_position_profile_prepare(profile, &prepared);
+  return epos_profile_prepared_eval(&prepared, time);
+}
+
+void epos_position_profile_eval_batch(const epos_position_profile_t*
+    profile, const double* times, float* positions, float* velocities,
+    float* accelerations, size_t num_times) {
+  epos_profile_prepared_t prepared;
+  
+  epos_position_profile_prepare(profile, &prepared);
+  epos_profile_prepared_eval_batch(&prepared, times, positions, velocities,
+    accelerations, num_times);
 }
 
 int epos_position_profile_set_target(epos_device_t* dev, int position) {
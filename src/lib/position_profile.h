@@ -98,6 +98,20 @@ int epos_position_profile_start(
 int epos_position_profile_stop(
   epos_node_t* node);
 
+/** \brief Prepare EPOS position profile for evaluation
+  * \param[in] profile The EPOS position profile control operation to be
+  *   prepared.
+  * \param[out] prepared The prepared EPOS motion profile holding the
+  *   acceleration, constant velocity, and deceleration phases of the
+  *   position profile.
+  * 
+  * The profile needs to be prepared again whenever its start position or
+  * start time change, i.e., after epos_position_profile_start().
+  */
+void epos_position_profile_prepare(
+  const epos_position_profile_t* profile,
+  epos_profile_prepared_t* prepared);
+
 /** \brief Evaluate the absolute values of an EPOS position profile
   * \param[in] profile The EPOS position profile control operation to
   *   evaluate the absolute values for.
@@ -106,12 +120,38 @@ int epos_position_profile_stop(
   * \return The evaluated absolute profile values.
   * 
   * This function is intended to facilitate the computational generation of
-  * motion trajectories.
+  * motion trajectories. For evaluating a profile repeatedly, preparing it
+  * by epos_position_profile_prepare() is considerably more efficient.
   */
 epos_profile_value_t epos_position_profile_eval(
   const epos_position_profile_t* profile,
   double time);
 
+/** \brief Evaluate the absolute values of an EPOS position profile at an
+  *   array of times
+  * \param[in] profile The EPOS position profile control operation to
+  *   evaluate the absolute values for.
+  * \param[in] times The array of absolute times to evaluate the absolute
+  *   profile values at in [s].
+  * \param[out] positions The array receiving the evaluated positions in
+  *   [rad], or null.
+  * \param[out] velocities The array receiving the evaluated velocities in
+  *   [rad/s], or null.
+  * \param[out] accelerations The array receiving the evaluated accelerations
+  *   in [rad/s^2], or null.
+  * \param[in] num_times The number of times to evaluate the profile at.
+  * 
+  * This is a convenience function which prepares the profile and
+  * evaluates it by means of epos_profile_prepared_eval_batch().
+  */
+void epos_position_profile_eval_batch(
+  const epos_position_profile_t* profile,
+  const double* times,
+  float* positions,
+  float* velocities,
+  float* accelerations,
+  size_t num_times);
+
 /** \brief Set the position profile target position of an EPOS device
   * \param[in] dev The EPOS device to set the target position for.
   * \param[in] position The target position for the specified EPOS
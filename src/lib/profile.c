@@ -19,14 +19,146 @@
  ***************************************************************************/
 
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 
 #include "profile.h"
 
+#include "macros.h"
+
+typedef double epos_profile_vector_t __attribute__((vector_size(
+  EPOS_PROFILE_BATCH_SIZE*sizeof(double))));
+
+#define epos_profile_vector_broadcast(value) \
+  ((epos_profile_vector_t){value, value, value, value})
+
+const epos_profile_phase_t* epos_profile_prepared_find(const
+  epos_profile_prepared_t* prepared, double time);
+
 int epos_profile_wait(epos_node_t* node, double timeout) {
   return epos_device_wait_status(&node->dev, EPOS_PROFILE_STATUS_REACHED,
     timeout);
 }
 
+void epos_profile_prepared_init(epos_profile_prepared_t* prepared) {
+  prepared->num_phases = 0;
+}
+
+epos_profile_phase_t* epos_profile_prepared_add_phase(epos_profile_prepared_t*
+    prepared, double start_time) {
+  epos_profile_phase_t* phase = 0;
+  
+  if (prepared->num_phases < EPOS_PROFILE_MAX_PHASES) {
+    phase = &prepared->phases[prepared->num_phases];
+    memset(phase, 0, sizeof(epos_profile_phase_t));
+    phase->start_time = start_time;
+    
+    ++prepared->num_phases;
+  }
+  
+  return phase;
+}
+
+epos_profile_value_t epos_profile_prepared_eval(const epos_profile_prepared_t*
+    prepared, double time) {
+  epos_profile_value_t values = {0.0, 0.0, 0.0};
+  const epos_profile_phase_t* phase = epos_profile_prepared_find(prepared,
+    time);
+  
+  if (phase) {
+    double t = time-phase->start_time;
+    double sin_wt = 0.0, cos_wt = 0.0;
+    
+    if (phase->frequency != 0.0) {
+      sin_wt = sin(phase->frequency*t);
+      cos_wt = cos(phase->frequency*t);
+    }
+    
+    values.position = phase->position[0]+(phase->position[1]+
+      phase->position[2]*t)*t+phase->position[3]*sin_wt;
+    values.velocity = phase->velocity[0]+(phase->velocity[1]+
+      phase->velocity[2]*t)*t+phase->velocity[3]*cos_wt;
+    values.acceleration = phase->acceleration[0]+(phase->acceleration[1]+
+      phase->acceleration[2]*t)*t+phase->acceleration[3]*sin_wt;
+  }
+  
+  return values;
+}
+
+void epos_profile_prepared_eval_batch(const epos_profile_prepared_t*
+    prepared, const double* times, float* positions, float* velocities,
+    float* accelerations, size_t num_times) {
+  epos_profile_vector_t t, w, x, z, sin_wt, cos_wt;
+  epos_profile_vector_t p[4], v[4], a[4];
+  epos_profile_vector_t position, velocity, acceleration;
+  const epos_profile_phase_t* phases[EPOS_PROFILE_BATCH_SIZE];
+  int uniform, harmonic = 0;
+  size_t i, j, k, num_batch;
+  
+  if (!prepared->num_phases)
+    return;
+  
+  for (k = 0; k < prepared->num_phases; ++k)
+    harmonic |= (prepared->phases[k].frequency != 0.0);
+  
+  for (i = 0; i < num_times; i += EPOS_PROFILE_BATCH_SIZE) {
+    num_batch = min(num_times-i, EPOS_PROFILE_BATCH_SIZE);
+    uniform = 1;
+    
+    for (j = 0; j < EPOS_PROFILE_BATCH_SIZE; ++j) {
+      t[j] = (j < num_batch) ? times[i+j] : times[i];
+      phases[j] = epos_profile_prepared_find(prepared, t[j]);
+      uniform &= (phases[j] == phases[0]);
+    }
+    
+    if (uniform) {
+      const epos_profile_phase_t* phase = phases[0];
+      
+      t -= phase->start_time;
+      w = epos_profile_vector_broadcast(phase->frequency);
+      for (k = 0; k < 4; ++k) {
+        p[k] = epos_profile_vector_broadcast(phase->position[k]);
+        v[k] = epos_profile_vector_broadcast(phase->velocity[k]);
+        a[k] = epos_profile_vector_broadcast(phase->acceleration[k]);
+      }
+    }
+    else for (j = 0; j < EPOS_PROFILE_BATCH_SIZE; ++j) {
+      t[j] -= phases[j]->start_time;
+      w[j] = phases[j]->frequency;
+      for (k = 0; k < 4; ++k) {
+        p[k][j] = phases[j]->position[k];
+        v[k][j] = phases[j]->velocity[k];
+        a[k][j] = phases[j]->acceleration[k];
+      }
+    }
+    
+    if (harmonic) {
+      x = w*t-M_PI_2;
+      z = x*x;
+      
+      cos_wt = -x*(1.0+z*(-1.0/6.0+z*(1.0/120.0+z*(-1.0/5040.0+
+        z*(1.0/362880.0+z*(-1.0/39916800.0+z*(1.0/6227020800.0)))))));
+      sin_wt = 1.0+z*(-1.0/2.0+z*(1.0/24.0+z*(-1.0/720.0+z*(1.0/40320.0+
+        z*(-1.0/3628800.0+z*(1.0/479001600.0+z*(-1.0/87178291200.0)))))));
+    }
+    else
+      sin_wt = cos_wt = epos_profile_vector_broadcast(0.0);
+    
+    position = p[0]+(p[1]+p[2]*t)*t+p[3]*sin_wt;
+    velocity = v[0]+(v[1]+v[2]*t)*t+v[3]*cos_wt;
+    acceleration = a[0]+(a[1]+a[2]*t)*t+a[3]*sin_wt;
+    
+    for (j = 0; j < num_batch; ++j) {
+      if (positions)
+        positions[i+j] = position[j];
+      if (velocities)
+        velocities[i+j] = velocity[j];
+      if (accelerations)
+        accelerations[i+j] = acceleration[j];
+    }
+  }
+}
+
 int epos_profile_set_acceleration(epos_device_t* dev, unsigned int
     acceleration) {
   epos_device_write(dev, EPOS_PROFILE_INDEX_ACCELERATION, 0,
@@ -73,3 +205,15 @@ int epos_profile_set_type(epos_device_t* dev, epos_profile_type_t type) {
   
   return dev->error.code;
 }
+
+const epos_profile_phase_t* epos_profile_prepared_find(const
+    epos_profile_prepared_t* prepared, double time) {
+  size_t i = prepared->num_phases;
+  
+  if (!i)
+    return 0;
+  
+  while ((--i > 0) && !(time > prepared->phases[i].start_time));
+  
+  return &prepared->phases[i];
+}
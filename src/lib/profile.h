@@ -46,6 +46,14 @@
 #define EPOS_PROFILE_STATUS_REACHED           0x0400
 //@}
 
+/** \name Constants
+  * \brief Predefined EPOS profile constants
+  */
+//@{
+#define EPOS_PROFILE_MAX_PHASES               5
+#define EPOS_PROFILE_BATCH_SIZE               4
+//@}
+
 /** \brief EPOS motion profile types
   */
 typedef enum {
@@ -61,6 +69,38 @@ typedef struct epos_profile_value_t {
   float acceleration;             //!< The profile acceleration in [rad/s^2].
 } epos_profile_value_t;
 
+/** \brief Structure defining a phase of a prepared EPOS motion profile
+  * 
+  * Within a phase, each profile value x is evaluated from the coefficients
+  * c of the phase as x = c[0]+c[1]*t+c[2]*t^2+c[3]*h(w*t), where t denotes
+  * the time elapsed since the start of the phase and w the angular
+  * frequency of the phase. The harmonic function h is the sine for the
+  * position and acceleration, and the cosine for the velocity.
+  */
+typedef struct epos_profile_phase_t {
+  double start_time;              //!< The start time of the phase in [s].
+  double frequency;               //!< The angular frequency in [rad/s].
+  
+  double position[4];             //!< The position coefficients.
+  double velocity[4];             //!< The velocity coefficients.
+  double acceleration[4];         //!< The acceleration coefficients.
+} epos_profile_phase_t;
+
+/** \brief Structure defining a prepared EPOS motion profile
+  * 
+  * A prepared profile holds the phases of a motion profile, such that
+  * evaluating the profile requires neither the phase boundaries nor the
+  * coefficients to be recomputed. The first phase applies until the start
+  * time of the second phase, and each subsequent phase from its start
+  * time until the start time of the next phase. The last phase applies
+  * indefinitely.
+  */
+typedef struct epos_profile_prepared_t {
+  epos_profile_phase_t
+    phases[EPOS_PROFILE_MAX_PHASES]; //!< The phases of the profile.
+  size_t num_phases;              //!< The number of phases of the profile.
+} epos_profile_prepared_t;
+
 /** \brief Wait for completion of an EPOS motion profile
   * \param[in] node The EPOS node to complete the motion profile.
   * \param[in] timeout The timeout of the wait operation in [s].
@@ -70,6 +110,61 @@ int epos_profile_wait(
   epos_node_t* node,
   double timeout);
 
+/** \brief Initialize prepared EPOS motion profile
+  * \param[in] prepared The prepared EPOS motion profile to be initialized.
+  */
+void epos_profile_prepared_init(
+  epos_profile_prepared_t* prepared);
+
+/** \brief Add a phase to a prepared EPOS motion profile
+  * \param[in] prepared The prepared EPOS motion profile to add the phase to.
+  * \param[in] start_time The start time of the phase in [s], which must
+  *   not precede the start time of the previous phase.
+  * \return The added phase with all its coefficients set to zero, or null
+  *   if the profile already contains EPOS_PROFILE_MAX_PHASES phases.
+  */
+epos_profile_phase_t* epos_profile_prepared_add_phase(
+  epos_profile_prepared_t* prepared,
+  double start_time);
+
+/** \brief Evaluate the values of a prepared EPOS motion profile
+  * \param[in] prepared The prepared EPOS motion profile to evaluate the
+  *   values for.
+  * \param[in] time The absolute time to evaluate the profile values at
+  *   in [s].
+  * \return The evaluated profile values.
+  */
+epos_profile_value_t epos_profile_prepared_eval(
+  const epos_profile_prepared_t* prepared,
+  double time);
+
+/** \brief Evaluate the values of a prepared EPOS motion profile at an
+  *   array of times
+  * \param[in] prepared The prepared EPOS motion profile to evaluate the
+  *   values for.
+  * \param[in] times The array of absolute times to evaluate the profile
+  *   values at in [s].
+  * \param[out] positions The array receiving the evaluated positions in
+  *   [rad], or null.
+  * \param[out] velocities The array receiving the evaluated velocities in
+  *   [rad/s], or null.
+  * \param[out] accelerations The array receiving the evaluated accelerations
+  *   in [rad/s^2], or null.
+  * \param[in] num_times The number of times to evaluate the profile at.
+  * 
+  * The profile is evaluated for EPOS_PROFILE_BATCH_SIZE times at once
+  * using vector arithmetic. Harmonic terms are evaluated by a polynomial
+  * approximation which is accurate to single precision for arguments in
+  * the range [0, pi] covered by the phases of the EPOS motion profiles.
+  */
+void epos_profile_prepared_eval_batch(
+  const epos_profile_prepared_t* prepared,
+  const double* times,
+  float* positions,
+  float* velocities,
+  float* accelerations,
+  size_t num_times);
+
 /** \brief Set the profile acceleration of an EPOS device
   * \param[in] dev The EPOS device to set the profile acceleration for.
   * \param[in] acceleration The profile acceleration for the specified
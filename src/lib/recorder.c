@@ -0,0 +1,193 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "recorder.h"
+#include "clock.h"
+
+const char* epos_recorder_errors[] = {
+  "Success",
+  "Failed to open recording",
+  "Failed to map recording",
+  "Failed to close recording",
+};
+
+void epos_recorder_init(epos_recorder_t* recorder, const char* filename,
+    size_t capacity) {
+  if ((recorder->filename = malloc(strlen(filename)+1)))
+    strcpy(recorder->filename, filename);
+  recorder->capacity = capacity ? capacity : EPOS_RECORDER_CAPACITY;
+  
+  recorder->append = 0;
+  recorder->fd = -1;
+  recorder->size = 0;
+  recorder->header = 0;
+  recorder->frames = 0;
+  
+  error_init(&recorder->error, epos_recorder_errors);
+}
+
+void epos_recorder_destroy(epos_recorder_t* recorder) {
+  epos_recorder_close(recorder);
+  
+  free(recorder->filename);
+  error_destroy(&recorder->error);
+}
+
+epos_recorder_t* epos_recorder_attach(epos_bus_t* bus, const char*
+    filename) {
+  epos_recorder_t* recorder = bus->recorder;
+  
+  if (!recorder) {
+    if (!(recorder = malloc(sizeof(epos_recorder_t))))
+      return 0;
+    epos_recorder_init(recorder, filename, 0);
+    if (!recorder->filename) {
+      epos_recorder_destroy(recorder);
+      free(recorder);
+      
+      return 0;
+    }
+    
+    epos_bus_set_recorder(bus, recorder);
+  }
+  
+  return recorder;
+}
+
+int epos_recorder_open(epos_recorder_t* recorder) {
+  epos_recorder_header_t* header;
+  void* map;
+  
+  error_clear(&recorder->error);
+  
+  if (recorder->header)
+    return EPOS_RECORDER_ERROR_NONE;
+  
+  recorder->size = sizeof(epos_recorder_header_t)+
+    recorder->capacity*sizeof(epos_recorder_frame_t);
+  if (((recorder->fd = open(recorder->filename, recorder->append ?
+      O_RDWR | O_CREAT : O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) ||
+      ftruncate(recorder->fd, recorder->size)) {
+    error_setf(&recorder->error, EPOS_RECORDER_ERROR_OPEN, "%s",
+      recorder->filename);
+    
+    if (recorder->fd >= 0) {
+      close(recorder->fd);
+      recorder->fd = -1;
+    }
+    return recorder->error.code;
+  }
+  
+  map = mmap(0, recorder->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+    recorder->fd, 0);
+  if (map == MAP_FAILED) {
+    error_setf(&recorder->error, EPOS_RECORDER_ERROR_MAP, "%s",
+      recorder->filename);
+    
+    close(recorder->fd);
+    recorder->fd = -1;
+    return recorder->error.code;
+  }
+  
+  header = map;
+  if (!recorder->append ||
+      strncmp(header->magic, EPOS_RECORDER_MAGIC, sizeof(header->magic)) ||
+      (header->version != EPOS_RECORDER_VERSION) ||
+      (header->frame_size != sizeof(epos_recorder_frame_t)) ||
+      (header->capacity != recorder->capacity)) {
+    memset(header, 0, sizeof(epos_recorder_header_t));
+    strncpy(header->magic, EPOS_RECORDER_MAGIC, sizeof(header->magic));
+    header->version = EPOS_RECORDER_VERSION;
+    header->frame_size = sizeof(epos_recorder_frame_t);
+    header->start_time = epos_clock_get();
+    header->capacity = recorder->capacity;
+  }
+  recorder->frames = (epos_recorder_frame_t*)(header+1);
+  recorder->append = 1;
+  
+  __atomic_store_n(&recorder->header, header, __ATOMIC_RELEASE);
+  
+  return recorder->error.code;
+}
+
+int epos_recorder_close(epos_recorder_t* recorder) {
+  epos_recorder_header_t* header = recorder->header;
+  size_t num_frames;
+  
+  error_clear(&recorder->error);
+  
+  if (!header)
+    return EPOS_RECORDER_ERROR_NONE;
+  
+  recorder->header = 0;
+  recorder->frames = 0;
+  
+  num_frames = epos_recorder_get_num_frames(header);
+  header->num_dropped += header->num_frames-num_frames;
+  header->num_frames = num_frames;
+  
+  munmap(header, recorder->size);
+  if (ftruncate(recorder->fd, sizeof(epos_recorder_header_t)+
+      num_frames*sizeof(epos_recorder_frame_t)) | close(recorder->fd))
+    error_setf(&recorder->error, EPOS_RECORDER_ERROR_CLOSE, "%s",
+      recorder->filename);
+  
+  recorder->fd = -1;
+  recorder->size = 0;
+  
+  return recorder->error.code;
+}
+
+void epos_recorder_record(epos_recorder_t* recorder,
+    epos_recorder_direction_t direction, const can_message_t* message) {
+  epos_recorder_header_t* header = __atomic_load_n(&recorder->header,
+    __ATOMIC_ACQUIRE);
+  epos_recorder_frame_t* frame;
+  unsigned long long index;
+  
+  if (!header)
+    return;
+  
+  index = __atomic_fetch_add(&header->num_frames, 1, __ATOMIC_RELAXED);
+  if (index >= header->capacity)
+    return;
+  
+  frame = &recorder->frames[index];
+  frame->timestamp = epos_clock_get()-header->start_time;
+  frame->id = message->id;
+  frame->length = message->length;
+  memcpy(frame->content, message->content, sizeof(frame->content));
+  
+  __atomic_store_n(&frame->direction, direction, __ATOMIC_RELEASE);
+}
+
+size_t epos_recorder_get_num_frames(const epos_recorder_header_t* header) {
+  unsigned long long num_frames = __atomic_load_n(&header->num_frames,
+    __ATOMIC_RELAXED);
+  
+  return (num_frames < header->capacity) ? num_frames : header->capacity;
+}
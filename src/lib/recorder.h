@@ -0,0 +1,195 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef EPOS_RECORDER_H
+#define EPOS_RECORDER_H
+
+#include <can.h>
+
+#include <error/error.h>
+
+#include "bus.h"
+
+/** \file recorder.h
+  * \brief EPOS bus traffic recorder
+  * 
+  * The EPOS bus traffic recorder logs all CAN messages sent and received
+  * through an EPOS bus into a binary file, such that a session may later
+  * be analyzed or fed back into the library by the EPOS replay transport.
+  * 
+  * A recording consists of a header followed by an array of frames of
+  * fixed size. The file is mapped into memory at its full capacity when
+  * the recording is opened, and each frame is appended by atomically
+  * reserving its slot and writing it into the mapping. Recording thus
+  * neither locks the bus nor issues any system call per frame. Frames
+  * exceeding the capacity of the recording are dropped. When closed, the
+  * file is truncated to the frames actually recorded. Reopening a
+  * recording appends to the frames recorded before, such that closing and
+  * reopening the bus does not discard any traffic.
+  * 
+  * The direction of a frame is written last and remains zero while the
+  * frame is incomplete, such that a recording may be read while it is
+  * being written.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS recorder constants
+  */
+//@{
+#define EPOS_RECORDER_MAGIC                       "EPOSREC"
+#define EPOS_RECORDER_VERSION                     1
+#define EPOS_RECORDER_CAPACITY                    1048576
+//@}
+
+/** \name Error Codes
+  * \brief Predefined EPOS recorder error codes
+  */
+//@{
+#define EPOS_RECORDER_ERROR_NONE                  0
+//!< Success
+#define EPOS_RECORDER_ERROR_OPEN                  1
+//!< Failed to open recording
+#define EPOS_RECORDER_ERROR_MAP                   2
+//!< Failed to map recording
+#define EPOS_RECORDER_ERROR_CLOSE                 3
+//!< Failed to close recording
+//@}
+
+/** \brief Predefined EPOS recorder error descriptions
+  */
+extern const char* epos_recorder_errors[];
+
+/** \brief EPOS recorder frame directions
+  */
+typedef enum {
+  epos_recorder_incomplete = 0,    //!< Frame is being written.
+  epos_recorder_sent = 1,          //!< Frame was sent to the bus.
+  epos_recorder_received = 2       //!< Frame was received from the bus.
+} epos_recorder_direction_t;
+
+/** \brief Structure defining the header of an EPOS recording
+  */
+typedef struct epos_recorder_header_t {
+  char magic[8];                   //!< The magic string of the recording.
+  unsigned int version;            //!< The format version of the recording.
+  unsigned int frame_size;         //!< The size of a recorded frame.
+  double start_time;               //!< The clock time of the start in [s].
+  unsigned long long capacity;     //!< The maximum number of frames.
+  unsigned long long num_frames;   //!< The number of reserved frames.
+  unsigned long long num_dropped;  //!< The number of dropped frames.
+} epos_recorder_header_t;
+
+/** \brief Structure defining a recorded EPOS bus frame
+  */
+typedef struct epos_recorder_frame_t {
+  double timestamp;                //!< The time since the start in [s].
+  unsigned short id;               //!< The COB identifier of the message.
+  unsigned char length;            //!< The length of the message content.
+  unsigned char direction;         //!< The direction of the frame.
+  unsigned char content[8];        //!< The content of the message.
+  unsigned int reserved;           //!< Reserved for future use.
+} epos_recorder_frame_t;
+
+/** \brief Structure defining an EPOS recorder
+  */
+typedef struct epos_recorder_t {
+  char* filename;                  //!< The name of the recording file.
+  size_t capacity;                 //!< The maximum number of frames.
+
+  int append;                      //!< Reopening appends to the recording.
+  int fd;                          //!< The file descriptor, or negative.
+  size_t size;                     //!< The size of the mapped file.
+  epos_recorder_header_t* header;  //!< The mapped recording header.
+  epos_recorder_frame_t* frames;   //!< The mapped recording frames.
+
+  error_t error;                   //!< The most recent recorder error.
+} epos_recorder_t;
+
+/** \brief Initialize EPOS recorder
+  * \param[in] recorder The EPOS recorder to be initialized.
+  * \param[in] filename The name of the recording file.
+  * \param[in] capacity The maximum number of frames to be recorded, or
+  *   zero for the default capacity.
+  */
+void epos_recorder_init(
+  epos_recorder_t* recorder,
+  const char* filename,
+  size_t capacity);
+
+/** \brief Destroy EPOS recorder
+  * \param[in] recorder The EPOS recorder to be destroyed. An open
+  *   recording will be closed.
+  */
+void epos_recorder_destroy(
+  epos_recorder_t* recorder);
+
+/** \brief Attach an EPOS recorder to a bus
+  * \param[in] bus The EPOS bus whose traffic shall be recorded.
+  * \param[in] filename The name of the recording file.
+  * \return The recorder of the bus, or null if the recorder could not
+  *   be allocated. The recorder will be created if the bus is not yet
+  *   recorded, and the recording is opened and closed along with the bus.
+  */
+epos_recorder_t* epos_recorder_attach(
+  epos_bus_t* bus,
+  const char* filename);
+
+/** \brief Open EPOS recording
+  * \param[in] recorder The EPOS recorder to open the recording for.
+  * \return The resulting error code.
+  * 
+  * The recording file will be created or truncated when opened for the
+  * first time, and mapped into memory at the capacity of the recorder.
+  * Reopening a closed recording appends to its frames instead, with
+  * timestamps continuing from the original start time. Opening an open
+  * recording has no effect.
+  */
+int epos_recorder_open(
+  epos_recorder_t* recorder);
+
+/** \brief Close EPOS recording
+  * \param[in] recorder The EPOS recorder to close the recording for.
+  * \return The resulting error code.
+  */
+int epos_recorder_close(
+  epos_recorder_t* recorder);
+
+/** \brief Record an EPOS bus frame
+  * \param[in] recorder The EPOS recorder to record the frame with.
+  * \param[in] direction The direction of the frame.
+  * \param[in] message The CAN message of the frame.
+  * 
+  * This function is lock-free and may be called concurrently from any
+  * number of threads. It has no effect if the recording is not open.
+  */
+void epos_recorder_record(
+  epos_recorder_t* recorder,
+  epos_recorder_direction_t direction,
+  const can_message_t* message);
+
+/** \brief Retrieve the number of frames of an EPOS recording
+  * \param[in] header The header of the EPOS recording.
+  * \return The number of frames which have been reserved in the
+  *   recording, limited to its capacity.
+  */
+size_t epos_recorder_get_num_frames(
+  const epos_recorder_header_t* header);
+
+#endif
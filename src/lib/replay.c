@@ -0,0 +1,257 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "replay.h"
+#include "clock.h"
+
+const char* epos_replay_errors[] = {
+  "Success",
+  "Failed to open recording",
+  "Invalid recording format",
+  "Replay receive timeout",
+  "End of recording",
+};
+
+void epos_replay_init(epos_replay_t* replay, const char* filename);
+void epos_replay_destroy(void* data);
+size_t epos_replay_next(epos_replay_t* replay, size_t index,
+  epos_recorder_direction_t direction);
+
+int epos_replay_open(void* data);
+int epos_replay_close(void* data);
+int epos_replay_send(void* data, const can_message_t* message);
+int epos_replay_receive(void* data, can_message_t* message);
+
+epos_replay_t* epos_replay_attach(epos_bus_t* bus, const char* filename) {
+  epos_replay_t* replay;
+  
+  if (bus->transport.send != epos_replay_send) {
+    epos_bus_transport_t transport;
+    
+    if (!(replay = malloc(sizeof(epos_replay_t))))
+      return 0;
+    epos_replay_init(replay, filename);
+    if (!replay->filename) {
+      epos_replay_destroy(replay);
+      return 0;
+    }
+    
+    transport.data = replay;
+    transport.error = &replay->error;
+    transport.open = epos_replay_open;
+    transport.close = epos_replay_close;
+    transport.send = epos_replay_send;
+    transport.receive = epos_replay_receive;
+    transport.destroy = epos_replay_destroy;
+    
+    epos_bus_set_transport(bus, &transport);
+  }
+  else
+    replay = bus->transport.data;
+  
+  return replay;
+}
+
+void epos_replay_rewind(epos_replay_t* replay) {
+  pthread_mutex_lock(&replay->mutex);
+  
+  replay->sent = 0;
+  replay->received = 0;
+  replay->num_mismatches = 0;
+  
+  pthread_mutex_unlock(&replay->mutex);
+}
+
+void epos_replay_init(epos_replay_t* replay, const char* filename) {
+  if ((replay->filename = malloc(strlen(filename)+1)))
+    strcpy(replay->filename, filename);
+  
+  replay->size = 0;
+  replay->header = 0;
+  replay->frames = 0;
+  replay->num_frames = 0;
+  
+  replay->sent = 0;
+  replay->received = 0;
+  replay->num_mismatches = 0;
+  
+  pthread_mutex_init(&replay->mutex, 0);
+  
+  error_init(&replay->error, epos_replay_errors);
+}
+
+void epos_replay_destroy(void* data) {
+  epos_replay_t* replay = data;
+  
+  if (replay->header)
+    munmap((void*)replay->header, replay->size);
+  free(replay->filename);
+  
+  pthread_mutex_destroy(&replay->mutex);
+  error_destroy(&replay->error);
+  
+  free(replay);
+}
+
+size_t epos_replay_next(epos_replay_t* replay, size_t index,
+    epos_recorder_direction_t direction) {
+  while ((index < replay->num_frames) &&
+      (replay->frames[index].direction != direction))
+    ++index;
+  
+  return index;
+}
+
+int epos_replay_open(void* data) {
+  epos_replay_t* replay = data;
+  const epos_recorder_header_t* header;
+  struct stat stat;
+  void* map;
+  int fd;
+  
+  error_clear(&replay->error);
+  
+  if (replay->header)
+    return EPOS_REPLAY_ERROR_NONE;
+  
+  if ((fd = open(replay->filename, O_RDONLY)) < 0) {
+    error_setf(&replay->error, EPOS_REPLAY_ERROR_OPEN, "%s",
+      replay->filename);
+    return replay->error.code;
+  }
+  
+  if (fstat(fd, &stat) ||
+      (stat.st_size < sizeof(epos_recorder_header_t)) ||
+      ((map = mmap(0, stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+        MAP_FAILED)) {
+    error_setf(&replay->error, EPOS_REPLAY_ERROR_FORMAT, "%s",
+      replay->filename);
+    close(fd);
+    
+    return replay->error.code;
+  }
+  close(fd);
+  
+  header = map;
+  if (strncmp(header->magic, EPOS_RECORDER_MAGIC, sizeof(header->magic)) ||
+      (header->version != EPOS_RECORDER_VERSION) ||
+      (header->frame_size != sizeof(epos_recorder_frame_t))) {
+    error_setf(&replay->error, EPOS_REPLAY_ERROR_FORMAT, "%s",
+      replay->filename);
+    munmap(map, stat.st_size);
+    
+    return replay->error.code;
+  }
+  
+  replay->size = stat.st_size;
+  replay->header = header;
+  replay->frames = (const epos_recorder_frame_t*)(header+1);
+  replay->num_frames = epos_recorder_get_num_frames(header);
+  if (replay->num_frames > (replay->size-sizeof(epos_recorder_header_t))/
+      sizeof(epos_recorder_frame_t))
+    replay->num_frames = (replay->size-sizeof(epos_recorder_header_t))/
+      sizeof(epos_recorder_frame_t);
+  
+  return replay->error.code;
+}
+
+int epos_replay_close(void* data) {
+  return EPOS_REPLAY_ERROR_NONE;
+}
+
+int epos_replay_send(void* data, const can_message_t* message) {
+  epos_replay_t* replay = data;
+  const epos_recorder_frame_t* frame;
+  size_t index;
+  
+  pthread_mutex_lock(&replay->mutex);
+  
+  index = epos_replay_next(replay, replay->sent, epos_recorder_sent);
+  if (index < replay->num_frames) {
+    frame = &replay->frames[index];
+    if ((frame->id != message->id) || (frame->length != message->length) ||
+        memcmp(frame->content, message->content, message->length))
+      ++replay->num_mismatches;
+    
+    replay->sent = index+1;
+  }
+  else
+    ++replay->num_mismatches;
+  
+  pthread_mutex_unlock(&replay->mutex);
+  
+  return EPOS_REPLAY_ERROR_NONE;
+}
+
+int epos_replay_receive(void* data, can_message_t* message) {
+  epos_replay_t* replay = data;
+  double start_time = epos_clock_get(), time = start_time;
+  int result = EPOS_REPLAY_ERROR_NONE;
+  size_t index;
+  
+  pthread_mutex_lock(&replay->mutex);
+  
+  while (1) {
+    index = epos_replay_next(replay, replay->received,
+      epos_recorder_received);
+    
+    if (index == replay->num_frames) {
+      error_set(&replay->error, EPOS_REPLAY_ERROR_END);
+      result = replay->error.code;
+      
+      break;
+    }
+    else if (epos_replay_next(replay, replay->sent, epos_recorder_sent) >
+        index) {
+      const epos_recorder_frame_t* frame = &replay->frames[index];
+      
+      message->id = frame->id;
+      message->length = frame->length;
+      memcpy(message->content, frame->content, sizeof(message->content));
+      replay->received = index+1;
+      
+      break;
+    }
+    else if (time-start_time > EPOS_REPLAY_RECEIVE_TIMEOUT) {
+      error_set(&replay->error, EPOS_REPLAY_ERROR_TIMEOUT);
+      result = replay->error.code;
+      
+      break;
+    }
+    
+    pthread_mutex_unlock(&replay->mutex);
+    epos_clock_sleep(EPOS_REPLAY_POLL_PERIOD);
+    pthread_mutex_lock(&replay->mutex);
+    
+    time = epos_clock_get();
+  }
+  
+  pthread_mutex_unlock(&replay->mutex);
+  
+  return result;
+}
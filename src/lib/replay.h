@@ -0,0 +1,114 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef EPOS_REPLAY_H
+#define EPOS_REPLAY_H
+
+#include "bus.h"
+#include "recorder.h"
+
+/** \file replay.h
+  * \brief EPOS bus traffic replay
+  * 
+  * The EPOS replay transport replaces the transport of an EPOS bus by a
+  * session previously logged with the EPOS bus traffic recorder, such
+  * that the library may be run against the recorded traffic for offline
+  * analysis and performance regression.
+  * 
+  * The recording is mapped into memory read-only. Received frames are
+  * delivered in their recorded order, but never ahead of the frames
+  * which were sent before them in the recording. A received frame thus
+  * becomes available only once the library has sent the request which
+  * caused it. Each sent message is compared against its recorded frame,
+  * and deviations are counted as mismatches without interrupting the
+  * replay. Frames are replayed as fast as they are requested.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS replay constants
+  */
+//@{
+#define EPOS_REPLAY_RECEIVE_TIMEOUT               0.1
+#define EPOS_REPLAY_POLL_PERIOD                   1e-4
+//@}
+
+/** \name Error Codes
+  * \brief Predefined EPOS replay error codes
+  */
+//@{
+#define EPOS_REPLAY_ERROR_NONE                    0
+//!< Success
+#define EPOS_REPLAY_ERROR_OPEN                    1
+//!< Failed to open recording
+#define EPOS_REPLAY_ERROR_FORMAT                  2
+//!< Invalid recording format
+#define EPOS_REPLAY_ERROR_TIMEOUT                 3
+//!< Replay receive timeout
+#define EPOS_REPLAY_ERROR_END                     4
+//!< End of recording
+//@}
+
+/** \brief Predefined EPOS replay error descriptions
+  */
+extern const char* epos_replay_errors[];
+
+/** \brief Structure defining an EPOS replay transport
+  */
+typedef struct epos_replay_t {
+  char* filename;                  //!< The name of the recording file.
+
+  size_t size;                     //!< The size of the mapped file.
+  const epos_recorder_header_t*
+    header;                        //!< The mapped recording header.
+  const epos_recorder_frame_t*
+    frames;                        //!< The mapped recording frames.
+  size_t num_frames;               //!< The number of recorded frames.
+
+  size_t sent;                     //!< The index of the next sent frame.
+  size_t received;                 //!< The index of the next received frame.
+  size_t num_mismatches;           //!< The number of mismatching frames.
+
+  pthread_mutex_t mutex;           //!< The replay mutex.
+
+  error_t error;                   //!< The most recent replay error.
+} epos_replay_t;
+
+/** \brief Attach the EPOS replay transport to a bus
+  * \param[in] bus The EPOS bus to replay the recording on.
+  * \param[in] filename The name of the recording file.
+  * \return The replay transport of the bus, or null if the transport
+  *   could not be allocated. The transport will be created if the bus does
+  *   not yet replay a recording, and the recording is opened along with
+  *   the bus.
+  */
+epos_replay_t* epos_replay_attach(
+  epos_bus_t* bus,
+  const char* filename);
+
+/** \brief Rewind an EPOS replay
+  * \param[in] replay The EPOS replay transport to be rewound.
+  * 
+  * Rewinding restarts the replay from the beginning of the recording
+  * and resets the number of mismatches.
+  */
+void epos_replay_rewind(
+  epos_replay_t* replay);
+
+#endif
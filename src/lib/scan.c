@@ -0,0 +1,158 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <stdlib.h>
+
+#include "scan.h"
+#include "sdo.h"
+#include "bus.h"
+
+const char* epos_scan_errors[] = {
+  "Success",
+  "No EPOS bus attached to CAN device",
+  "Failed to send scan request",
+  "Failed to allocate scan requests",
+};
+
+int epos_scan_check(epos_scan_t* scan, epos_sdo_request_t* requests, size_t
+  num_requests);
+
+void epos_scan_init(epos_scan_t* scan, can_device_t* can_dev, double
+    timeout) {
+  scan->can_dev = can_dev;
+  scan->timeout = (timeout > 0.0) ? timeout : EPOS_SCAN_TIMEOUT;
+
+  scan->num_nodes = 0;
+
+  error_init(&scan->error, epos_scan_errors);
+}
+
+void epos_scan_destroy(epos_scan_t* scan) {
+  scan->can_dev = 0;
+  scan->num_nodes = 0;
+
+  error_destroy(&scan->error);
+}
+
+int epos_scan_run(epos_scan_t* scan) {
+  epos_bus_t* bus = epos_bus_find(scan->can_dev);
+  epos_device_t* devs[CAN_NODE_ID_MAX+1];
+  epos_device_t* attached;
+  epos_sdo_client_t client;
+  epos_sdo_request_t* requests;
+  unsigned char ids[CAN_NODE_ID_MAX+1];
+  size_t i, num_attached = 0, num_requests = 0;
+  int node_id;
+  
+  error_clear(&scan->error);
+  scan->num_nodes = 0;
+  
+  if (!bus) {
+    error_set(&scan->error, EPOS_SCAN_ERROR_BUS);
+    return scan->error.code;
+  }
+  
+  attached = malloc(CAN_NODE_ID_MAX*sizeof(epos_device_t));
+  requests = malloc(2*CAN_NODE_ID_MAX*sizeof(epos_sdo_request_t));
+  if (!attached || !requests) {
+    free(requests);
+    free(attached);
+    
+    error_set(&scan->error, EPOS_SCAN_ERROR_ALLOCATION);
+    return scan->error.code;
+  }
+  
+  epos_sdo_client_init(&client, scan->can_dev, scan->timeout);
+  
+  for (node_id = 1; node_id <= CAN_NODE_ID_MAX; ++node_id) {
+    pthread_mutex_lock(&bus->mutex);
+    devs[node_id] = bus->nodes[node_id].dev;
+    pthread_mutex_unlock(&bus->mutex);
+    
+    if (!devs[node_id]) {
+      devs[node_id] = &attached[num_attached++];
+      epos_device_init(devs[node_id], scan->can_dev, node_id, 0);
+    }
+    
+    ids[node_id] = 0;
+    epos_sdo_request_init_read(&requests[num_requests++], devs[node_id],
+      EPOS_DEVICE_INDEX_ID, 0, &ids[node_id], sizeof(ids[node_id]), 0, 0);
+  }
+  
+  epos_sdo_transfer(&client, requests, num_requests);
+  
+  if (!epos_scan_check(scan, requests, num_requests)) {
+    for (i = 0; i < num_requests; ++i)
+      if (requests[i].state == epos_sdo_completed) {
+      epos_scan_node_t* node = &scan->nodes[scan->num_nodes++];
+      
+      node->node_id = requests[i].dev->node_id;
+      node->type = epos_device_unknown;
+      node->hardware_version = 0;
+      node->software_version = 0;
+    }
+    
+    for (i = 0, num_requests = 0; i < scan->num_nodes; ++i) {
+      epos_scan_node_t* node = &scan->nodes[i];
+      
+      epos_sdo_request_init_read(&requests[num_requests++],
+        devs[node->node_id], EPOS_DEVICE_INDEX_VERSION,
+        EPOS_DEVICE_SUBINDEX_SOFTWARE_VERSION,
+        (unsigned char*)&node->software_version, sizeof(short), 0, 0);
+      epos_sdo_request_init_read(&requests[num_requests++],
+        devs[node->node_id], EPOS_DEVICE_INDEX_VERSION,
+        EPOS_DEVICE_SUBINDEX_HARDWARE_VERSION,
+        (unsigned char*)&node->hardware_version, sizeof(short), 0, 0);
+    }
+    
+    epos_sdo_transfer(&client, requests, num_requests);
+    
+    if (!epos_scan_check(scan, requests, num_requests))
+      for (i = 0; i < scan->num_nodes; ++i) {
+      epos_scan_node_t* node = &scan->nodes[i];
+      epos_device_type_t type;
+      
+      for (type = 0; type < epos_device_unknown; ++type)
+        if ((node->hardware_version & EPOS_DEVICE_TYPE_MASK) ==
+          epos_device_hardware_versions[type])
+        node->type = type;
+    }
+  }
+  
+  epos_sdo_client_destroy(&client);
+  for (i = 0; i < num_attached; ++i)
+    epos_device_destroy(&attached[i]);
+  free(requests);
+  free(attached);
+  
+  return scan->error.code;
+}
+
+int epos_scan_check(epos_scan_t* scan, epos_sdo_request_t* requests, size_t
+    num_requests) {
+  size_t i;
+  
+  for (i = 0; (i < num_requests) && !scan->error.code; ++i)
+    if (requests[i].error == EPOS_SDO_ERROR_SEND)
+      error_setf(&scan->error, EPOS_SCAN_ERROR_SEND, "[Node 0x%hX]",
+        requests[i].dev->node_id);
+  
+  return scan->error.code;
+}
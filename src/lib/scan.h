@@ -0,0 +1,119 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef EPOS_SCAN_H
+#define EPOS_SCAN_H
+
+#include "device.h"
+
+/** \file scan.h
+  * \brief EPOS node scanner
+  * 
+  * The node scanner discovers the EPOS nodes connected to a CAN bus by
+  * reading the node identifier object of all valid node identifiers in
+  * a single pipelined SDO burst. Absent nodes thus time out concurrently,
+  * such that the duration of a scan is dominated by a single timeout
+  * rather than one timeout per node identifier. The version objects of
+  * all responding nodes are then retrieved in a second burst.
+  * 
+  * Nodes without an attached EPOS device are temporarily attached to
+  * the bus for the duration of the scan. Nodes with an attached device
+  * are scanned through this device, such that no other thread should
+  * communicate with these nodes during a scan.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS scanner constants
+  */
+//@{
+#define EPOS_SCAN_TIMEOUT                         0.1
+//@}
+
+/** \name Error Codes
+  * \brief Predefined EPOS scanner error codes
+  */
+//@{
+#define EPOS_SCAN_ERROR_NONE                      0
+//!< Success
+#define EPOS_SCAN_ERROR_BUS                       1
+//!< No EPOS bus attached to CAN device
+#define EPOS_SCAN_ERROR_SEND                      2
+//!< Failed to send scan request
+#define EPOS_SCAN_ERROR_ALLOCATION                3
+//!< Failed to allocate scan requests
+//@}
+
+/** \brief Predefined EPOS scanner error descriptions
+  */
+extern const char* epos_scan_errors[];
+
+/** \brief Structure defining a discovered EPOS node
+  */
+typedef struct epos_scan_node_t {
+  int node_id;                     //!< The node identifier of the node.
+  epos_device_type_t type;         //!< The device type of the node.
+  short hardware_version;          //!< The hardware version of the node.
+  short software_version;          //!< The software version of the node.
+} epos_scan_node_t;
+
+/** \brief Structure defining an EPOS node scanner
+  */
+typedef struct epos_scan_t {
+  can_device_t* can_dev;           //!< The CAN device of the scanner.
+  double timeout;                  //!< The response timeout in [s].
+
+  epos_scan_node_t
+    nodes[CAN_NODE_ID_MAX];        //!< The discovered nodes by identifier.
+  size_t num_nodes;                //!< The number of discovered nodes.
+
+  error_t error;                   //!< The most recent scanner error.
+} epos_scan_t;
+
+/** \brief Initialize EPOS node scanner
+  * \param[in] scan The EPOS node scanner to be initialized.
+  * \param[in] can_dev The CAN device of the bus to be scanned.
+  * \param[in] timeout The response timeout of the scanned nodes in [s].
+  *   Zero selects the default timeout.
+  */
+void epos_scan_init(
+  epos_scan_t* scan,
+  can_device_t* can_dev,
+  double timeout);
+
+/** \brief Destroy EPOS node scanner
+  * \param[in] scan The EPOS node scanner to be destroyed.
+  */
+void epos_scan_destroy(
+  epos_scan_t* scan);
+
+/** \brief Scan the bus for EPOS nodes
+  * \param[in] scan The EPOS node scanner to be used.
+  * \return The resulting error code. Node identifiers which do not
+  *   respond within the timeout of the scanner are considered absent
+  *   and do not cause an error.
+  * 
+  * The bus of the CAN device must have been created by attaching at
+  * least one EPOS device, and it must be open. On success, the nodes
+  * of the scanner are ordered by ascending node identifier.
+  */
+int epos_scan_run(
+  epos_scan_t* scan);
+
+#endif
@@ -0,0 +1,416 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <string.h>
+
+#include "sdo.h"
+#include "error.h"
+#include "clock.h"
+#include "bus.h"
+
+#include "macros.h"
+
+const char* epos_sdo_errors[] = {
+  "Success",
+  "Failed to send SDO request",
+  "Failed to receive SDO response",
+  "SDO transfer aborted",
+  "SDO transfer timeout",
+  "Invalid SDO object size",
+  "Invalid SDO node identifier",
+};
+
+void epos_sdo_request_init(epos_sdo_request_t* request, epos_sdo_type_t
+  type, epos_device_t* dev, short index, unsigned char subindex, unsigned
+  char* data, size_t num, epos_sdo_callback_t callback, void* user_data);
+int epos_sdo_send(epos_sdo_client_t* client, epos_sdo_request_t* request);
+void epos_sdo_receive_message(epos_sdo_client_t* client, epos_sdo_request_t*
+  request, const can_message_t* message);
+void epos_sdo_complete(epos_sdo_client_t* client, epos_sdo_request_t*
+  request, int error, int abort_code);
+void epos_sdo_finish(epos_sdo_client_t* client, epos_sdo_request_t* request,
+  int error, int abort_code);
+void epos_sdo_queue_push(epos_sdo_queue_t* queue, epos_sdo_request_t*
+  request);
+epos_sdo_request_t* epos_sdo_queue_pop(epos_sdo_queue_t* queue);
+
+void epos_sdo_request_init_read(epos_sdo_request_t* request, epos_device_t*
+    dev, short index, unsigned char subindex, unsigned char* data, size_t
+    num, epos_sdo_callback_t callback, void* user_data) {
+  epos_sdo_request_init(request, epos_sdo_read, dev, index, subindex, data,
+    num, callback, user_data);
+}
+
+void epos_sdo_request_init_write(epos_sdo_request_t* request, epos_device_t*
+    dev, short index, unsigned char subindex, unsigned char* data, size_t
+    num, epos_sdo_callback_t callback, void* user_data) {
+  epos_sdo_request_init(request, epos_sdo_write, dev, index, subindex, data,
+    num, callback, user_data);
+}
+
+void epos_sdo_request_init(epos_sdo_request_t* request, epos_sdo_type_t
+    type, epos_device_t* dev, short index, unsigned char subindex, unsigned
+    char* data, size_t num, epos_sdo_callback_t callback, void* user_data) {
+  request->dev = dev;
+  request->type = type;
+  
+  request->index = index;
+  request->subindex = subindex;
+  
+  request->data = data;
+  request->num = num;
+  request->num_transferred = 0;
+  
+  request->callback = callback;
+  request->user_data = user_data;
+  
+  request->state = epos_sdo_idle;
+  request->error = EPOS_SDO_ERROR_NONE;
+  request->abort_code = 0;
+  request->timestamp = 0.0;
+  request->num_retries = 0;
+  
+  request->next = 0;
+}
+
+unsigned short epos_sdo_crc(const unsigned char* data, size_t num, unsigned
+    short crc) {
+  size_t i;
+  int j;
+  
+  for (i = 0; i < num; ++i) {
+    crc ^= data[i] << 8;
+    for (j = 0; j < 8; ++j)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  
+  return crc;
+}
+
+void epos_sdo_client_init(epos_sdo_client_t* client, can_device_t* can_dev,
+    double timeout) {
+  int i;
+  
+  client->can_dev = can_dev;
+  client->timeout = timeout;
+  
+  for (i = 0; i <= CAN_NODE_ID_MAX; ++i) {
+    client->pending[i] = 0;
+    client->queued[i].first = 0;
+    client->queued[i].last = 0;
+  }
+  client->num_pending = 0;
+  
+  client->completed.first = 0;
+  client->completed.last = 0;
+  
+  error_init(&client->error, epos_sdo_errors);
+}
+
+void epos_sdo_client_destroy(epos_sdo_client_t* client) {
+  error_destroy(&client->error);
+}
+
+int epos_sdo_submit(epos_sdo_client_t* client, epos_sdo_request_t* request) {
+  int node_id = request->dev->node_id;
+  
+  error_clear(&client->error);
+  
+  if ((node_id <= CAN_NODE_ID_BROADCAST) || (node_id > CAN_NODE_ID_MAX)) {
+    error_setf(&client->error, EPOS_SDO_ERROR_INVALID_NODE, "%d", node_id);
+    return client->error.code;
+  }
+  if (!request->num || (request->num > EPOS_SDO_MAX_EXPEDITED_SIZE)) {
+    error_setf(&client->error, EPOS_SDO_ERROR_INVALID_SIZE, "%lu",
+      (unsigned long)request->num);
+    return client->error.code;
+  }
+  
+  if (request->type == epos_sdo_write)
+    epos_cache_invalidate(&request->dev->cache, request->index,
+      request->subindex);
+  else if (epos_cache_read(&request->dev->cache, request->index,
+      request->subindex, request->data, request->num)) {
+    request->num_transferred = request->num;
+    epos_sdo_finish(client, request, EPOS_SDO_ERROR_NONE, 0);
+    
+    return client->error.code;
+  }
+  
+  request->next = 0;
+  if (client->pending[node_id]) {
+    request->state = epos_sdo_queued;
+    epos_sdo_queue_push(&client->queued[node_id], request);
+  }
+  else
+    epos_sdo_send(client, request);
+  
+  return client->error.code;
+}
+
+int epos_sdo_process(epos_sdo_client_t* client) {
+  epos_bus_t* bus = epos_bus_find(client->can_dev);
+  can_message_t message;
+  int abort_code = EPOS_SDO_ABORT_TIMEOUT;
+  double time;
+  int node_id;
+  
+  error_clear(&client->error);
+  
+  if (bus && !epos_bus_dispatch(bus)) {
+    for (node_id = 1; node_id <= CAN_NODE_ID_MAX; ++node_id)
+      if (client->pending[node_id] && epos_bus_poll(bus, node_id,
+          epos_bus_sdo, &message) &&
+          (client->pending[node_id]->state == epos_sdo_pending))
+        epos_sdo_receive_message(client, client->pending[node_id], &message);
+  }
+  
+  time = epos_clock_get();
+  for (node_id = 1; node_id <= CAN_NODE_ID_MAX; ++node_id) {
+    epos_sdo_request_t* request = client->pending[node_id];
+    double delay;
+    
+    if (request && (request->state == epos_sdo_delayed)) {
+      if (time >= request->timestamp) {
+        client->pending[node_id] = 0;
+        --client->num_pending;
+        if (bus)
+          epos_bus_clear(bus, node_id, epos_bus_sdo);
+        epos_sdo_send(client, request);
+      }
+    }
+    else if (request && (time-request->timestamp > client->timeout)) {
+      memset(&message, 0, sizeof(can_message_t));
+      message.id = CAN_COB_ID_SDO_SEND+node_id;
+      message.content[0] = EPOS_SDO_CS_ABORT;
+      message.content[1] = request->index;
+      message.content[2] = request->index >> 8;
+      message.content[3] = request->subindex;
+      memcpy(&message.content[4], &abort_code, sizeof(abort_code));
+      message.length = 8;
+      
+      if (bus && !epos_bus_send(bus, &message))
+        epos_device_count_sent(request->dev, &message);
+      ++request->dev->statistics.num_timeouts;
+      
+      delay = epos_device_get_retry_delay(request->dev,
+        request->type == epos_sdo_write, request->num_retries);
+      if (delay >= 0.0) {
+        ++request->num_retries;
+        ++request->dev->statistics.num_retries;
+        
+        request->state = epos_sdo_delayed;
+        request->timestamp = time+delay;
+      }
+      else
+        epos_sdo_complete(client, request, EPOS_SDO_ERROR_TIMEOUT,
+          abort_code);
+    }
+  }
+  
+  return client->error.code;
+}
+
+int epos_sdo_wait(epos_sdo_client_t* client) {
+  error_clear(&client->error);
+  
+  while (client->num_pending && !epos_sdo_process(client));
+  
+  return client->error.code;
+}
+
+int epos_sdo_transfer(epos_sdo_client_t* client, epos_sdo_request_t*
+    requests, size_t num_requests) {
+  epos_sdo_queue_t completed = {0, 0};
+  epos_sdo_request_t* request;
+  size_t i, num_submitted;
+  int result;
+  
+  for (num_submitted = 0; (num_submitted < num_requests) &&
+    !epos_sdo_submit(client, &requests[num_submitted]); ++num_submitted);
+  result = client->error.code;
+  
+  epos_sdo_wait(client);
+  if (result && !client->error.code)
+    error_setf(&client->error, result, "[Node 0x%hX]",
+      requests[num_submitted].dev->node_id);
+  
+  while ((request = epos_sdo_queue_pop(&client->completed)))
+    if ((request < requests) || (request >= &requests[num_requests]))
+      epos_sdo_queue_push(&completed, request);
+  client->completed = completed;
+  
+  for (i = 0; (i < num_requests) && !client->error.code; ++i)
+    if (requests[i].state == epos_sdo_failed) {
+      if (requests[i].error == EPOS_SDO_ERROR_ABORT)
+        error_setf(&client->error, requests[i].error,
+          "[Node 0x%hX]: %s (0x%X)", requests[i].dev->node_id,
+          epos_error_comm(requests[i].abort_code), requests[i].abort_code);
+      else
+        error_setf(&client->error, requests[i].error, "[Node 0x%hX]",
+          requests[i].dev->node_id);
+    }
+  
+  return client->error.code;
+}
+
+epos_sdo_request_t* epos_sdo_poll(epos_sdo_client_t* client) {
+  return epos_sdo_queue_pop(&client->completed);
+}
+
+int epos_sdo_send(epos_sdo_client_t* client, epos_sdo_request_t* request) {
+  epos_bus_t* bus = request->dev->bus;
+  can_message_t message;
+  int node_id = request->dev->node_id;
+  
+  memset(&message, 0, sizeof(can_message_t));
+  message.id = CAN_COB_ID_SDO_SEND+node_id;
+  if (request->type == epos_sdo_read)
+    message.content[0] = EPOS_SDO_CS_UPLOAD_REQUEST;
+  else {
+    message.content[0] = EPOS_SDO_CS_DOWNLOAD_REQUEST |
+      ((EPOS_SDO_MAX_EXPEDITED_SIZE-request->num) << 2) |
+      EPOS_SDO_FLAG_EXPEDITED | EPOS_SDO_FLAG_SIZE;
+    memcpy(&message.content[4], request->data, request->num);
+  }
+  message.content[1] = request->index;
+  message.content[2] = request->index >> 8;
+  message.content[3] = request->subindex;
+  message.length = 8;
+  
+  request->state = epos_sdo_pending;
+  client->pending[node_id] = request;
+  ++client->num_pending;
+  request->timestamp = epos_clock_get();
+  
+  if (!bus) {
+    error_set(&client->error, EPOS_SDO_ERROR_SEND);
+    epos_sdo_complete(client, request, EPOS_SDO_ERROR_SEND, 0);
+  }
+  else if (epos_bus_send(bus, &message)) {
+    error_blame(&client->error, &bus->error, EPOS_SDO_ERROR_SEND);
+    epos_sdo_complete(client, request, EPOS_SDO_ERROR_SEND, 0);
+  }
+  else
+    epos_device_count_sent(request->dev, &message);
+  
+  return client->error.code;
+}
+
+void epos_sdo_receive_message(epos_sdo_client_t* client, epos_sdo_request_t*
+    request, const can_message_t* message) {
+  short index = message->content[1]+(message->content[2] << 8);
+  unsigned char subindex = message->content[3];
+  unsigned char cs = message->content[0] & EPOS_SDO_CS_MASK;
+  
+  if ((request->index != index) || (request->subindex != subindex))
+    return;
+  
+  epos_device_count_round_trip(request->dev, request->index,
+    epos_clock_get()-request->timestamp);
+  
+  if (cs == EPOS_SDO_CS_ABORT) {
+    int code;
+    
+    memcpy(&code, &message->content[4], sizeof(code));
+    epos_device_count_abort(&request->dev->statistics, code);
+    epos_sdo_complete(client, request, EPOS_SDO_ERROR_ABORT, code);
+  }
+  else if ((request->type == epos_sdo_read) &&
+      (cs == EPOS_SDO_CS_UPLOAD_RESPONSE)) {
+    size_t num = EPOS_SDO_MAX_EXPEDITED_SIZE;
+    
+    if (message->content[0] & EPOS_SDO_FLAG_SIZE)
+      num -= (message->content[0] >> 2) & 0x03;
+    request->num_transferred = min(num, request->num);
+    memcpy(request->data, &message->content[4], request->num_transferred);
+    
+    ++request->dev->num_read;
+    epos_sdo_complete(client, request, EPOS_SDO_ERROR_NONE, 0);
+  }
+  else if ((request->type == epos_sdo_write) &&
+      (cs == EPOS_SDO_CS_DOWNLOAD_RESPONSE)) {
+    request->num_transferred = request->num;
+    
+    ++request->dev->num_written;
+    epos_sdo_complete(client, request, EPOS_SDO_ERROR_NONE, 0);
+  }
+}
+
+void epos_sdo_complete(epos_sdo_client_t* client, epos_sdo_request_t*
+    request, int error, int abort_code) {
+  int node_id = request->dev->node_id;
+  epos_sdo_request_t* next;
+  
+  client->pending[node_id] = 0;
+  --client->num_pending;
+  
+  if (!error) {
+    epos_cache_update(&request->dev->cache, request->index,
+      request->subindex, request->data, request->num_transferred);
+    
+    if (request->type == epos_sdo_read)
+      request->dev->statistics.num_bytes_read += request->num_transferred;
+    else
+      request->dev->statistics.num_bytes_written += request->num_transferred;
+  }
+  
+  if ((next = epos_sdo_queue_pop(&client->queued[node_id])))
+    epos_sdo_send(client, next);
+  
+  epos_sdo_finish(client, request, error, abort_code);
+}
+
+void epos_sdo_finish(epos_sdo_client_t* client, epos_sdo_request_t* request,
+    int error, int abort_code) {
+  request->state = error ? epos_sdo_failed : epos_sdo_completed;
+  request->error = error;
+  request->abort_code = abort_code;
+  
+  if (request->callback)
+    request->callback(request, request->user_data);
+  else
+    epos_sdo_queue_push(&client->completed, request);
+}
+
+void epos_sdo_queue_push(epos_sdo_queue_t* queue, epos_sdo_request_t*
+    request) {
+  request->next = 0;
+  
+  if (queue->last)
+    queue->last->next = request;
+  else
+    queue->first = request;
+  queue->last = request;
+}
+
+epos_sdo_request_t* epos_sdo_queue_pop(epos_sdo_queue_t* queue) {
+  epos_sdo_request_t* request = queue->first;
+  
+  if (request) {
+    queue->first = request->next;
+    if (!queue->first)
+      queue->last = 0;
+    request->next = 0;
+  }
+  
+  return request;
+}
@@ -0,0 +1,339 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#ifndef EPOS_SDO_H
+#define EPOS_SDO_H
+
+#include "device.h"
+
+/** \file sdo.h
+  * \brief EPOS asynchronous SDO client
+  * 
+  * The asynchronous SDO client pipelines service data object transfers
+  * to several EPOS nodes. Whereas the CANopen protocol permits a single
+  * SDO transfer in flight per node, requests to different nodes proceed
+  * concurrently. Further requests to a busy node are queued and sent in
+  * order of submission. Responses are matched to the outstanding request
+  * by COB identifier, index, and subindex.
+  * 
+  * Requests are allocated by the caller and must remain valid until they
+  * complete. Completed requests are either reported to their callback or,
+  * if no callback has been provided, appended to the completion queue of
+  * the client.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS SDO constants
+  */
+//@{
+#define EPOS_SDO_MAX_EXPEDITED_SIZE               4
+#define EPOS_SDO_MAX_SEGMENT_SIZE                 7
+#define EPOS_SDO_MAX_BLOCK_SIZE                   127
+//@}
+
+/** \name Command Specifiers
+  * \brief Predefined EPOS SDO command specifiers
+  */
+//@{
+#define EPOS_SDO_CS_MASK                          0xE0
+#define EPOS_SDO_CS_DOWNLOAD_REQUEST              0x20
+#define EPOS_SDO_CS_UPLOAD_REQUEST                0x40
+#define EPOS_SDO_CS_DOWNLOAD_RESPONSE             0x60
+#define EPOS_SDO_CS_UPLOAD_RESPONSE               0x40
+#define EPOS_SDO_CS_ABORT                         0x80
+#define EPOS_SDO_CS_DOWNLOAD_SEGMENT_REQUEST      0x00
+#define EPOS_SDO_CS_DOWNLOAD_SEGMENT_RESPONSE     0x20
+#define EPOS_SDO_CS_UPLOAD_SEGMENT_REQUEST        0x60
+#define EPOS_SDO_CS_UPLOAD_SEGMENT_RESPONSE       0x00
+#define EPOS_SDO_FLAG_EXPEDITED                   0x02
+#define EPOS_SDO_FLAG_SIZE                        0x01
+#define EPOS_SDO_FLAG_TOGGLE                      0x10
+#define EPOS_SDO_FLAG_LAST                        0x01
+//@}
+
+/** \name Block Transfer Command Specifiers
+  * \brief Predefined EPOS SDO block transfer command specifiers
+  * 
+  * Block upload responses and block download requests carry a single
+  * subcommand bit, whereas the other block transfer messages carry two.
+  */
+//@{
+#define EPOS_SDO_CS_BLOCK_DOWNLOAD_REQUEST        0xC0
+#define EPOS_SDO_CS_BLOCK_DOWNLOAD_RESPONSE       0xA0
+#define EPOS_SDO_CS_BLOCK_UPLOAD_REQUEST          0xA0
+#define EPOS_SDO_CS_BLOCK_UPLOAD_RESPONSE         0xC0
+#define EPOS_SDO_BLOCK_SUBCOMMAND_MASK            0x03
+#define EPOS_SDO_BLOCK_INITIATE                   0x00
+#define EPOS_SDO_BLOCK_END                        0x01
+#define EPOS_SDO_BLOCK_ACK                        0x02
+#define EPOS_SDO_BLOCK_START                      0x03
+#define EPOS_SDO_BLOCK_FLAG_SIZE                  0x02
+#define EPOS_SDO_BLOCK_FLAG_CRC                   0x04
+#define EPOS_SDO_BLOCK_FLAG_LAST                  0x80
+#define EPOS_SDO_BLOCK_SEQUENCE_MASK              0x7F
+//@}
+
+/** \name Abort Codes
+  * \brief Predefined EPOS SDO abort codes
+  */
+//@{
+#define EPOS_SDO_ABORT_TOGGLE                     0x05030000
+#define EPOS_SDO_ABORT_TIMEOUT                    0x05040000
+#define EPOS_SDO_ABORT_COMMAND                    0x05040001
+#define EPOS_SDO_ABORT_BLOCK_SIZE                 0x05040002
+#define EPOS_SDO_ABORT_SEQUENCE                   0x05040003
+#define EPOS_SDO_ABORT_CRC                        0x05040004
+#define EPOS_SDO_ABORT_LENGTH_HIGH                0x06070012
+//@}
+
+/** \name Error Codes
+  * \brief Predefined EPOS SDO error codes
+  */
+//@{
+#define EPOS_SDO_ERROR_NONE                       0
+//!< Success
+#define EPOS_SDO_ERROR_SEND                       1
+//!< Failed to send SDO request
+#define EPOS_SDO_ERROR_RECEIVE                    2
+//!< Failed to receive SDO response
+#define EPOS_SDO_ERROR_ABORT                      3
+//!< SDO transfer aborted
+#define EPOS_SDO_ERROR_TIMEOUT                    4
+//!< SDO transfer timeout
+#define EPOS_SDO_ERROR_INVALID_SIZE               5
+//!< Invalid SDO object size
+#define EPOS_SDO_ERROR_INVALID_NODE               6
+//!< Invalid SDO node identifier
+//@}
+
+/** \brief Predefined EPOS SDO error descriptions
+  */
+extern const char* epos_sdo_errors[];
+
+/** \brief EPOS SDO request types
+  */
+typedef enum {
+  epos_sdo_read,                   //!< Read (upload) an object.
+  epos_sdo_write                   //!< Write (download) an object.
+} epos_sdo_type_t;
+
+/** \brief EPOS SDO request states
+  */
+typedef enum {
+  epos_sdo_idle,                   //!< The request has not been submitted.
+  epos_sdo_queued,                 //!< The request waits for its node.
+  epos_sdo_pending,                //!< The request is in flight.
+  epos_sdo_delayed,                //!< The request waits to be resent.
+  epos_sdo_completed,              //!< The request completed successfully.
+  epos_sdo_failed                  //!< The request failed.
+} epos_sdo_state_t;
+
+struct epos_sdo_request_t;
+
+/** \brief EPOS SDO completion callback
+  * \param[in] request The completed EPOS SDO request.
+  * \param[in] user_data The user data passed with the request.
+  */
+typedef void (*epos_sdo_callback_t)(
+  struct epos_sdo_request_t* request,
+  void* user_data);
+
+/** \brief Structure defining an EPOS SDO request
+  */
+typedef struct epos_sdo_request_t {
+  epos_device_t* dev;              //!< The EPOS device of the request.
+  epos_sdo_type_t type;            //!< The type of the request.
+
+  short index;                     //!< The index of the requested object.
+  unsigned char subindex;          //!< The subindex of the requested object.
+
+  unsigned char* data;             //!< The data buffer of the request.
+  size_t num;                      //!< The size of the data buffer in [B].
+  size_t num_transferred;          //!< The number of transferred bytes.
+
+  epos_sdo_callback_t callback;    //!< The completion callback, or null.
+  void* user_data;                 //!< The user data of the callback.
+
+  epos_sdo_state_t state;          //!< The state of the request.
+  int error;                       //!< The SDO error code of the request.
+  int abort_code;                  //!< The abort code of a failed request.
+  double timestamp;                //!< The time the request was sent, or
+                                   //!< will be resent if delayed, in [s].
+  int num_retries;                 //!< The number of retries of the request.
+
+  struct epos_sdo_request_t* next; //!< The next request in a queue.
+} epos_sdo_request_t;
+
+/** \brief Structure defining an EPOS SDO request queue
+  */
+typedef struct epos_sdo_queue_t {
+  epos_sdo_request_t* first;       //!< The first request in the queue.
+  epos_sdo_request_t* last;        //!< The last request in the queue.
+} epos_sdo_queue_t;
+
+/** \brief Structure defining an EPOS asynchronous SDO client
+  */
+typedef struct epos_sdo_client_t {
+  can_device_t* can_dev;           //!< The CAN device of the client.
+  double timeout;                  //!< The SDO transfer timeout in [s].
+
+  epos_sdo_request_t*
+    pending[CAN_NODE_ID_MAX+1];    //!< The requests in flight per node.
+  epos_sdo_queue_t
+    queued[CAN_NODE_ID_MAX+1];     //!< The queued requests per node.
+  size_t num_pending;              //!< The number of requests in flight.
+
+  epos_sdo_queue_t completed;      //!< The completion queue of the client.
+
+  error_t error;                   //!< The most recent client error.
+} epos_sdo_client_t;
+
+/** \brief Initialize EPOS SDO read request
+  * \param[in] request The EPOS SDO request to be initialized.
+  * \param[in] dev The EPOS device to read the object from.
+  * \param[in] index The index of the object to be read.
+  * \param[in] subindex The subindex of the object to be read.
+  * \param[in] data The buffer receiving the object data.
+  * \param[in] num The size of the buffer in [B].
+  * \param[in] callback The completion callback, or null if the request
+  *   should be appended to the completion queue of the client.
+  * \param[in] user_data The user data passed to the callback.
+  */
+void epos_sdo_request_init_read(
+  epos_sdo_request_t* request,
+  epos_device_t* dev,
+  short index,
+  unsigned char subindex,
+  unsigned char* data,
+  size_t num,
+  epos_sdo_callback_t callback,
+  void* user_data);
+
+/** \brief Initialize EPOS SDO write request
+  * \param[in] request The EPOS SDO request to be initialized.
+  * \param[in] dev The EPOS device to write the object to.
+  * \param[in] index The index of the object to be written.
+  * \param[in] subindex The subindex of the object to be written.
+  * \param[in] data The object data to be written.
+  * \param[in] num The number of bytes to be written.
+  * \param[in] callback The completion callback, or null if the request
+  *   should be appended to the completion queue of the client.
+  * \param[in] user_data The user data passed to the callback.
+  */
+void epos_sdo_request_init_write(
+  epos_sdo_request_t* request,
+  epos_device_t* dev,
+  short index,
+  unsigned char subindex,
+  unsigned char* data,
+  size_t num,
+  epos_sdo_callback_t callback,
+  void* user_data);
+
+/** \brief Compute the CRC of EPOS SDO block transfer data
+  * \param[in] data The block transfer data to compute the CRC for.
+  * \param[in] num The size of the data in [B].
+  * \param[in] crc The CRC of any preceding data, or zero.
+  * \return The CRC-16-CCITT of the data as specified by CiA 301.
+  */
+unsigned short epos_sdo_crc(
+  const unsigned char* data,
+  size_t num,
+  unsigned short crc);
+
+/** \brief Initialize EPOS SDO client
+  * \param[in] client The EPOS SDO client to be initialized.
+  * \param[in] can_dev The CAN device used by the client.
+  * \param[in] timeout The SDO transfer timeout in [s].
+  */
+void epos_sdo_client_init(
+  epos_sdo_client_t* client,
+  can_device_t* can_dev,
+  double timeout);
+
+/** \brief Destroy EPOS SDO client
+  * \param[in] client The EPOS SDO client to be destroyed.
+  */
+void epos_sdo_client_destroy(
+  epos_sdo_client_t* client);
+
+/** \brief Submit an EPOS SDO request
+  * \param[in] client The EPOS SDO client to submit the request to.
+  * \param[in] request The initialized EPOS SDO request to be submitted.
+  * \return The resulting error code.
+  * 
+  * The request will be sent immediately if no other request is in flight
+  * for its node. Otherwise, it will be queued until the node becomes idle.
+  * Read requests which can be served from the object dictionary cache of
+  * the device complete immediately.
+  */
+int epos_sdo_submit(
+  epos_sdo_client_t* client,
+  epos_sdo_request_t* request);
+
+/** \brief Process EPOS SDO responses
+  * \param[in] client The EPOS SDO client to process responses for.
+  * \return The resulting error code.
+  * 
+  * This function dispatches a single CAN message on the bus of the
+  * client and completes the matching outstanding request. Requests whose
+  * timeout has expired are aborted and, if the retry policy of their
+  * device permits (see epos_device_get_retry_delay()), resent once the
+  * retry delay has elapsed. Otherwise, they fail with a timeout.
+  */
+int epos_sdo_process(
+  epos_sdo_client_t* client);
+
+/** \brief Wait for all EPOS SDO requests to complete
+  * \param[in] client The EPOS SDO client to wait for.
+  * \return The resulting error code.
+  */
+int epos_sdo_wait(
+  epos_sdo_client_t* client);
+
+/** \brief Transfer a batch of EPOS SDO requests
+  * \param[in] client The EPOS SDO client to transfer the requests with.
+  * \param[in] requests The array of initialized EPOS SDO requests to be
+  *   transferred.
+  * \param[in] num_requests The number of requests in the array.
+  * \return The resulting error code. If any request of the batch failed,
+  *   the error of the first failed request is reported.
+  * 
+  * All requests are submitted as a single burst, and the function returns
+  * when all requests in flight have completed. Requests to the same node
+  * are transferred back to back in order of the array, requests to
+  * different nodes are interleaved. Requests of the batch are removed
+  * from the completion queue of the client.
+  */
+int epos_sdo_transfer(
+  epos_sdo_client_t* client,
+  epos_sdo_request_t* requests,
+  size_t num_requests);
+
+/** \brief Poll the EPOS SDO completion queue
+  * \param[in] client The EPOS SDO client to poll the completion queue for.
+  * \return The least recently completed request, or null if the
+  *   completion queue is empty.
+  */
+epos_sdo_request_t* epos_sdo_poll(
+  epos_sdo_client_t* client);
+
+#endif
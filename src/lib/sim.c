@@ -0,0 +1,1295 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "sim.h"
+#include "macros.h"
+#include "sdo.h"
+#include "sync.h"
+#include "clock.h"
+#include "control.h"
+#include "error.h"
+#include "sensor.h"
+#include "current.h"
+#include "position.h"
+#include "velocity.h"
+#include "home.h"
+#include "position_profile.h"
+#include "velocity_profile.h"
+#include "interpolated_position.h"
+
+const char* epos_sim_errors[] = {
+  "Success",
+  "Simulator receive timeout",
+  "Invalid simulated node",
+  "Failed to allocate simulated node",
+};
+
+const epos_sim_default_t epos_sim_defaults[] = {
+  {0x1000, 0x00, 4, 0x00020192},
+  {0x1001, 0x00, 1, 0x00},
+  {0x1003, 0x00, 1, 0},
+  {0x1003, 0x01, 4, 0},
+  {0x1003, 0x02, 4, 0},
+  {0x1003, 0x03, 4, 0},
+  {0x1003, 0x04, 4, 0},
+  {0x1003, 0x05, 4, 0},
+  {0x1005, 0x00, 4, 0x00000080},
+  {0x1010, 0x01, 4, 0},
+  {0x1011, 0x01, 4, 0},
+  {0x1017, 0x00, 2, 0},
+  {0x2001, 0x00, 2, 0},
+  {0x2002, 0x00, 2, 5},
+  {0x2003, 0x01, 2, 0x2126},
+  {0x2003, 0x02, 2, 0x6220},
+  {0x2008, 0x00, 2, 0},
+  {0x2020, 0x00, 2, 0},
+  {0x2027, 0x00, 2, 0},
+  {0x2028, 0x00, 4, 0},
+  {0x2030, 0x00, 2, 0},
+  {0x2062, 0x00, 4, 0},
+  {0x206B, 0x00, 4, 0},
+  {0x2070, 0x01, 2, 0xFFFF},
+  {0x2070, 0x02, 2, 0xFFFF},
+  {0x2070, 0x03, 2, 0xFFFF},
+  {0x2070, 0x04, 2, 0xFFFF},
+  {0x2070, 0x05, 2, 0xFFFF},
+  {0x2070, 0x06, 2, 0xFFFF},
+  {0x2070, 0x07, 2, 0xFFFF},
+  {0x2070, 0x08, 2, 0xFFFF},
+  {0x2070, 0x09, 2, 0xFFFF},
+  {0x2070, 0x0A, 2, 0xFFFF},
+  {0x2071, 0x01, 2, 0},
+  {0x2071, 0x02, 2, 0},
+  {0x2071, 0x03, 2, 0},
+  {0x2071, 0x04, 2, 0},
+  {0x2080, 0x00, 2, 500},
+  {0x2081, 0x00, 4, 0},
+  {0x20C1, 0x00, 8, 0},
+  {0x20C4, 0x01, 2, 0},
+  {0x20C4, 0x02, 2, 0},
+  {0x20C4, 0x03, 2, EPOS_SIM_BUFFER_SIZE},
+  {0x2210, 0x01, 4, 500},
+  {0x2210, 0x02, 2, 1},
+  {0x2210, 0x04, 2, 0},
+  {0x6040, 0x00, 2, 0},
+  {0x6041, 0x00, 2, EPOS_SIM_STATUS_SWITCH_ON_DISABLED},
+  {0x6060, 0x00, 1, EPOS_SIM_MODE_PROFILE_POSITION},
+  {0x6061, 0x00, 1, EPOS_SIM_MODE_PROFILE_POSITION},
+  {0x6062, 0x00, 4, 0},
+  {0x6064, 0x00, 4, 0},
+  {0x6065, 0x00, 4, 2000},
+  {0x606B, 0x00, 4, 0},
+  {0x606C, 0x00, 4, 0},
+  {0x6078, 0x00, 2, 0},
+  {0x607A, 0x00, 4, 0},
+  {0x607C, 0x00, 4, 0},
+  {0x607D, 0x01, 4, INT_MIN},
+  {0x607D, 0x02, 4, INT_MAX},
+  {0x607F, 0x00, 4, 25000},
+  {0x6081, 0x00, 4, 1000},
+  {0x6083, 0x00, 4, 10000},
+  {0x6084, 0x00, 4, 10000},
+  {0x6085, 0x00, 4, 10000},
+  {0x6086, 0x00, 2, 0},
+  {0x6098, 0x00, 1, 7},
+  {0x6099, 0x01, 4, 100},
+  {0x6099, 0x02, 4, 10},
+  {0x609A, 0x00, 4, 1000},
+  {0x60C0, 0x00, 2, EPOS_INTERPOLATED_POSITION_SUBMODE_PVT},
+  {0x60C4, 0x01, 4, EPOS_SIM_BUFFER_SIZE},
+  {0x60C4, 0x02, 4, EPOS_SIM_BUFFER_SIZE},
+  {0x60C4, 0x03, 1, 0},
+  {0x60C4, 0x04, 2, 0},
+  {0x60C4, 0x05, 1, EPOS_INTERPOLATED_POSITION_RECORD_SIZE},
+  {0x60C4, 0x06, 1, 0},
+  {0x60C5, 0x00, 4, 10000},
+  {0x60F6, 0x01, 2, 0},
+  {0x60F6, 0x02, 2, 0},
+  {0x60F9, 0x01, 2, 0},
+  {0x60F9, 0x02, 2, 0},
+  {0x60FB, 0x01, 2, 0},
+  {0x60FB, 0x02, 2, 0},
+  {0x60FB, 0x03, 2, 0},
+  {0x60FB, 0x04, 2, 0},
+  {0x60FB, 0x05, 2, 0},
+  {0x60FF, 0x00, 4, 0},
+  {0x6402, 0x00, 2, 1},
+  {0x6410, 0x01, 2, 5000},
+  {0x6410, 0x02, 2, 10000},
+  {0x6410, 0x03, 1, 1},
+  {0x6410, 0x04, 4, 25000},
+  {0x6410, 0x05, 2, 40},
+};
+
+void epos_sim_init(epos_sim_t* sim);
+void epos_sim_destroy(void* data);
+void epos_sim_advance(epos_sim_t* sim, double time);
+void epos_sim_push(epos_sim_t* sim, const can_message_t* message);
+int epos_sim_pop(epos_sim_t* sim, can_message_t* message);
+epos_sim_node_t* epos_sim_get_gateway(epos_sim_t* sim);
+
+int epos_sim_open(void* data);
+int epos_sim_close(void* data);
+int epos_sim_send(void* data, const can_message_t* message);
+int epos_sim_receive(void* data, can_message_t* message);
+
+int epos_sim_node_init(epos_sim_node_t* node, int node_id);
+void epos_sim_node_destroy(epos_sim_node_t* node);
+int epos_sim_node_restore(epos_sim_node_t* node, int communication);
+int epos_sim_node_define(epos_sim_node_t* node, short index, unsigned char
+  subindex, size_t size, int value);
+epos_sim_object_t* epos_sim_node_find(epos_sim_node_t* node, short index,
+  unsigned char subindex);
+int epos_sim_node_get(epos_sim_node_t* node, short index, unsigned char
+  subindex);
+void epos_sim_node_set(epos_sim_node_t* node, short index, unsigned char
+  subindex, int value);
+void epos_sim_node_write(epos_sim_t* sim, epos_sim_node_t* node,
+  epos_sim_object_t* object, const unsigned char* data, size_t num);
+void epos_sim_node_control(epos_sim_t* sim, epos_sim_node_t* node,
+  unsigned short control);
+void epos_sim_node_start(epos_sim_node_t* node, unsigned short control);
+void epos_sim_node_fault(epos_sim_t* sim, epos_sim_node_t* node, short code);
+void epos_sim_node_emergency(epos_sim_t* sim, epos_sim_node_t* node,
+  short code);
+void epos_sim_node_step(epos_sim_node_t* node, double period);
+void epos_sim_node_accelerate(epos_sim_node_t* node, double velocity,
+  double acceleration, double deceleration, double period);
+int epos_sim_node_move(epos_sim_node_t* node, double position, double
+  velocity, double acceleration, double deceleration, double period);
+void epos_sim_node_interpolate(epos_sim_node_t* node, double period);
+void epos_sim_node_update(epos_sim_t* sim, epos_sim_node_t* node);
+double epos_sim_node_get_scale(epos_sim_node_t* node);
+unsigned short epos_sim_node_get_status(epos_sim_node_t* node);
+void epos_sim_node_clear_buffer(epos_sim_node_t* node, int enable);
+void epos_sim_node_receive_nmt(epos_sim_t* sim, epos_sim_node_t* node,
+  unsigned char command);
+void epos_sim_node_receive_sdo(epos_sim_t* sim, epos_sim_node_t* node,
+  const can_message_t* message);
+void epos_sim_node_receive_pdo(epos_sim_t* sim, epos_sim_node_t* node,
+  const can_message_t* message);
+void epos_sim_node_receive_sync(epos_sim_t* sim, epos_sim_node_t* node);
+size_t epos_sim_node_compose_pdo(epos_sim_node_t* node, int number,
+  can_message_t* message);
+void epos_sim_node_abort(epos_sim_t* sim, epos_sim_node_t* node, short
+  index, unsigned char subindex, unsigned int code);
+
+epos_sim_t* epos_sim_attach(epos_bus_t* bus, int node_id) {
+  epos_sim_node_t* node;
+  epos_sim_t* sim;
+  
+  if (!node_id)
+    node_id = EPOS_SIM_NODE_ID_DEFAULT;
+  
+  if (bus->transport.send != epos_sim_send) {
+    epos_bus_transport_t transport;
+    
+    if (!(sim = malloc(sizeof(epos_sim_t))))
+      return 0;
+    epos_sim_init(sim);
+    
+    transport.data = sim;
+    transport.error = &sim->error;
+    transport.open = epos_sim_open;
+    transport.close = epos_sim_close;
+    transport.send = epos_sim_send;
+    transport.receive = epos_sim_receive;
+    transport.destroy = epos_sim_destroy;
+    
+    epos_bus_set_transport(bus, &transport);
+  }
+  else
+    sim = bus->transport.data;
+  
+  pthread_mutex_lock(&sim->mutex);
+  if (!sim->nodes[node_id] && (node = malloc(sizeof(epos_sim_node_t)))) {
+    if (epos_sim_node_init(node, node_id)) {
+      epos_sim_node_destroy(node);
+      free(node);
+      node = 0;
+    }
+    sim->nodes[node_id] = node;
+  }
+  if (!sim->nodes[node_id])
+    error_setf(&sim->error, EPOS_SIM_ERROR_ALLOCATION, "Node 0x%X",
+      node_id);
+  pthread_mutex_unlock(&sim->mutex);
+  
+  return sim->nodes[node_id] ? sim : 0;
+}
+
+void epos_sim_step(epos_sim_t* sim, double time) {
+  pthread_mutex_lock(&sim->mutex);
+  epos_sim_advance(sim, time);
+  pthread_mutex_unlock(&sim->mutex);
+}
+
+int epos_sim_set_fault(epos_sim_t* sim, int node_id, short code) {
+  int result = EPOS_SIM_ERROR_NONE;
+  
+  pthread_mutex_lock(&sim->mutex);
+  
+  if ((node_id > 0) && (node_id <= CAN_NODE_ID_MAX) && sim->nodes[node_id])
+    epos_sim_node_fault(sim, sim->nodes[node_id], code);
+  else
+    result = EPOS_SIM_ERROR_INVALID_NODE;
+  
+  pthread_mutex_unlock(&sim->mutex);
+  
+  return result;
+}
+
+void epos_sim_init(epos_sim_t* sim) {
+  memset(sim->nodes, 0, sizeof(sim->nodes));
+  
+  sim->first = 0;
+  sim->num_messages = 0;
+  sim->num_dropped = 0;
+  
+  pthread_mutex_init(&sim->mutex, NULL);
+  
+  error_init(&sim->error, epos_sim_errors);
+}
+
+void epos_sim_destroy(void* data) {
+  epos_sim_t* sim = data;
+  int node_id;
+  
+  for (node_id = 0; node_id <= CAN_NODE_ID_MAX; ++node_id)
+    if (sim->nodes[node_id]) {
+      epos_sim_node_destroy(sim->nodes[node_id]);
+      free(sim->nodes[node_id]);
+    }
+  
+  pthread_mutex_destroy(&sim->mutex);
+  error_destroy(&sim->error);
+  
+  free(sim);
+}
+
+void epos_sim_advance(epos_sim_t* sim, double time) {
+  int node_id;
+  
+  for (node_id = 1; node_id <= CAN_NODE_ID_MAX; ++node_id) {
+    epos_sim_node_t* node = sim->nodes[node_id];
+    
+    if (node) {
+      if (time-node->time > EPOS_SIM_MAX_STEP_TIME)
+        node->time = time-EPOS_SIM_MAX_STEP_TIME;
+      
+      while (node->time+EPOS_SIM_STEP_PERIOD <= time) {
+        epos_sim_node_step(node, EPOS_SIM_STEP_PERIOD);
+        node->time += EPOS_SIM_STEP_PERIOD;
+      }
+      
+      epos_sim_node_update(sim, node);
+    }
+  }
+}
+
+void epos_sim_push(epos_sim_t* sim, const can_message_t* message) {
+  if (sim->num_messages == EPOS_SIM_QUEUE_SIZE) {
+    sim->first = (sim->first+1) % EPOS_SIM_QUEUE_SIZE;
+    --sim->num_messages;
+    ++sim->num_dropped;
+  }
+  
+  sim->messages[(sim->first+sim->num_messages) % EPOS_SIM_QUEUE_SIZE] =
+    *message;
+  ++sim->num_messages;
+}
+
+int epos_sim_pop(epos_sim_t* sim, can_message_t* message) {
+  if (sim->num_messages) {
+    *message = sim->messages[sim->first];
+    
+    sim->first = (sim->first+1) % EPOS_SIM_QUEUE_SIZE;
+    --sim->num_messages;
+    
+    return 1;
+  }
+  else
+    return 0;
+}
+
+epos_sim_node_t* epos_sim_get_gateway(epos_sim_t* sim) {
+  int node_id;
+  
+  for (node_id = 1; node_id <= CAN_NODE_ID_MAX; ++node_id)
+    if (sim->nodes[node_id])
+      return sim->nodes[node_id];
+  
+  return 0;
+}
+
+int epos_sim_open(void* data) {
+  return EPOS_SIM_ERROR_NONE;
+}
+
+int epos_sim_close(void* data) {
+  return EPOS_SIM_ERROR_NONE;
+}
+
+int epos_sim_send(void* data, const can_message_t* message) {
+  epos_sim_t* sim = data;
+  int node_id = message->id & EPOS_BUS_COB_ID_NODE_MASK;
+  int function = message->id & EPOS_BUS_COB_ID_FUNCTION_MASK;
+  epos_sim_node_t* node;
+  
+  pthread_mutex_lock(&sim->mutex);
+  
+  error_clear(&sim->error);
+  epos_sim_advance(sim, epos_clock_get());
+  
+  if (message->id == CAN_COB_NMT_SEND) {
+    for (node_id = 1; node_id <= CAN_NODE_ID_MAX; ++node_id)
+      if (sim->nodes[node_id] && ((message->content[1] == node_id) ||
+          (message->content[1] == CAN_NODE_ID_BROADCAST)))
+        epos_sim_node_receive_nmt(sim, sim->nodes[node_id],
+          message->content[0]);
+  }
+  else if (message->id == EPOS_SYNC_COB_ID) {
+    for (node_id = 1; node_id <= CAN_NODE_ID_MAX; ++node_id)
+      if (sim->nodes[node_id])
+        epos_sim_node_receive_sync(sim, sim->nodes[node_id]);
+  }
+  else if (function == CAN_COB_ID_SDO_SEND) {
+    node = node_id ? sim->nodes[node_id] : epos_sim_get_gateway(sim);
+    
+    if (node && (node->nmt_state != EPOS_SIM_NMT_STOPPED))
+      epos_sim_node_receive_sdo(sim, node, message);
+  }
+  else if ((message->id >= EPOS_PDO_COB_ID_MIN) &&
+      (message->id <= EPOS_PDO_COB_ID_MAX)) {
+    for (node_id = 1; node_id <= CAN_NODE_ID_MAX; ++node_id)
+      if (sim->nodes[node_id])
+        epos_sim_node_receive_pdo(sim, sim->nodes[node_id], message);
+  }
+  
+  pthread_mutex_unlock(&sim->mutex);
+  
+  return EPOS_SIM_ERROR_NONE;
+}
+
+int epos_sim_receive(void* data, can_message_t* message) {
+  epos_sim_t* sim = data;
+  double start_time = epos_clock_get(), time = start_time;
+  int result = EPOS_SIM_ERROR_NONE;
+  
+  pthread_mutex_lock(&sim->mutex);
+  
+  epos_sim_advance(sim, time);
+  while (!epos_sim_pop(sim, message)) {
+    if (time-start_time > EPOS_SIM_RECEIVE_TIMEOUT) {
+      error_set(&sim->error, EPOS_SIM_ERROR_TIMEOUT);
+      result = sim->error.code;
+      
+      break;
+    }
+    
+    pthread_mutex_unlock(&sim->mutex);
+    epos_clock_sleep(EPOS_SIM_STEP_PERIOD);
+    pthread_mutex_lock(&sim->mutex);
+    
+    time = epos_clock_get();
+    epos_sim_advance(sim, time);
+  }
+  
+  pthread_mutex_unlock(&sim->mutex);
+  
+  return result;
+}
+
+int epos_sim_node_init(epos_sim_node_t* node, int node_id) {
+  node->node_id = node_id;
+  
+  node->objects = 0;
+  node->num_objects = 0;
+  
+  node->position = 0.0;
+  node->time = epos_clock_get();
+  
+  node->nmt_state = EPOS_SIM_NMT_PRE_OPERATIONAL;
+  return epos_sim_node_restore(node, 0);
+}
+
+void epos_sim_node_destroy(epos_sim_node_t* node) {
+  if (node->num_objects) {
+    free(node->objects);
+    
+    node->objects = 0;
+    node->num_objects = 0;
+  }
+}
+
+int epos_sim_node_restore(epos_sim_node_t* node, int communication) {
+  int result = EPOS_SIM_ERROR_NONE;
+  int i, j;
+  
+  for (i = 0; i < sizeof(epos_sim_defaults)/sizeof(epos_sim_default_t);
+      ++i)
+    if ((!communication || (epos_sim_defaults[i].index < 0x2000)) &&
+        epos_sim_node_define(node, epos_sim_defaults[i].index,
+          epos_sim_defaults[i].subindex, epos_sim_defaults[i].size,
+          epos_sim_defaults[i].value))
+      result = EPOS_SIM_ERROR_ALLOCATION;
+  
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i) {
+    if (epos_sim_node_define(node, EPOS_PDO_INDEX_RECEIVE_PARAMETERS+i,
+        EPOS_PDO_SUBINDEX_COB_ID, sizeof(int), EPOS_PDO_COB_ID_RECEIVE+
+        i*EPOS_PDO_COB_ID_OFFSET+node->node_id))
+      result = EPOS_SIM_ERROR_ALLOCATION;
+    if (epos_sim_node_define(node, EPOS_PDO_INDEX_RECEIVE_PARAMETERS+i,
+        EPOS_PDO_SUBINDEX_TRANSMISSION_TYPE, 1,
+        EPOS_PDO_TRANSMISSION_ASYNCHRONOUS))
+      result = EPOS_SIM_ERROR_ALLOCATION;
+    if (epos_sim_node_define(node, EPOS_PDO_INDEX_TRANSMIT_PARAMETERS+i,
+        EPOS_PDO_SUBINDEX_COB_ID, sizeof(int), EPOS_PDO_COB_ID_TRANSMIT+
+        i*EPOS_PDO_COB_ID_OFFSET+node->node_id))
+      result = EPOS_SIM_ERROR_ALLOCATION;
+    if (epos_sim_node_define(node, EPOS_PDO_INDEX_TRANSMIT_PARAMETERS+i,
+        EPOS_PDO_SUBINDEX_TRANSMISSION_TYPE, 1,
+        EPOS_PDO_TRANSMISSION_ASYNCHRONOUS))
+      result = EPOS_SIM_ERROR_ALLOCATION;
+    if (epos_sim_node_define(node, EPOS_PDO_INDEX_TRANSMIT_PARAMETERS+i,
+        EPOS_PDO_SUBINDEX_INHIBIT_TIME, sizeof(short), 0))
+      result = EPOS_SIM_ERROR_ALLOCATION;
+    
+    for (j = 0; j <= EPOS_PDO_MAX_MAPPINGS; ++j) {
+      if (epos_sim_node_define(node, EPOS_PDO_INDEX_RECEIVE_MAPPING+i, j,
+          j ? sizeof(int) : 1, 0))
+        result = EPOS_SIM_ERROR_ALLOCATION;
+      if (epos_sim_node_define(node, EPOS_PDO_INDEX_TRANSMIT_MAPPING+i, j,
+          j ? sizeof(int) : 1, 0))
+        result = EPOS_SIM_ERROR_ALLOCATION;
+    }
+    
+    node->tpdo_time[i] = 0.0;
+    memset(&node->tpdo_messages[i], 0, sizeof(can_message_t));
+  }
+  node->heartbeat_time = node->time;
+  node->num_syncs = 0;
+  node->transfer = 0;
+  
+  if (!communication) {
+    if (epos_sim_node_define(node, EPOS_DEVICE_INDEX_ID, 0, 1, node->node_id))
+      result = EPOS_SIM_ERROR_ALLOCATION;
+    
+    node->state = epos_sim_switch_on_disabled;
+    node->control = 0;
+    node->homed = 0;
+    node->reached = 0;
+    node->active = 0;
+    
+    node->velocity = 0.0;
+    node->target_position = node->position;
+    node->target_velocity = 0.0;
+    node->start_time = 0.0;
+    
+    epos_sim_node_clear_buffer(node, 0);
+  }
+  
+  return result;
+}
+
+int epos_sim_node_define(epos_sim_node_t* node, short index, unsigned char
+    subindex, size_t size, int value) {
+  epos_sim_object_t* object = epos_sim_node_find(node, index, subindex);
+  epos_sim_object_t* objects;
+  
+  if (!object) {
+    if (!(objects = realloc(node->objects, (node->num_objects+1)*
+        sizeof(epos_sim_object_t))))
+      return EPOS_SIM_ERROR_ALLOCATION;
+    node->objects = objects;
+    object = &node->objects[node->num_objects];
+    ++node->num_objects;
+    
+    object->index = index;
+    object->subindex = subindex;
+  }
+  
+  object->size = size;
+  memset(object->data, 0, sizeof(object->data));
+  memcpy(object->data, &value, (size < sizeof(int)) ? size : sizeof(int));
+  
+  return EPOS_SIM_ERROR_NONE;
+}
+
+epos_sim_object_t* epos_sim_node_find(epos_sim_node_t* node, short index,
+    unsigned char subindex) {
+  int i;
+  
+  for (i = 0; i < node->num_objects; ++i)
+    if ((node->objects[i].index == index) &&
+        (node->objects[i].subindex == subindex))
+      return &node->objects[i];
+  
+  return 0;
+}
+
+int epos_sim_node_get(epos_sim_node_t* node, short index, unsigned char
+    subindex) {
+  epos_sim_object_t* object = epos_sim_node_find(node, index, subindex);
+  int value = 0;
+  
+  if (object) {
+    if (object->size == 1)
+      value = (signed char)object->data[0];
+    else if (object->size == 2)
+      value = (short)(object->data[0]+(object->data[1] << 8));
+    else
+      memcpy(&value, object->data, sizeof(int));
+  }
+  
+  return value;
+}
+
+void epos_sim_node_set(epos_sim_node_t* node, short index, unsigned char
+    subindex, int value) {
+  epos_sim_object_t* object = epos_sim_node_find(node, index, subindex);
+  
+  if (object)
+    memcpy(object->data, &value, (object->size < sizeof(int)) ?
+      object->size : sizeof(int));
+}
+
+void epos_sim_node_write(epos_sim_t* sim, epos_sim_node_t* node,
+    epos_sim_object_t* object, const unsigned char* data, size_t num) {
+  memset(object->data, 0, sizeof(object->data));
+  memcpy(object->data, data, (num < object->size) ? num : object->size);
+  
+  switch (object->index) {
+    case EPOS_DEVICE_INDEX_CONTROL:
+      epos_sim_node_control(sim, node, epos_sim_node_get(node,
+        EPOS_DEVICE_INDEX_CONTROL, 0));
+      break;
+    case EPOS_CONTROL_INDEX_MODE:
+      epos_sim_node_set(node, EPOS_CONTROL_INDEX_MODE_DISPLAY, 0,
+        epos_sim_node_get(node, EPOS_CONTROL_INDEX_MODE, 0));
+      break;
+    case EPOS_INTERPOLATED_POSITION_INDEX_DATA: {
+      unsigned short status = epos_sim_node_get(node,
+        EPOS_INTERPOLATED_POSITION_INDEX_BUFFER,
+        EPOS_INTERPOLATED_POSITION_SUBINDEX_STATUS);
+      
+      if (!(status & EPOS_INTERPOLATED_POSITION_BUFFER_ENABLED))
+        break;
+      else if (node->buffer_num_records == EPOS_SIM_BUFFER_SIZE)
+        status |= EPOS_INTERPOLATED_POSITION_BUFFER_OVERFLOW_ERROR;
+      else {
+        epos_sim_record_t* record = &node->buffer[(node->buffer_first+
+          node->buffer_num_records) % EPOS_SIM_BUFFER_SIZE];
+        
+        memcpy(&record->position, &object->data[0], sizeof(int));
+        record->velocity = object->data[4]+(object->data[5] << 8)+
+          (object->data[6] << 16);
+        if (record->velocity & 0x800000)
+          record->velocity -= 0x1000000;
+        record->time = object->data[7];
+        ++node->buffer_num_records;
+      }
+      
+      epos_sim_node_set(node, EPOS_INTERPOLATED_POSITION_INDEX_BUFFER,
+        EPOS_INTERPOLATED_POSITION_SUBINDEX_STATUS, status);
+      break;
+    }
+    case EPOS_INTERPOLATED_POSITION_INDEX_CONFIGURATION:
+      if (object->subindex ==
+          EPOS_INTERPOLATED_POSITION_SUBINDEX_BUFFER_CLEAR)
+        epos_sim_node_clear_buffer(node, object->data[0]);
+      break;
+  }
+}
+
+void epos_sim_node_control(epos_sim_t* sim, epos_sim_node_t* node,
+    unsigned short control) {
+  unsigned short rising = control & ~node->control;
+  epos_sim_state_t state = node->state;
+  
+  node->control = control;
+  
+  if (node->state == epos_sim_fault) {
+    if (rising & EPOS_SIM_CONTROL_FAULT_RESET) {
+      node->state = epos_sim_switch_on_disabled;
+      epos_sim_node_set(node, EPOS_DEVICE_INDEX_ERROR_REGISTER, 0, 0);
+      epos_sim_node_emergency(sim, node, 0);
+    }
+    
+    return;
+  }
+  
+  if (!(control & EPOS_SIM_CONTROL_ENABLE_VOLTAGE))
+    node->state = epos_sim_switch_on_disabled;
+  else if (!(control & EPOS_SIM_CONTROL_QUICK_STOP)) {
+    if ((node->state == epos_sim_operation_enabled) ||
+        (node->state == epos_sim_quick_stop_active))
+      node->state = epos_sim_quick_stop_active;
+    else
+      node->state = epos_sim_switch_on_disabled;
+  }
+  else if (!(control & EPOS_SIM_CONTROL_SWITCH_ON)) {
+    if (node->state != epos_sim_quick_stop_active)
+      node->state = epos_sim_ready_to_switch_on;
+  }
+  else if (!(control & EPOS_SIM_CONTROL_ENABLE_OPERATION)) {
+    if ((node->state == epos_sim_ready_to_switch_on) ||
+        (node->state == epos_sim_operation_enabled))
+      node->state = epos_sim_switched_on;
+  }
+  else if (node->state != epos_sim_switch_on_disabled)
+    node->state = epos_sim_operation_enabled;
+  
+  if (node->state == epos_sim_operation_enabled) {
+    if (state != epos_sim_operation_enabled) {
+      node->target_position = node->position;
+      node->target_velocity = 0.0;
+      node->reached = 1;
+    }
+    
+    if (rising & EPOS_SIM_CONTROL_NEW_SETPOINT)
+      epos_sim_node_start(node, control);
+  }
+  else {
+    node->active = 0;
+    if (node->state != epos_sim_quick_stop_active)
+      node->velocity = 0.0;
+  }
+}
+
+void epos_sim_node_start(epos_sim_node_t* node, unsigned short control) {
+  int target;
+  
+  switch (epos_sim_node_get(node, EPOS_CONTROL_INDEX_MODE_DISPLAY, 0)) {
+    case EPOS_SIM_MODE_HOMING:
+      node->homed = 0;
+      node->start_time = node->time;
+      break;
+    case EPOS_SIM_MODE_PROFILE_POSITION:
+      target = epos_sim_node_get(node, EPOS_POSITION_PROFILE_INDEX_TARGET, 0);
+      if (control & EPOS_SIM_CONTROL_RELATIVE)
+        node->target_position += target;
+      else
+        node->target_position = target;
+      break;
+    case EPOS_SIM_MODE_INTERPOLATED_POSITION:
+      if (!node->buffer_num_records)
+        return;
+      node->position = node->buffer[node->buffer_first].position;
+      node->segment_time = 0.0;
+      break;
+    default:
+      return;
+  }
+  
+  node->active = 1;
+  node->reached = 0;
+}
+
+void epos_sim_node_fault(epos_sim_t* sim, epos_sim_node_t* node, short
+    code) {
+  int i, num_errors = epos_sim_node_get(node, EPOS_ERROR_INDEX_HISTORY,
+    EPOS_ERROR_SUBINDEX_HISTORY_LENGTH) & 0xFF;
+  
+  node->state = epos_sim_fault;
+  node->active = 0;
+  node->velocity = 0.0;
+  
+  for (i = min(num_errors, 4); i > 0; --i)
+    epos_sim_node_set(node, EPOS_ERROR_INDEX_HISTORY, i+1,
+      epos_sim_node_get(node, EPOS_ERROR_INDEX_HISTORY, i));
+  epos_sim_node_set(node, EPOS_ERROR_INDEX_HISTORY,
+    EPOS_ERROR_SUBINDEX_HISTORY_ENTRIES, (unsigned short)code);
+  epos_sim_node_set(node, EPOS_ERROR_INDEX_HISTORY,
+    EPOS_ERROR_SUBINDEX_HISTORY_LENGTH, min(num_errors+1, 5));
+  epos_sim_node_set(node, EPOS_DEVICE_INDEX_ERROR_REGISTER, 0, 0x01);
+  
+  epos_sim_node_emergency(sim, node, code);
+}
+
+void epos_sim_node_emergency(epos_sim_t* sim, epos_sim_node_t* node,
+    short code) {
+  can_message_t message;
+  
+  memset(&message, 0, sizeof(can_message_t));
+  message.id = CAN_COB_ID_SDO_EMERGENCY+node->node_id;
+  message.content[0] = code;
+  message.content[1] = code >> 8;
+  message.content[2] = epos_sim_node_get(node,
+    EPOS_DEVICE_INDEX_ERROR_REGISTER, 0);
+  message.length = 8;
+  
+  epos_sim_push(sim, &message);
+}
+
+void epos_sim_node_step(epos_sim_node_t* node, double period) {
+  double scale = epos_sim_node_get_scale(node);
+  double acceleration = epos_sim_node_get(node,
+    EPOS_PROFILE_INDEX_ACCELERATION, 0)*scale;
+  double deceleration = epos_sim_node_get(node,
+    EPOS_PROFILE_INDEX_DECELERATION, 0)*scale;
+  double position;
+  
+  if (node->state == epos_sim_quick_stop_active) {
+    epos_sim_node_accelerate(node, 0.0, 0.0, epos_sim_node_get(node,
+      EPOS_PROFILE_INDEX_QUICKSTOP_DECELERATION, 0)*scale, period);
+    return;
+  }
+  else if (node->state != epos_sim_operation_enabled)
+    return;
+  
+  switch (epos_sim_node_get(node, EPOS_CONTROL_INDEX_MODE_DISPLAY, 0)) {
+    case EPOS_SIM_MODE_HOMING:
+      if (node->active && (node->time-node->start_time >=
+          EPOS_SIM_HOMING_TIME)) {
+        node->position = epos_sim_node_get(node, EPOS_HOME_INDEX_POSITION, 0);
+        node->target_position = node->position;
+        node->velocity = 0.0;
+        node->homed = 1;
+        node->active = 0;
+        node->reached = 1;
+      }
+      break;
+    case EPOS_SIM_MODE_PROFILE_POSITION:
+      if (node->control & EPOS_SIM_CONTROL_HALT)
+        epos_sim_node_accelerate(node, 0.0, acceleration, deceleration,
+          period);
+      else if (node->active && epos_sim_node_move(node,
+          node->target_position, epos_sim_node_get(node,
+          EPOS_POSITION_PROFILE_INDEX_VELOCITY, 0)*scale, acceleration,
+          deceleration, period)) {
+        node->active = 0;
+        node->reached = 1;
+      }
+      break;
+    case EPOS_SIM_MODE_PROFILE_VELOCITY:
+      node->target_velocity = (node->control & EPOS_SIM_CONTROL_HALT) ? 0.0 :
+        epos_sim_node_get(node, EPOS_VELOCITY_PROFILE_INDEX_TARGET, 0)*scale;
+      epos_sim_node_accelerate(node, node->target_velocity, acceleration,
+        deceleration, period);
+      node->reached = (node->velocity == node->target_velocity);
+      break;
+    case EPOS_SIM_MODE_POSITION:
+      position = epos_sim_node_get(node, EPOS_POSITION_INDEX_SETTING_VALUE, 0);
+      node->velocity = (position-node->position)/period;
+      node->position = position;
+      break;
+    case EPOS_SIM_MODE_VELOCITY:
+      node->velocity = epos_sim_node_get(node,
+        EPOS_VELOCITY_INDEX_SETTING_VALUE, 0)*scale;
+      node->position += node->velocity*period;
+      break;
+    case EPOS_SIM_MODE_INTERPOLATED_POSITION:
+      if (node->active)
+        epos_sim_node_interpolate(node, period);
+      break;
+  }
+}
+
+void epos_sim_node_accelerate(epos_sim_node_t* node, double velocity,
+    double acceleration, double deceleration, double period) {
+  double delta = velocity-node->velocity;
+  double rate = ((velocity*node->velocity >= 0.0) &&
+    (fabs(velocity) > fabs(node->velocity))) ? acceleration : deceleration;
+  
+  if (fabs(delta) <= rate*period)
+    node->velocity = velocity;
+  else
+    node->velocity += copysign(rate*period, delta);
+  
+  node->position += node->velocity*period;
+}
+
+int epos_sim_node_move(epos_sim_node_t* node, double position, double
+    velocity, double acceleration, double deceleration, double period) {
+  double distance = position-node->position;
+  double stop_distance = (deceleration > 0.0) ?
+    0.5*node->velocity*node->velocity/deceleration : 0.0;
+  
+  if ((fabs(distance) < 0.5) && (fabs(node->velocity) <=
+      deceleration*period)) {
+    node->position = position;
+    node->velocity = 0.0;
+    
+    return 1;
+  }
+  
+  if ((node->velocity*distance > 0.0) && (stop_distance >= fabs(distance)))
+    epos_sim_node_accelerate(node, 0.0, acceleration, deceleration, period);
+  else
+    epos_sim_node_accelerate(node, copysign(velocity, distance),
+      acceleration, deceleration, period);
+  
+  if ((position-node->position)*distance < 0.0) {
+    node->position = position;
+    node->velocity = 0.0;
+    
+    return 1;
+  }
+  
+  return 0;
+}
+
+void epos_sim_node_interpolate(epos_sim_node_t* node, double period) {
+  double scale = epos_sim_node_get_scale(node);
+  epos_sim_record_t* start;
+  epos_sim_record_t* end;
+  double duration, s, s2, s3;
+  
+  node->segment_time += period;
+  
+  while (node->buffer_num_records) {
+    start = &node->buffer[node->buffer_first];
+    duration = start->time*1e-3;
+    
+    if (!start->time) {
+      node->position = start->position;
+      node->velocity = 0.0;
+      
+      node->buffer_first = (node->buffer_first+1) % EPOS_SIM_BUFFER_SIZE;
+      --node->buffer_num_records;
+      node->active = 0;
+      node->reached = 1;
+      
+      return;
+    }
+    else if (node->buffer_num_records < 2) {
+      epos_sim_node_set(node, EPOS_INTERPOLATED_POSITION_INDEX_BUFFER,
+        EPOS_INTERPOLATED_POSITION_SUBINDEX_STATUS, epos_sim_node_get(node,
+        EPOS_INTERPOLATED_POSITION_INDEX_BUFFER,
+        EPOS_INTERPOLATED_POSITION_SUBINDEX_STATUS) |
+        EPOS_INTERPOLATED_POSITION_BUFFER_UNDERFLOW_ERROR);
+      
+      node->velocity = 0.0;
+      node->active = 0;
+      
+      return;
+    }
+    else if (node->segment_time < duration)
+      break;
+    
+    node->segment_time -= duration;
+    node->buffer_first = (node->buffer_first+1) % EPOS_SIM_BUFFER_SIZE;
+    --node->buffer_num_records;
+  }
+  
+  if (!node->buffer_num_records)
+    return;
+  
+  start = &node->buffer[node->buffer_first];
+  end = &node->buffer[(node->buffer_first+1) % EPOS_SIM_BUFFER_SIZE];
+  duration = start->time*1e-3;
+  s = node->segment_time/duration;
+  s2 = s*s;
+  s3 = s2*s;
+  
+  node->position = (2.0*s3-3.0*s2+1.0)*start->position+
+    (s3-2.0*s2+s)*duration*start->velocity*scale+
+    (-2.0*s3+3.0*s2)*end->position+
+    (s3-s2)*duration*end->velocity*scale;
+  node->velocity = ((6.0*s2-6.0*s)*start->position+
+    (3.0*s2-4.0*s+1.0)*duration*start->velocity*scale+
+    (-6.0*s2+6.0*s)*end->position+
+    (3.0*s2-2.0*s)*duration*end->velocity*scale)/duration;
+}
+
+void epos_sim_node_update(epos_sim_t* sim, epos_sim_node_t* node) {
+  double scale = epos_sim_node_get_scale(node);
+  int position = clip(round(node->position), INT_MIN, INT_MAX);
+  int velocity = clip(round(node->velocity/scale), INT_MIN, INT_MAX);
+  short current = 0;
+  unsigned short heartbeat_time;
+  can_message_t message;
+  int i;
+  
+  if ((node->state == epos_sim_operation_enabled) &&
+      (epos_sim_node_get(node, EPOS_CONTROL_INDEX_MODE_DISPLAY, 0) ==
+        EPOS_SIM_MODE_CURRENT))
+    current = epos_sim_node_get(node, EPOS_CURRENT_INDEX_SETTING_VALUE, 0);
+  
+  epos_sim_node_set(node, EPOS_POSITION_INDEX_ACTUAL_VALUE, 0, position);
+  epos_sim_node_set(node, EPOS_POSITION_INDEX_DEMAND_VALUE, 0, position);
+  epos_sim_node_set(node, EPOS_SENSOR_INDEX_POSITION, 0, position);
+  epos_sim_node_set(node, EPOS_VELOCITY_INDEX_ACTUAL_VALUE, 0, velocity);
+  epos_sim_node_set(node, EPOS_VELOCITY_INDEX_DEMAND_VALUE, 0, velocity);
+  epos_sim_node_set(node, EPOS_VELOCITY_INDEX_AVERAGE_VALUE, 0, velocity);
+  epos_sim_node_set(node, EPOS_CURRENT_INDEX_ACTUAL_VALUE, 0, current);
+  epos_sim_node_set(node, EPOS_CURRENT_INDEX_AVERAGE_VALUE, 0, current);
+  epos_sim_node_set(node, EPOS_DEVICE_INDEX_STATUS, 0,
+    epos_sim_node_get_status(node));
+  epos_sim_node_set(node, EPOS_INTERPOLATED_POSITION_INDEX_CONFIGURATION,
+    EPOS_INTERPOLATED_POSITION_SUBINDEX_ACTUAL_BUFFER_SIZE,
+    EPOS_SIM_BUFFER_SIZE-node->buffer_num_records);
+  
+  heartbeat_time = epos_sim_node_get(node, EPOS_SIM_INDEX_HEARTBEAT, 0);
+  if (heartbeat_time && (node->time-node->heartbeat_time >=
+      heartbeat_time*1e-3)) {
+    memset(&message, 0, sizeof(can_message_t));
+    message.id = EPOS_BUS_COB_ID_NMT_ERROR_CONTROL+node->node_id;
+    message.content[0] = node->nmt_state;
+    message.length = 1;
+    
+    epos_sim_push(sim, &message);
+    node->heartbeat_time = node->time;
+  }
+  
+  if (node->nmt_state != EPOS_SIM_NMT_OPERATIONAL)
+    return;
+  
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i) {
+    unsigned char type = epos_sim_node_get(node,
+      EPOS_PDO_INDEX_TRANSMIT_PARAMETERS+i,
+      EPOS_PDO_SUBINDEX_TRANSMISSION_TYPE);
+    unsigned short inhibit_time = epos_sim_node_get(node,
+      EPOS_PDO_INDEX_TRANSMIT_PARAMETERS+i, EPOS_PDO_SUBINDEX_INHIBIT_TIME);
+    
+    if ((type > EPOS_PDO_TRANSMISSION_SYNCHRONOUS_MAX) &&
+        (node->time-node->tpdo_time[i] >= inhibit_time*1e-4) &&
+        epos_sim_node_compose_pdo(node, i, &message) &&
+        ((message.id != node->tpdo_messages[i].id) ||
+        (message.length != node->tpdo_messages[i].length) ||
+        memcmp(message.content, node->tpdo_messages[i].content,
+          message.length))) {
+      epos_sim_push(sim, &message);
+      
+      node->tpdo_messages[i] = message;
+      node->tpdo_time[i] = node->time;
+    }
+  }
+}
+
+double epos_sim_node_get_scale(epos_sim_node_t* node) {
+  return 4.0*epos_sim_node_get(node, EPOS_SENSOR_INDEX_CONFIGURATION,
+    EPOS_SENSOR_SUBINDEX_PULSES)/60.0;
+}
+
+unsigned short epos_sim_node_get_status(epos_sim_node_t* node) {
+  unsigned short status = node->homed ? EPOS_SIM_STATUS_HOMED : 0;
+  
+  switch (node->state) {
+    case epos_sim_ready_to_switch_on:
+      return status | EPOS_SIM_STATUS_READY_TO_SWITCH_ON;
+    case epos_sim_switched_on:
+      return status | EPOS_SIM_STATUS_SWITCHED_ON;
+    case epos_sim_quick_stop_active:
+      return status | EPOS_SIM_STATUS_QUICK_STOP_ACTIVE;
+    case epos_sim_fault:
+      return status | EPOS_SIM_STATUS_FAULT;
+    case epos_sim_operation_enabled:
+      break;
+    default:
+      return status | EPOS_SIM_STATUS_SWITCH_ON_DISABLED;
+  }
+  
+  status |= EPOS_SIM_STATUS_OPERATION_ENABLED;
+  if (node->reached)
+    status |= EPOS_SIM_STATUS_TARGET_REACHED;
+  
+  switch (epos_sim_node_get(node, EPOS_CONTROL_INDEX_MODE_DISPLAY, 0)) {
+    case EPOS_SIM_MODE_HOMING:
+      if (node->homed)
+        status |= EPOS_SIM_STATUS_MODE_SPECIFIC;
+      break;
+    case EPOS_SIM_MODE_PROFILE_POSITION:
+      if (node->control & EPOS_SIM_CONTROL_NEW_SETPOINT)
+        status |= EPOS_SIM_STATUS_MODE_SPECIFIC;
+      break;
+    case EPOS_SIM_MODE_INTERPOLATED_POSITION:
+      if (node->active)
+        status |= EPOS_SIM_STATUS_MODE_SPECIFIC;
+      break;
+  }
+  
+  return status;
+}
+
+void epos_sim_node_clear_buffer(epos_sim_node_t* node, int enable) {
+  node->buffer_first = 0;
+  node->buffer_num_records = 0;
+  node->segment_time = 0.0;
+  
+  epos_sim_node_set(node, EPOS_INTERPOLATED_POSITION_INDEX_BUFFER,
+    EPOS_INTERPOLATED_POSITION_SUBINDEX_STATUS, enable ?
+    EPOS_INTERPOLATED_POSITION_BUFFER_ENABLED : 0);
+}
+
+void epos_sim_node_receive_nmt(epos_sim_t* sim, epos_sim_node_t* node,
+    unsigned char command) {
+  can_message_t message;
+  
+  switch (command) {
+    case EPOS_DEVICE_NMT_CS_START_REMOTE_NODE:
+      node->nmt_state = EPOS_SIM_NMT_OPERATIONAL;
+      break;
+    case EPOS_DEVICE_NMT_CS_STOP_REMOTE_NODE:
+      node->nmt_state = EPOS_SIM_NMT_STOPPED;
+      break;
+    case EPOS_DEVICE_NMT_CS_ENTER_PRE_OPERATIONAL:
+      node->nmt_state = EPOS_SIM_NMT_PRE_OPERATIONAL;
+      break;
+    case EPOS_DEVICE_NMT_CS_RESET_NODE:
+    case EPOS_DEVICE_NMT_CS_RESET_COMMUNICATION:
+      epos_sim_node_restore(node,
+        command == EPOS_DEVICE_NMT_CS_RESET_COMMUNICATION);
+      
+      memset(&message, 0, sizeof(can_message_t));
+      message.id = EPOS_BUS_COB_ID_NMT_ERROR_CONTROL+node->node_id;
+      message.content[0] = EPOS_SIM_NMT_BOOT_UP;
+      message.length = 1;
+      
+      epos_sim_push(sim, &message);
+      node->nmt_state = EPOS_SIM_NMT_PRE_OPERATIONAL;
+      break;
+  }
+}
+
+void epos_sim_node_receive_sdo(epos_sim_t* sim, epos_sim_node_t* node,
+    const can_message_t* message) {
+  unsigned char cs = message->content[0] & EPOS_SDO_CS_MASK;
+  unsigned char toggle = message->content[0] & EPOS_SDO_FLAG_TOGGLE;
+  short index = message->content[1]+(message->content[2] << 8);
+  unsigned char subindex = message->content[3];
+  epos_sim_object_t* object = 0;
+  can_message_t response;
+  size_t num;
+  int i;
+  
+  memset(&response, 0, sizeof(can_message_t));
+  response.id = CAN_COB_ID_SDO_RECEIVE+node->node_id;
+  response.length = 8;
+  
+  if ((cs == EPOS_SDO_CS_UPLOAD_REQUEST) ||
+      (cs == EPOS_SDO_CS_DOWNLOAD_REQUEST)) {
+    node->transfer = 0;
+    
+    if (!(object = epos_sim_node_find(node, index, subindex))) {
+      for (i = 0; (i < node->num_objects) &&
+        (node->objects[i].index != index); ++i);
+      epos_sim_node_abort(sim, node, index, subindex,
+        (i < node->num_objects) ? EPOS_SIM_ABORT_SUBINDEX :
+        EPOS_SIM_ABORT_OBJECT);
+      
+      return;
+    }
+    
+    response.content[1] = message->content[1];
+    response.content[2] = message->content[2];
+    response.content[3] = message->content[3];
+  }
+  else if (cs == EPOS_SDO_CS_ABORT) {
+    node->transfer = 0;
+    return;
+  }
+  else if (((cs != EPOS_SDO_CS_UPLOAD_SEGMENT_REQUEST) &&
+      (cs != EPOS_SDO_CS_DOWNLOAD_SEGMENT_REQUEST)) || !node->transfer ||
+      (node->upload != (cs == EPOS_SDO_CS_UPLOAD_SEGMENT_REQUEST))) {
+    epos_sim_node_abort(sim, node, index, subindex, EPOS_SIM_ABORT_COMMAND);
+    return;
+  }
+  else if (toggle != node->toggle) {
+    epos_sim_node_abort(sim, node, node->transfer->index,
+      node->transfer->subindex, EPOS_SIM_ABORT_TOGGLE);
+    return;
+  }
+  
+  switch (cs) {
+    case EPOS_SDO_CS_UPLOAD_REQUEST:
+      if (object->size <= EPOS_SDO_MAX_EXPEDITED_SIZE) {
+        response.content[0] = EPOS_SDO_CS_UPLOAD_RESPONSE |
+          ((EPOS_SDO_MAX_EXPEDITED_SIZE-object->size) << 2) |
+          EPOS_SDO_FLAG_EXPEDITED | EPOS_SDO_FLAG_SIZE;
+        memcpy(&response.content[4], object->data, object->size);
+      }
+      else {
+        response.content[0] = EPOS_SDO_CS_UPLOAD_RESPONSE |
+          EPOS_SDO_FLAG_SIZE;
+        response.content[4] = object->size;
+        
+        node->transfer = object;
+        memcpy(node->transfer_data, object->data, object->size);
+        node->transfer_size = object->size;
+        node->transfer_offset = 0;
+        node->upload = 1;
+        node->toggle = 0;
+      }
+      break;
+    case EPOS_SDO_CS_DOWNLOAD_REQUEST:
+      if (message->content[0] & EPOS_SDO_FLAG_EXPEDITED) {
+        num = (message->content[0] & EPOS_SDO_FLAG_SIZE) ?
+          EPOS_SDO_MAX_EXPEDITED_SIZE-((message->content[0] >> 2) & 0x03) :
+          EPOS_SDO_MAX_EXPEDITED_SIZE;
+        epos_sim_node_write(sim, node, object, &message->content[4], num);
+      }
+      else {
+        node->transfer = object;
+        memset(node->transfer_data, 0, sizeof(node->transfer_data));
+        node->transfer_size = object->size;
+        node->transfer_offset = 0;
+        node->upload = 0;
+        node->toggle = 0;
+      }
+      response.content[0] = EPOS_SDO_CS_DOWNLOAD_RESPONSE;
+      break;
+    case EPOS_SDO_CS_UPLOAD_SEGMENT_REQUEST:
+      num = min(node->transfer_size-node->transfer_offset,
+        EPOS_SDO_MAX_SEGMENT_SIZE);
+      response.content[0] = EPOS_SDO_CS_UPLOAD_SEGMENT_RESPONSE | toggle |
+        ((EPOS_SDO_MAX_SEGMENT_SIZE-num) << 1);
+      memcpy(&response.content[1], &node->transfer_data[
+        node->transfer_offset], num);
+      node->transfer_offset += num;
+      
+      if (node->transfer_offset == node->transfer_size) {
+        response.content[0] |= EPOS_SDO_FLAG_LAST;
+        node->transfer = 0;
+      }
+      node->toggle ^= EPOS_SDO_FLAG_TOGGLE;
+      break;
+    case EPOS_SDO_CS_DOWNLOAD_SEGMENT_REQUEST:
+      num = min(EPOS_SDO_MAX_SEGMENT_SIZE-((message->content[0] >> 1) &
+        0x07), sizeof(node->transfer_data)-node->transfer_offset);
+      memcpy(&node->transfer_data[node->transfer_offset],
+        &message->content[1], num);
+      node->transfer_offset += num;
+      response.content[0] = EPOS_SDO_CS_DOWNLOAD_SEGMENT_RESPONSE | toggle;
+      
+      if (message->content[0] & EPOS_SDO_FLAG_LAST) {
+        epos_sim_node_write(sim, node, node->transfer, node->transfer_data,
+          node->transfer_offset);
+        node->transfer = 0;
+      }
+      node->toggle ^= EPOS_SDO_FLAG_TOGGLE;
+      break;
+  }
+  
+  epos_sim_push(sim, &response);
+}
+
+void epos_sim_node_receive_pdo(epos_sim_t* sim, epos_sim_node_t* node,
+    const can_message_t* message) {
+  size_t offset = 0;
+  int i, j;
+  
+  if (node->nmt_state != EPOS_SIM_NMT_OPERATIONAL)
+    return;
+  
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i) {
+    unsigned int cob_id = epos_sim_node_get(node,
+      EPOS_PDO_INDEX_RECEIVE_PARAMETERS+i, EPOS_PDO_SUBINDEX_COB_ID);
+    int num_mappings = epos_sim_node_get(node,
+      EPOS_PDO_INDEX_RECEIVE_MAPPING+i, EPOS_PDO_SUBINDEX_NUM_MAPPINGS);
+    
+    if ((cob_id & EPOS_PDO_COB_ID_INVALID) || (cob_id != message->id))
+      continue;
+    
+    for (j = 1; j <= num_mappings; ++j) {
+      unsigned int entry = epos_sim_node_get(node,
+        EPOS_PDO_INDEX_RECEIVE_MAPPING+i, j);
+      epos_sim_object_t* object = epos_sim_node_find(node, entry >> 16,
+        (entry >> 8) & 0xFF);
+      size_t size = (entry & 0xFF)/8;
+      
+      if (!object || (offset+size > message->length))
+        break;
+      
+      epos_sim_node_write(sim, node, object, &message->content[offset],
+        size);
+      offset += size;
+    }
+  }
+}
+
+void epos_sim_node_receive_sync(epos_sim_t* sim, epos_sim_node_t* node) {
+  can_message_t message;
+  int i;
+  
+  if (node->nmt_state != EPOS_SIM_NMT_OPERATIONAL)
+    return;
+  
+  ++node->num_syncs;
+  for (i = 0; i < EPOS_PDO_MAX_NUM; ++i) {
+    unsigned char type = epos_sim_node_get(node,
+      EPOS_PDO_INDEX_TRANSMIT_PARAMETERS+i,
+      EPOS_PDO_SUBINDEX_TRANSMISSION_TYPE);
+    
+    if ((type >= EPOS_PDO_TRANSMISSION_SYNCHRONOUS) &&
+        (type <= EPOS_PDO_TRANSMISSION_SYNCHRONOUS_MAX) &&
+        !(node->num_syncs % type) &&
+        epos_sim_node_compose_pdo(node, i, &message)) {
+      epos_sim_push(sim, &message);
+      
+      node->tpdo_messages[i] = message;
+      node->tpdo_time[i] = node->time;
+    }
+  }
+}
+
+size_t epos_sim_node_compose_pdo(epos_sim_node_t* node, int number,
+    can_message_t* message) {
+  unsigned int cob_id = epos_sim_node_get(node,
+    EPOS_PDO_INDEX_TRANSMIT_PARAMETERS+number, EPOS_PDO_SUBINDEX_COB_ID);
+  int num_mappings = epos_sim_node_get(node,
+    EPOS_PDO_INDEX_TRANSMIT_MAPPING+number, EPOS_PDO_SUBINDEX_NUM_MAPPINGS);
+  int i;
+  
+  memset(message, 0, sizeof(can_message_t));
+  if ((cob_id & EPOS_PDO_COB_ID_INVALID) || (num_mappings <= 0))
+    return 0;
+  
+  message->id = cob_id;
+  for (i = 1; i <= num_mappings; ++i) {
+    unsigned int entry = epos_sim_node_get(node,
+      EPOS_PDO_INDEX_TRANSMIT_MAPPING+number, i);
+    epos_sim_object_t* object = epos_sim_node_find(node, entry >> 16,
+      (entry >> 8) & 0xFF);
+    size_t size = (entry & 0xFF)/8;
+    
+    if (!object || (message->length+size > EPOS_PDO_MAX_LENGTH))
+      break;
+    
+    memcpy(&message->content[message->length], object->data, size);
+    message->length += size;
+  }
+  
+  return message->length;
+}
+
+void epos_sim_node_abort(epos_sim_t* sim, epos_sim_node_t* node, short
+    index, unsigned char subindex, unsigned int code) {
+  can_message_t message;
+  
+  memset(&message, 0, sizeof(can_message_t));
+  message.id = CAN_COB_ID_SDO_RECEIVE+node->node_id;
+  message.content[0] = EPOS_SDO_CS_ABORT;
+  message.content[1] = index;
+  message.content[2] = index >> 8;
+  message.content[3] = subindex;
+  memcpy(&message.content[4], &code, sizeof(code));
+  message.length = 8;
+  
+  node->transfer = 0;
+  epos_sim_push(sim, &message);
+}
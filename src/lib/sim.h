@@ -0,0 +1,287 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#ifndef EPOS_SIM_H
+#define EPOS_SIM_H
+
+#include "bus.h"
+#include "pdo.h"
+
+/** \file sim.h
+  * \brief EPOS node simulator
+  * 
+  * The EPOS node simulator replaces the CAN transport of an EPOS bus by a
+  * software model of one or several EPOS2 nodes. Each simulated node
+  * maintains an object dictionary and implements the SDO server with
+  * expedited and segmented transfers, the NMT state machine, the device
+  * control state machine, PDO and heartbeat production, and kinematic
+  * models of the operating modes. The EPOS library and its utilities may
+  * thus be run without any hardware attached.
+  * 
+  * Simulated time follows the monotonic clock. The state of the nodes is
+  * advanced in steps of fixed period whenever a message is exchanged with
+  * the simulator.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS simulator constants
+  */
+//@{
+#define EPOS_SIM_NODE_ID_DEFAULT                  1
+#define EPOS_SIM_QUEUE_SIZE                       256
+#define EPOS_SIM_BUFFER_SIZE                      64
+#define EPOS_SIM_MAX_OBJECT_SIZE                  8
+#define EPOS_SIM_STEP_PERIOD                      1e-3
+#define EPOS_SIM_MAX_STEP_TIME                    1.0
+#define EPOS_SIM_RECEIVE_TIMEOUT                  0.1
+#define EPOS_SIM_HOMING_TIME                      0.1
+//@}
+
+/** \name Object Indexes
+  * \brief Predefined EPOS simulator object indexes
+  */
+//@{
+#define EPOS_SIM_INDEX_HEARTBEAT                  0x1017
+//@}
+
+/** \name NMT States
+  * \brief Predefined EPOS simulator NMT states
+  */
+//@{
+#define EPOS_SIM_NMT_BOOT_UP                      0x00
+#define EPOS_SIM_NMT_STOPPED                      0x04
+#define EPOS_SIM_NMT_OPERATIONAL                  0x05
+#define EPOS_SIM_NMT_PRE_OPERATIONAL              0x7F
+//@}
+
+/** \name Operation Modes
+  * \brief Predefined EPOS simulator operation modes
+  */
+//@{
+#define EPOS_SIM_MODE_HOMING                      6
+#define EPOS_SIM_MODE_PROFILE_VELOCITY            3
+#define EPOS_SIM_MODE_PROFILE_POSITION            1
+#define EPOS_SIM_MODE_POSITION                    -1
+#define EPOS_SIM_MODE_VELOCITY                    -2
+#define EPOS_SIM_MODE_CURRENT                     -3
+#define EPOS_SIM_MODE_INTERPOLATED_POSITION       7
+//@}
+
+/** \name Control Bits
+  * \brief Predefined EPOS simulator control word bits
+  */
+//@{
+#define EPOS_SIM_CONTROL_SWITCH_ON                0x0001
+#define EPOS_SIM_CONTROL_ENABLE_VOLTAGE           0x0002
+#define EPOS_SIM_CONTROL_QUICK_STOP               0x0004
+#define EPOS_SIM_CONTROL_ENABLE_OPERATION         0x0008
+#define EPOS_SIM_CONTROL_NEW_SETPOINT             0x0010
+#define EPOS_SIM_CONTROL_RELATIVE                 0x0040
+#define EPOS_SIM_CONTROL_FAULT_RESET              0x0080
+#define EPOS_SIM_CONTROL_HALT                     0x0100
+//@}
+
+/** \name Status Words
+  * \brief Predefined EPOS simulator status words and bits
+  */
+//@{
+#define EPOS_SIM_STATUS_SWITCH_ON_DISABLED        0x0140
+#define EPOS_SIM_STATUS_READY_TO_SWITCH_ON        0x0121
+#define EPOS_SIM_STATUS_SWITCHED_ON               0x0123
+#define EPOS_SIM_STATUS_OPERATION_ENABLED         0x0137
+#define EPOS_SIM_STATUS_QUICK_STOP_ACTIVE         0x0117
+#define EPOS_SIM_STATUS_FAULT                     0x0108
+#define EPOS_SIM_STATUS_TARGET_REACHED            0x0400
+#define EPOS_SIM_STATUS_MODE_SPECIFIC             0x1000
+#define EPOS_SIM_STATUS_HOMED                     0x8000
+//@}
+
+/** \name Abort Codes
+  * \brief Predefined EPOS simulator SDO abort codes
+  */
+//@{
+#define EPOS_SIM_ABORT_TOGGLE                     0x05030000
+#define EPOS_SIM_ABORT_COMMAND                    0x05040001
+#define EPOS_SIM_ABORT_OBJECT                     0x06020000
+#define EPOS_SIM_ABORT_SUBINDEX                   0x06090011
+#define EPOS_SIM_ABORT_STATE                      0x08000022
+//@}
+
+/** \name Error Codes
+  * \brief Predefined EPOS simulator error codes
+  */
+//@{
+#define EPOS_SIM_ERROR_NONE                       0
+//!< Success
+#define EPOS_SIM_ERROR_TIMEOUT                    1
+//!< Simulator receive timeout
+#define EPOS_SIM_ERROR_INVALID_NODE               2
+//!< Invalid simulated node
+#define EPOS_SIM_ERROR_ALLOCATION                 3
+//!< Failed to allocate simulated node
+//@}
+
+/** \brief Predefined EPOS simulator error descriptions
+  */
+extern const char* epos_sim_errors[];
+
+/** \brief EPOS simulator device control states
+  */
+typedef enum {
+  epos_sim_switch_on_disabled,     //!< Switch on disabled.
+  epos_sim_ready_to_switch_on,     //!< Ready to switch on.
+  epos_sim_switched_on,            //!< Switched on.
+  epos_sim_operation_enabled,      //!< Operation enabled.
+  epos_sim_quick_stop_active,      //!< Quick stop active.
+  epos_sim_fault                   //!< Fault.
+} epos_sim_state_t;
+
+/** \brief Structure defining a default EPOS simulator object
+  */
+typedef struct epos_sim_default_t {
+  short index;                     //!< The index of the object.
+  unsigned char subindex;          //!< The subindex of the object.
+  size_t size;                     //!< The size of the object in [byte].
+  int value;                       //!< The default value of the object.
+} epos_sim_default_t;
+
+/** \brief Structure defining an EPOS simulator object
+  */
+typedef struct epos_sim_object_t {
+  short index;                     //!< The index of the object.
+  unsigned char subindex;          //!< The subindex of the object.
+  size_t size;                     //!< The size of the object in [byte].
+  unsigned char
+    data[EPOS_SIM_MAX_OBJECT_SIZE]; //!< The little-endian object data.
+} epos_sim_object_t;
+
+/** \brief Structure defining an EPOS simulator PVT record
+  */
+typedef struct epos_sim_record_t {
+  int position;                    //!< The position of the record in [qc].
+  int velocity;                    //!< The velocity of the record in [rpm].
+  unsigned char time;              //!< The time to the next record in [ms].
+} epos_sim_record_t;
+
+/** \brief Structure defining a simulated EPOS node
+  */
+typedef struct epos_sim_node_t {
+  int node_id;                     //!< The node identifier.
+
+  epos_sim_object_t* objects;      //!< The object dictionary of the node.
+  size_t num_objects;              //!< The number of objects.
+
+  unsigned char nmt_state;         //!< The NMT state of the node.
+  epos_sim_state_t state;          //!< The device control state.
+  unsigned short control;          //!< The most recent control word.
+  int homed;                       //!< The node has been homed.
+  int reached;                     //!< The target has been reached.
+  int active;                      //!< The operation mode is active.
+
+  epos_sim_object_t* transfer;     //!< The object of a segmented transfer.
+  unsigned char transfer_data[
+    EPOS_SIM_MAX_OBJECT_SIZE];     //!< The segmented transfer data.
+  size_t transfer_size;            //!< The size of the transfer in [byte].
+  size_t transfer_offset;          //!< The offset of the next segment.
+  int upload;                      //!< The segmented transfer is an upload.
+  unsigned char toggle;            //!< The expected toggle bit.
+
+  double time;                     //!< The simulated time in [s].
+  double position;                 //!< The actual position in [qc].
+  double velocity;                 //!< The actual velocity in [qc/s].
+  double target_position;          //!< The profile target position in [qc].
+  double target_velocity;          //!< The profile target velocity in [qc/s].
+  double start_time;               //!< The start time of homing in [s].
+
+  epos_sim_record_t
+    buffer[EPOS_SIM_BUFFER_SIZE];  //!< The interpolated position buffer.
+  size_t buffer_first;             //!< The index of the first record.
+  size_t buffer_num_records;       //!< The number of buffered records.
+  double segment_time;             //!< The time into the segment in [s].
+
+  double heartbeat_time;           //!< The time of the last heartbeat.
+  double tpdo_time[EPOS_PDO_MAX_NUM]; //!< The time of the last TPDOs.
+  can_message_t
+    tpdo_messages[EPOS_PDO_MAX_NUM]; //!< The most recently sent TPDOs.
+  unsigned int num_syncs;          //!< The number of SYNCs received.
+} epos_sim_node_t;
+
+/** \brief Structure defining an EPOS simulator
+  */
+typedef struct epos_sim_t {
+  epos_sim_node_t*
+    nodes[CAN_NODE_ID_MAX+1];      //!< The simulated nodes by identifier.
+
+  can_message_t
+    messages[EPOS_SIM_QUEUE_SIZE]; //!< The messages sent by the nodes.
+  size_t first;                    //!< The index of the first message.
+  size_t num_messages;             //!< The number of queued messages.
+  size_t num_dropped;              //!< The number of dropped messages.
+
+  pthread_mutex_t mutex;           //!< The simulator mutex.
+
+  error_t error;                   //!< The most recent simulator error.
+} epos_sim_t;
+
+/** \brief Predefined EPOS simulator default object dictionary
+  */
+extern const epos_sim_default_t epos_sim_defaults[];
+
+/** \brief Attach a simulated EPOS node to a bus
+  * \param[in] bus The EPOS bus to attach the simulated node to. If the
+  *   bus does not yet use the simulator transport, a simulator will be
+  *   created and installed as the transport of the bus.
+  * \param[in] node_id The node identifier of the simulated node. Zero
+  *   refers to the default node identifier.
+  * \return The simulator of the bus, or null if the simulator or the
+  *   simulated node could not be allocated. A failure to allocate the
+  *   node is also reported in the error of the simulator.
+  * 
+  * The node with the smallest identifier further serves SDO requests sent
+  * to node identifier zero, as would an EPOS acting as a gateway. If the
+  * message queue of the simulator is full, the least recent message sent
+  * by the nodes will be dropped.
+  */
+epos_sim_t* epos_sim_attach(
+  epos_bus_t* bus,
+  int node_id);
+
+/** \brief Advance the simulated EPOS nodes in time
+  * \param[in] sim The EPOS simulator to be advanced.
+  * \param[in] time The monotonic clock time to advance the nodes to in [s].
+  */
+void epos_sim_step(
+  epos_sim_t* sim,
+  double time);
+
+/** \brief Raise a fault on a simulated EPOS node
+  * \param[in] sim The EPOS simulator.
+  * \param[in] node_id The node identifier of the simulated node.
+  * \param[in] code The device error code of the fault, which will be
+  *   sent as an emergency message.
+  * \return The resulting error code.
+  */
+int epos_sim_set_fault(
+  epos_sim_t* sim,
+  int node_id,
+  short code);
+
+#endif
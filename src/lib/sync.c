@@ -0,0 +1,320 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <timer/timer.h>
+
+#include "sync.h"
+#include "bus.h"
+#include "clock.h"
+
+const char* epos_sync_errors[] = {
+  "Success",
+  "Error sending SYNC message",
+  "Error receiving synchronous TPDO",
+  "Failed to start SYNC producer",
+  "SYNC snapshot timeout",
+  "SYNC snapshot overrun",
+};
+
+void* epos_sync_run(void* arg);
+int epos_sync_is_complete(epos_sync_t* sync, unsigned int counter);
+int epos_sync_copy(epos_sync_t* sync, epos_sync_snapshot_t* snapshot);
+int epos_sync_snapshot_is_complete(const epos_sync_snapshot_t* snapshot,
+  unsigned int counter);
+
+void epos_sync_init(epos_sync_t* sync, can_device_t* can_dev, double
+    frequency) {
+  sync->can_dev = can_dev;
+  sync->period = 1.0/frequency;
+  
+  sync->images = 0;
+  sync->num_images = 0;
+  
+  sync->counter = 0;
+  sync->timestamp = 0.0;
+  
+  pthread_mutex_init(&sync->mutex, 0);
+  sync->running = 0;
+  
+  error_init(&sync->error, epos_sync_errors);
+}
+
+void epos_sync_destroy(epos_sync_t* sync) {
+  if (sync->running)
+    epos_sync_stop(sync);
+  
+  if (sync->num_images) {
+    free(sync->images);
+    
+    sync->images = 0;
+    sync->num_images = 0;
+  }
+  
+  pthread_mutex_destroy(&sync->mutex);
+  error_destroy(&sync->error);
+}
+
+void epos_sync_add_image(epos_sync_t* sync, epos_pdo_image_t* image) {
+  pthread_mutex_lock(&sync->mutex);
+  
+  sync->images = realloc(sync->images, (sync->num_images+1)*
+    sizeof(epos_pdo_image_t*));
+  sync->images[sync->num_images] = image;
+  ++sync->num_images;
+  
+  pthread_mutex_unlock(&sync->mutex);
+}
+
+int epos_sync_send(epos_sync_t* sync) {
+  epos_bus_t* bus = epos_bus_find(sync->can_dev);
+  can_message_t message;
+  
+  memset(&message, 0, sizeof(can_message_t));
+  message.id = EPOS_SYNC_COB_ID;
+  message.length = 0;
+  
+  pthread_mutex_lock(&sync->mutex);
+  
+  error_clear(&sync->error);
+  if (!bus)
+    error_set(&sync->error, EPOS_SYNC_ERROR_SEND);
+  else if (epos_bus_send(bus, &message))
+    error_blame(&sync->error, &bus->error, EPOS_SYNC_ERROR_SEND);
+  else {
+    timer_start(&sync->timestamp);
+    sync->counter = epos_bus_get_sync_counter(bus);
+  }
+  
+  pthread_mutex_unlock(&sync->mutex);
+  
+  return sync->error.code;
+}
+
+int epos_sync_start(epos_sync_t* sync) {
+  epos_bus_t* bus = epos_bus_find(sync->can_dev);
+  
+  error_clear(&sync->error);
+  
+  if (!sync->running) {
+    if (bus) {
+      pthread_mutex_lock(&sync->mutex);
+      sync->counter = epos_bus_get_sync_counter(bus);
+      pthread_mutex_unlock(&sync->mutex);
+    }
+    
+    sync->running = 1;
+    
+    if (pthread_create(&sync->thread, 0, epos_sync_run, sync)) {
+      sync->running = 0;
+      error_set(&sync->error, EPOS_SYNC_ERROR_START);
+    }
+  }
+  
+  return sync->error.code;
+}
+
+int epos_sync_stop(epos_sync_t* sync) {
+  if (sync->running) {
+    pthread_mutex_lock(&sync->mutex);
+    sync->running = 0;
+    pthread_mutex_unlock(&sync->mutex);
+    
+    pthread_join(sync->thread, 0);
+  }
+  
+  return sync->error.code;
+}
+
+unsigned int epos_sync_get_counter(epos_sync_t* sync) {
+  unsigned int counter;
+  
+  pthread_mutex_lock(&sync->mutex);
+  counter = sync->counter;
+  pthread_mutex_unlock(&sync->mutex);
+  
+  return counter;
+}
+
+void epos_sync_snapshot_init(epos_sync_snapshot_t* snapshot) {
+  snapshot->counter = 0;
+  snapshot->timestamp = 0.0;
+  
+  snapshot->images = 0;
+  snapshot->num_images = 0;
+}
+
+void epos_sync_snapshot_destroy(epos_sync_snapshot_t* snapshot) {
+  if (snapshot->num_images) {
+    free(snapshot->images);
+    
+    snapshot->images = 0;
+    snapshot->num_images = 0;
+  }
+}
+
+int epos_sync_snapshot(epos_sync_t* sync, epos_sync_snapshot_t* snapshot,
+    unsigned int counter, double timeout) {
+  epos_bus_t* bus = epos_bus_find(sync->can_dev);
+  double start_time, time, timestamp = 0.0;
+  unsigned int sync_counter;
+  int complete;
+  
+  error_clear(&sync->error);
+  if (!bus) {
+    error_set(&sync->error, EPOS_SYNC_ERROR_RECEIVE);
+    return sync->error.code;
+  }
+  
+  start_time = epos_clock_get();
+  
+  if (!counter)
+    counter = epos_sync_get_counter(sync)+1;
+  
+  while (1) {
+    pthread_mutex_lock(&sync->mutex);
+    pthread_mutex_lock(&bus->mutex);
+    
+    sync_counter = sync->counter;
+    if (sync_counter == counter)
+      timestamp = sync->timestamp;
+    complete = (sync_counter >= counter) ?
+      epos_sync_is_complete(sync, counter) : 0;
+    if ((complete > 0) && !epos_sync_copy(sync, snapshot))
+      error_setf(&sync->error, EPOS_SYNC_ERROR_RECEIVE, "%u", counter);
+    
+    pthread_mutex_unlock(&bus->mutex);
+    pthread_mutex_unlock(&sync->mutex);
+    
+    if (sync->error.code)
+      return sync->error.code;
+    else if (complete > 0)
+      break;
+    else if (complete < 0) {
+      error_setf(&sync->error, EPOS_SYNC_ERROR_OVERRUN, "%u", counter);
+      return sync->error.code;
+    }
+    
+    time = epos_clock_get();
+    if (time-start_time > timeout) {
+      error_setf(&sync->error, EPOS_SYNC_ERROR_TIMEOUT, "%u", counter);
+      return sync->error.code;
+    }
+    
+    epos_bus_dispatch(bus);
+  }
+  
+  if (!epos_sync_snapshot_is_complete(snapshot, counter)) {
+    error_setf(&sync->error, EPOS_SYNC_ERROR_OVERRUN, "%u", counter);
+    return sync->error.code;
+  }
+  
+  snapshot->counter = counter;
+  snapshot->timestamp = timestamp;
+  
+  return sync->error.code;
+}
+
+void* epos_sync_run(void* arg) {
+  epos_sync_t* sync = arg;
+  struct timespec next;
+  int running = 1;
+  
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  
+  while (running) {
+    epos_sync_send(sync);
+    
+    next.tv_sec += (time_t)sync->period;
+    next.tv_nsec += (sync->period-(time_t)sync->period)*1e9;
+    if (next.tv_nsec >= 1000000000) {
+      next.tv_nsec -= 1000000000;
+      ++next.tv_sec;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0);
+    
+    pthread_mutex_lock(&sync->mutex);
+    running = sync->running;
+    pthread_mutex_unlock(&sync->mutex);
+  }
+  
+  return 0;
+}
+
+int epos_sync_is_complete(epos_sync_t* sync, unsigned int counter) {
+  int i, j;
+  int complete = 1;
+  
+  for (i = 0; i < sync->num_images; ++i)
+    for (j = 0; j < EPOS_PDO_MAX_NUM; ++j) {
+      epos_pdo_t* pdo = &sync->images[i]->transmit[j];
+      
+      if (pdo->num_mappings &&
+          (pdo->transmission_type >= EPOS_PDO_TRANSMISSION_SYNCHRONOUS) &&
+          (pdo->transmission_type <= EPOS_PDO_TRANSMISSION_SYNCHRONOUS_MAX)) {
+        if (!pdo->num_transferred || (pdo->sync_counter < counter))
+          complete = 0;
+        else if (pdo->sync_counter > counter)
+          return -1;
+      }
+    }
+  
+  return complete;
+}
+
+int epos_sync_copy(epos_sync_t* sync, epos_sync_snapshot_t* snapshot) {
+  epos_pdo_image_t* images;
+  int i;
+  
+  if (snapshot->num_images != sync->num_images) {
+    if (!(images = realloc(snapshot->images, sync->num_images*
+        sizeof(epos_pdo_image_t))))
+      return 0;
+    snapshot->images = images;
+    snapshot->num_images = sync->num_images;
+  }
+  
+  for (i = 0; i < sync->num_images; ++i)
+    memcpy(&snapshot->images[i], sync->images[i], sizeof(epos_pdo_image_t));
+  
+  return 1;
+}
+
+int epos_sync_snapshot_is_complete(const epos_sync_snapshot_t* snapshot,
+    unsigned int counter) {
+  int i, j;
+  
+  for (i = 0; i < snapshot->num_images; ++i)
+    for (j = 0; j < EPOS_PDO_MAX_NUM; ++j) {
+      const epos_pdo_t* pdo = &snapshot->images[i].transmit[j];
+      
+      if (pdo->num_mappings &&
+          (pdo->transmission_type >= EPOS_PDO_TRANSMISSION_SYNCHRONOUS) &&
+          (pdo->transmission_type <= EPOS_PDO_TRANSMISSION_SYNCHRONOUS_MAX) &&
+          (pdo->sync_counter != counter))
+        return 0;
+    }
+  
+  return 1;
+}
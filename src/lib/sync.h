@@ -0,0 +1,197 @@
+/***************************************************************************
+ *   Copyright (C) 2008 by Ralf Kaestner                                   *
+ *   ralf.kaestner@gmail.com                                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#ifndef EPOS_SYNC_H
+#define EPOS_SYNC_H
+
+#include <pthread.h>
+
+#include "pdo.h"
+
+/** \file sync.h
+  * \brief EPOS synchronization functions
+  * 
+  * The SYNC object is broadcast by a SYNC producer and causes all EPOS
+  * nodes on the CAN bus to sample and transmit their synchronous TPDOs
+  * simultaneously. A snapshot thus provides the state of several axes
+  * as sampled at the same instant, regardless of the number of nodes.
+  * 
+  * The SYNC counter is maintained by the bus of the SYNC producer, which
+  * increments it before sending each SYNC. Received synchronous TPDOs
+  * are assigned to the SYNC most recently sent at their reception, such
+  * that the SYNC period should exceed the time required to transmit all
+  * TPDOs.
+  */
+
+/** \name Constants
+  * \brief Predefined EPOS SYNC constants
+  */
+//@{
+#define EPOS_SYNC_COB_ID                          0x080
+//@}
+
+/** \name Error Codes
+  * \brief Predefined EPOS SYNC error codes
+  */
+//@{
+#define EPOS_SYNC_ERROR_NONE                      0
+//!< Success
+#define EPOS_SYNC_ERROR_SEND                      1
+//!< Error sending SYNC message
+#define EPOS_SYNC_ERROR_RECEIVE                   2
+//!< Error receiving synchronous TPDO
+#define EPOS_SYNC_ERROR_START                     3
+//!< Failed to start SYNC producer
+#define EPOS_SYNC_ERROR_TIMEOUT                   4
+//!< SYNC snapshot timeout
+#define EPOS_SYNC_ERROR_OVERRUN                   5
+//!< SYNC snapshot overrun
+//@}
+
+/** \brief Predefined EPOS SYNC error descriptions
+  */
+extern const char* epos_sync_errors[];
+
+/** \brief Structure defining an EPOS SYNC producer
+  */
+typedef struct epos_sync_t {
+  can_device_t* can_dev;           //!< The CAN device of the SYNC producer.
+  double period;                   //!< The SYNC period in [s].
+
+  epos_pdo_image_t** images;       //!< The process images triggered by SYNC.
+  size_t num_images;               //!< The number of process images.
+
+  unsigned int counter;            //!< The counter of the latest SYNC.
+  double timestamp;                //!< The timestamp of the latest SYNC.
+
+  pthread_t thread;                //!< The SYNC producer thread.
+  pthread_mutex_t mutex;           //!< The SYNC producer mutex.
+  int running;                     //!< The SYNC producer is running.
+
+  error_t error;                   //!< The most recent SYNC error.
+} epos_sync_t;
+
+/** \brief Structure defining an EPOS SYNC snapshot
+  */
+typedef struct epos_sync_snapshot_t {
+  unsigned int counter;            //!< The SYNC counter of the snapshot.
+  double timestamp;                //!< The timestamp of the SYNC in [s].
+
+  epos_pdo_image_t* images;        //!< Copies of the sampled process images.
+  size_t num_images;               //!< The number of sampled process images.
+} epos_sync_snapshot_t;
+
+/** \brief Initialize EPOS SYNC producer
+  * \param[in] sync The EPOS SYNC producer to be initialized.
+  * \param[in] can_dev The CAN device used by the SYNC producer.
+  * \param[in] frequency The frequency of the SYNC producer in [Hz].
+  */
+void epos_sync_init(
+  epos_sync_t* sync,
+  can_device_t* can_dev,
+  double frequency);
+
+/** \brief Destroy EPOS SYNC producer
+  * \param[in] sync The EPOS SYNC producer to be destroyed.
+  * 
+  * A running SYNC producer will be stopped before destruction.
+  */
+void epos_sync_destroy(
+  epos_sync_t* sync);
+
+/** \brief Add a process image to an EPOS SYNC producer
+  * \param[in] sync The EPOS SYNC producer to add the process image to.
+  * \param[in] image The EPOS process image to be added. Its synchronous
+  *   TPDOs will be assigned the counter of the SYNC they respond to.
+  */
+void epos_sync_add_image(
+  epos_sync_t* sync,
+  epos_pdo_image_t* image);
+
+/** \brief Send a single SYNC message
+  * \param[in] sync The EPOS SYNC producer to send the SYNC message for.
+  * \return The resulting error code.
+  * 
+  * On success, the counter of the SYNC producer is updated to the SYNC
+  * counter of the bus.
+  */
+int epos_sync_send(
+  epos_sync_t* sync);
+
+/** \brief Start EPOS SYNC producer
+  * \param[in] sync The EPOS SYNC producer to be started.
+  * \return The resulting error code.
+  * 
+  * This function starts a thread which periodically sends SYNC messages.
+  * Send errors of the producer thread will be reported in sync->error.
+  */
+int epos_sync_start(
+  epos_sync_t* sync);
+
+/** \brief Stop EPOS SYNC producer
+  * \param[in] sync The running EPOS SYNC producer to be stopped.
+  * \return The resulting error code.
+  */
+int epos_sync_stop(
+  epos_sync_t* sync);
+
+/** \brief Retrieve the counter of an EPOS SYNC producer
+  * \param[in] sync The EPOS SYNC producer to retrieve the counter for.
+  * \return The counter of the latest SYNC sent by the SYNC producer.
+  */
+unsigned int epos_sync_get_counter(
+  epos_sync_t* sync);
+
+/** \brief Initialize EPOS SYNC snapshot
+  * \param[in] snapshot The EPOS SYNC snapshot to be initialized.
+  */
+void epos_sync_snapshot_init(
+  epos_sync_snapshot_t* snapshot);
+
+/** \brief Destroy EPOS SYNC snapshot
+  * \param[in] snapshot The EPOS SYNC snapshot to be destroyed.
+  */
+void epos_sync_snapshot_destroy(
+  epos_sync_snapshot_t* snapshot);
+
+/** \brief Collect an EPOS SYNC snapshot
+  * \param[in] sync The EPOS SYNC producer to collect the snapshot from.
+  * \param[in,out] snapshot The EPOS SYNC snapshot to be collected.
+  * \param[in] counter The counter of the SYNC to collect the snapshot for.
+  *   A zero counter refers to the next SYNC produced after this call.
+  * \param[in] timeout The timeout of the snapshot in [s].
+  * \return The resulting error code.
+  * 
+  * This function dispatches CAN messages until all synchronous TPDOs of all
+  * process images of the SYNC producer have been received in response to
+  * the requested SYNC. The process images are then copied into the
+  * snapshot while holding the bus mutex, such that no TPDO can be routed
+  * between the completeness check and the copy. The snapshot fails if
+  * TPDOs are received in response to a later SYNC or if the timeout expires
+  * beforehand.
+  */
+int epos_sync_snapshot(
+  epos_sync_t* sync,
+  epos_sync_snapshot_t* snapshot,
+  unsigned int counter,
+  double timeout);
+
+#endif
@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include <stdio.h>
+#include <math.h>
 
 #include <timer/timer.h>
 
@@ -71,55 +72,67 @@ int epos_velocity_profile_stop(epos_node_t* node) {
   return epos_control_stop(&node->control);
 }
 
-epos_profile_value_t epos_velocity_profile_eval(const epos_velocity_profile_t*
-    profile, double time) {
-  epos_profile_value_t values;
+void epos_velocity_profile_prepare(const epos_velocity_profile_t* profile,
+    epos_profile_prepared_t* prepared) {
+  double v_0 = profile->start_value;
+  double v_1 = profile->target_value;
+  double v = v_1-v_0;
+  double a = (fabs(v_1) < fabs(v_0)) ? copysign(profile->deceleration, v) :
+    copysign(profile->acceleration, v);
+  double t_a = 0.0, s_a = 0.0;
+  epos_profile_phase_t* phase;
   
-  float v_0 = profile->start_value;
-  float v_1 = profile->target_value;
-  double t = time-profile->start_time;
+  epos_profile_prepared_init(prepared);
+  phase = epos_profile_prepared_add_phase(prepared, profile->start_time);
+  phase->velocity[0] = v_0;
   
-  if (t > 0.0) {
-    float v = v_1-v_0;
-    float a = (v_1 > v_0) ? fabs(profile->acceleration) :
-      -fabs(profile->acceleration);
-    
+  if ((v != 0.0) && (a != 0.0)) {
+    phase = epos_profile_prepared_add_phase(prepared, profile->start_time);
     if (profile->type == epos_profile_sinusoidal) {
-      double t_a = 0.5*M_PI*v/a;
-
-      if (t <= t_a) {
-        values.position = v_0*t+0.5*v*(t-0.5*v/a*sin(2.0*a/v*t));
-        values.velocity = v_0+0.5*v*(1.0-cos(2.0*a/v*t));
-        values.acceleration = a*sin(2.0*a/v*t);
-      }
-      else {
-        values.position = v_0*t_a+0.5*v*(t_a-0.5*v/a*sin(2.0*a/v*t_a));
-        values.velocity = v_1;
-        values.acceleration = 0.0;
-      }
+      t_a = 0.5*M_PI*v/a;
+      s_a = (v_0+0.5*v)*t_a;
+      
+      phase->frequency = 2.0*a/v;
+      phase->position[1] = v_0+0.5*v;
+      phase->position[3] = -0.25*sqr(v)/a;
+      phase->velocity[0] = v_0+0.5*v;
+      phase->velocity[3] = -0.5*v;
+      phase->acceleration[3] = a;
     }
     else {
-      double t_a = v/a;
-
-      if (t <= t_a) {
-        values.position = (v_0+0.5*a*t)*t;
-        values.velocity = v_0+a*t;
-        values.acceleration = a;
-      }
-      else {
-        values.position = (v_0+0.5*a*t_a)*t_a;
-        values.velocity = v_1;
-        values.acceleration = 0.0;
-      }
+      t_a = v/a;
+      s_a = (v_0+0.5*v)*t_a;
+      
+      phase->position[1] = v_0;
+      phase->position[2] = 0.5*a;
+      phase->velocity[0] = v_0;
+      phase->velocity[1] = a;
+      phase->acceleration[0] = a;
     }
   }
-  else {
-    values.position = 0.0;
-    values.velocity = v_0;
-    values.acceleration = 0.0;
-  }
+  
+  phase = epos_profile_prepared_add_phase(prepared, profile->start_time+t_a);
+  phase->position[0] = s_a;
+  phase->position[1] = v_1;
+  phase->velocity[0] = v_1;
+}
 
-  return values;
+epos_profile_value_t epos_velocity_profile_eval(const epos_velocity_profile_t*
+    profile, double time) {
+  epos_profile_prepared_t prepared;
+  
+  epos_velocity_profile_prepare(profile, &prepared);
+  return epos_profile_prepared_eval(&prepared, time);
+}
+
+void epos_velocity_profile_eval_batch(const epos_velocity_profile_t*
+    profile, const double* times, float* positions, float* velocities,
+    float* accelerations, size_t num_times) {
+  epos_profile_prepared_t prepared;
+  
+  epos_velocity_profile_prepare(profile, &prepared);
+  epos_profile_prepared_eval_batch(&prepared, times, positions, velocities,
+    accelerations, num_times);
 }
 
 int epos_velocity_profile_set_target(epos_device_t* dev, int velocity) {
@@ -88,6 +88,20 @@ int epos_velocity_profile_start(
 int epos_velocity_profile_stop(
   epos_node_t* node);
 
+/** \brief Prepare EPOS velocity profile for evaluation
+  * \param[in] profile The EPOS velocity profile control operation to be
+  *   prepared.
+  * \param[out] prepared The prepared EPOS motion profile holding the
+  *   velocity ramp and the subsequent constant velocity phase of the
+  *   velocity profile.
+  * 
+  * The profile needs to be prepared again whenever its start velocity or
+  * start time change, i.e., after epos_velocity_profile_start().
+  */
+void epos_velocity_profile_prepare(
+  const epos_velocity_profile_t* profile,
+  epos_profile_prepared_t* prepared);
+
 /** \brief Evaluate the values of an EPOS velocity profile
   * \param[in] profile The EPOS velocity profile control operation to
   *   evaluate the values for.
@@ -95,12 +109,38 @@ int epos_velocity_profile_stop(
   * \return The evaluated profile values.
   * 
   * This function is intended to facilitate the computational generation
-  * of motion trajectories.
+  * of motion trajectories. For evaluating a profile repeatedly, preparing
+  * it by epos_velocity_profile_prepare() is considerably more efficient.
   */
 epos_profile_value_t epos_velocity_profile_eval(
   const epos_velocity_profile_t* profile,
   double time);
 
+/** \brief Evaluate the values of an EPOS velocity profile at an array of
+  *   times
+  * \param[in] profile The EPOS velocity profile control operation to
+  *   evaluate the values for.
+  * \param[in] times The array of times to evaluate the profile values at
+  *   in [s].
+  * \param[out] positions The array receiving the evaluated positions in
+  *   [rad], or null.
+  * \param[out] velocities The array receiving the evaluated velocities in
+  *   [rad/s], or null.
+  * \param[out] accelerations The array receiving the evaluated accelerations
+  *   in [rad/s^2], or null.
+  * \param[in] num_times The number of times to evaluate the profile at.
+  * 
+  * This is a convenience function which prepares the profile and
+  * evaluates it by means of epos_profile_prepared_eval_batch().
+  */
+void epos_velocity_profile_eval_batch(
+  const epos_velocity_profile_t* profile,
+  const double* times,
+  float* positions,
+  float* velocities,
+  float* accelerations,
+  size_t num_times);
+
 /** \brief Set the velocity profile target velocity of an EPOS device
   * \param[in] dev The EPOS device to set the target velocity for.
   * \param[in] velocity The target velocity for the specified EPOS